@@ -0,0 +1,371 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "bootmodel.h"
+
+#include <QFile>
+#include <KColorScheme>
+#include <KConfigGroup>
+#include <KLocalizedString>
+#include <KSharedConfig>
+
+#include <algorithm>
+
+static const QString connSystemd = QStringLiteral("org.freedesktop.systemd1");
+static const QString pathSysdMgr = QStringLiteral("/org/freedesktop/systemd1");
+static const QString ifaceMgr = QStringLiteral("org.freedesktop.systemd1.Manager");
+static const QString ifaceUnit = QStringLiteral("org.freedesktop.systemd1.Unit");
+static const QString ifaceDbusProp = QStringLiteral("org.freedesktop.DBus.Properties");
+
+// Number of GetAll calls waiting for a reply at the same time
+static const int maxInFlight = 32;
+
+BootModel::BootModel(QObject *parent)
+ : QAbstractTableModel(parent)
+{
+}
+
+int BootModel::rowCount(const QModelIndex &) const
+{
+  return blame.size();
+}
+
+int BootModel::columnCount(const QModelIndex &) const
+{
+  return 4;
+}
+
+QVariant BootModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+  if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
+    return QVariant();
+
+  switch (section)
+  {
+    case 0: return i18n("Unit");
+    case 1: return i18n("Startup Time");
+    case 2: return i18n("Active After");
+    case 3: return i18n("Previous Boot");
+  }
+  return QVariant();
+}
+
+QVariant BootModel::data(const QModelIndex &index, int role) const
+{
+  if (!index.isValid() || index.row() >= blame.size())
+    return QVariant();
+
+  const BootUnitTimes &t = blame.at(index.row());
+  QHash<QString, qulonglong>::const_iterator previous = previousTimes.constFind(t.id);
+  qlonglong delta = previous != previousTimes.constEnd() ? qlonglong(t.time) - qlonglong(previous.value()) : 0;
+
+  if (role == Qt::DisplayRole)
+  {
+    switch (index.column())
+    {
+      case 0:
+        return t.id;
+      case 1:
+        return formatDuration(t.time);
+      case 2:
+        return t.activated >= userspace ? QStringLiteral("@") + formatDuration(t.activated - userspace) : QString();
+      case 3:
+        if (previous == previousTimes.constEnd())
+          return QString();
+        return QStringLiteral("%1 (%2%3)").arg(formatDuration(previous.value()))
+                                          .arg(delta >= 0 ? QStringLiteral("+") : QStringLiteral("-"))
+                                          .arg(formatDuration(qAbs(delta)));
+    }
+  }
+  else if (role == Qt::UserRole)
+  {
+    // Used for sorting
+    switch (index.column())
+    {
+      case 0:
+        return t.id;
+      case 1:
+        return t.time;
+      case 2:
+        return t.activated;
+      case 3:
+        return delta;
+    }
+  }
+  else if (role == Qt::ForegroundRole && index.column() == 3 && previous != previousTimes.constEnd())
+  {
+    // Flag changes of more than half a second and a fifth
+    if (qAbs(delta) > 500000 && qAbs(delta) * 5 > qlonglong(previous.value()))
+    {
+      const KColorScheme scheme(QPalette::Normal);
+      return scheme.foreground(delta > 0 ? KColorScheme::NegativeText : KColorScheme::PositiveText);
+    }
+  }
+  return QVariant();
+}
+
+void BootModel::refresh(const QList<SystemdUnit> &units)
+{
+  // Replies to an earlier refresh are ignored by their generation
+  ++generation;
+  beginResetModel();
+  blame.clear();
+  endResetModel();
+  times.clear();
+  queue.clear();
+  chain.clear();
+  defaultTarget.clear();
+  firmware = loader = initrd = userspace = finishTime = 0;
+  pending = 0;
+
+  foreach (const SystemdUnit &unit, units)
+  {
+    if (unit.load_state == QLatin1String("loaded") && !unit.unit_path.path().isEmpty())
+      queue << qMakePair(unit.id, unit.unit_path);
+  }
+
+  QDBusConnection bus = QDBusConnection::systemBus();
+  QDBusMessage msg = QDBusMessage::createMethodCall(connSystemd, pathSysdMgr, ifaceDbusProp, QStringLiteral("GetAll"));
+  msg << ifaceMgr;
+  QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(bus.asyncCall(msg), this);
+  watcher->setProperty("generation", generation);
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(slotManagerReply(QDBusPendingCallWatcher*)));
+  pending++;
+
+  msg = QDBusMessage::createMethodCall(connSystemd, pathSysdMgr, ifaceMgr, QStringLiteral("GetDefaultTarget"));
+  watcher = new QDBusPendingCallWatcher(bus.asyncCall(msg), this);
+  watcher->setProperty("generation", generation);
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(slotDefaultTargetReply(QDBusPendingCallWatcher*)));
+  pending++;
+
+  fetchNext();
+}
+
+bool BootModel::isLoading() const
+{
+  return pending > 0;
+}
+
+QString BootModel::phaseSummary() const
+{
+  if (isLoading() || !userspace)
+    return QString();
+  if (!finishTime)
+    return i18n("Bootup is not yet finished.");
+
+  // The firmware and loader timestamps count back from the kernel start
+  QStringList phases;
+  if (firmware)
+    phases << i18n("%1 (firmware)", formatDuration(firmware - loader));
+  if (loader)
+    phases << i18n("%1 (loader)", formatDuration(loader));
+  phases << i18n("%1 (kernel)", formatDuration(initrd ? initrd : userspace));
+  if (initrd)
+    phases << i18n("%1 (initrd)", formatDuration(userspace - initrd));
+  phases << i18n("%1 (userspace)", formatDuration(finishTime - userspace));
+
+  qulonglong total = (firmware ? firmware : loader) + finishTime;
+  QString summary = i18n("Startup finished in %1 = %2.", phases.join(QStringLiteral(" + ")), formatDuration(total));
+  if (previousTotal)
+  {
+    qlonglong delta = qlonglong(total) - qlonglong(previousTotal);
+    summary += ' ' + i18n("The previous boot took %1 (%2%3).", formatDuration(previousTotal),
+                          delta >= 0 ? QStringLiteral("+") : QStringLiteral("-"), formatDuration(qAbs(delta)));
+  }
+  return summary;
+}
+
+QList<BootUnitTimes> BootModel::criticalChain() const
+{
+  return chain;
+}
+
+qulonglong BootModel::userspaceStart() const
+{
+  return userspace;
+}
+
+QString BootModel::formatDuration(qulonglong usec)
+{
+  if (usec >= 60000000)
+    return QStringLiteral("%1min %2s").arg(usec / 60000000).arg((usec % 60000000) / 1000000.0, 0, 'f', 3);
+  else if (usec >= 1000000)
+    return QString::number(usec / 1000000.0, 'f', 3) + 's';
+  return QString::number(usec / 1000) + "ms";
+}
+
+void BootModel::fetchNext()
+{
+  QDBusConnection bus = QDBusConnection::systemBus();
+  while (pending < maxInFlight && !queue.isEmpty())
+  {
+    QPair<QString, QDBusObjectPath> unit = queue.takeFirst();
+    QDBusMessage msg = QDBusMessage::createMethodCall(connSystemd, unit.second.path(), ifaceDbusProp, QStringLiteral("GetAll"));
+    msg << ifaceUnit;
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(bus.asyncCall(msg), this);
+    watcher->setProperty("generation", generation);
+    watcher->setProperty("unit", unit.first);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(slotUnitReply(QDBusPendingCallWatcher*)));
+    pending++;
+  }
+
+  if (pending == 0)
+    finish();
+}
+
+void BootModel::slotManagerReply(QDBusPendingCallWatcher *watcher)
+{
+  QDBusPendingReply<QVariantMap> reply = *watcher;
+  watcher->deleteLater();
+  if (watcher->property("generation").toULongLong() != generation)
+    return;
+
+  if (reply.isError())
+    qDebug() << "Failed to get manager properties:" << reply.error().message();
+  else
+  {
+    QVariantMap props = reply.value();
+    firmware = props.value(QStringLiteral("FirmwareTimestampMonotonic")).toULongLong();
+    loader = props.value(QStringLiteral("LoaderTimestampMonotonic")).toULongLong();
+    initrd = props.value(QStringLiteral("InitRDTimestampMonotonic")).toULongLong();
+    userspace = props.value(QStringLiteral("UserspaceTimestampMonotonic")).toULongLong();
+    finishTime = props.value(QStringLiteral("FinishTimestampMonotonic")).toULongLong();
+  }
+  pending--;
+  fetchNext();
+}
+
+void BootModel::slotDefaultTargetReply(QDBusPendingCallWatcher *watcher)
+{
+  QDBusPendingReply<QString> reply = *watcher;
+  watcher->deleteLater();
+  if (watcher->property("generation").toULongLong() != generation)
+    return;
+
+  if (!reply.isError())
+    defaultTarget = reply.value();
+  pending--;
+  fetchNext();
+}
+
+void BootModel::slotUnitReply(QDBusPendingCallWatcher *watcher)
+{
+  QDBusPendingReply<QVariantMap> reply = *watcher;
+  watcher->deleteLater();
+  if (watcher->property("generation").toULongLong() != generation)
+    return;
+
+  if (!reply.isError())
+  {
+    // Activation starts when the unit leaves the inactive state
+    QVariantMap props = reply.value();
+    BootUnitTimes t;
+    t.id = watcher->property("unit").toString();
+    t.activating = props.value(QStringLiteral("InactiveExitTimestampMonotonic")).toULongLong();
+    t.activated = props.value(QStringLiteral("ActiveEnterTimestampMonotonic")).toULongLong();
+    t.after = props.value(QStringLiteral("After")).toStringList();
+    if (t.activating && t.activated >= t.activating)
+      t.time = t.activated - t.activating;
+    times.insert(t.id, t);
+  }
+  pending--;
+  fetchNext();
+}
+
+void BootModel::finish()
+{
+  QList<BootUnitTimes> rows;
+  foreach (const BootUnitTimes &t, times)
+  {
+    if (t.time > 0)
+      rows << t;
+  }
+  std::sort(rows.begin(), rows.end(),
+            [](const BootUnitTimes &a, const BootUnitTimes &b) { return a.time > b.time; });
+
+  // Walk back from the default target, always following the After=
+  // dependency that became active last, like systemd-analyze
+  // critical-chain. Units activated after the boot finished are skipped.
+  QString id = defaultTarget;
+  if (!times.contains(id))
+    id = times.contains(QStringLiteral("graphical.target")) ? QStringLiteral("graphical.target") : QStringLiteral("multi-user.target");
+  QSet<QString> visited;
+  while (times.contains(id) && !visited.contains(id))
+  {
+    visited.insert(id);
+    const BootUnitTimes &t = times[id];
+    chain << t;
+
+    QString next;
+    qulonglong latest = 0;
+    foreach (const QString &dep, t.after)
+    {
+      QHash<QString, BootUnitTimes>::const_iterator it = times.constFind(dep);
+      if (it == times.constEnd() || visited.contains(dep))
+        continue;
+      qulonglong activated = it->activated;
+      if (activated > latest && (!finishTime || activated <= finishTime))
+      {
+        latest = activated;
+        next = dep;
+      }
+    }
+    id = next;
+  }
+
+  beginResetModel();
+  blame = rows;
+  compareWithPreviousBoot();
+  endResetModel();
+  emit finished();
+}
+
+void BootModel::compareWithPreviousBoot()
+{
+  // The times of the current boot are stored under its boot id. When a
+  // new boot is analyzed for the first time they become the previous
+  // boot's times.
+  QFile file(QStringLiteral("/proc/sys/kernel/random/boot_id"));
+  QString bootId;
+  if (file.open(QIODevice::ReadOnly))
+    bootId = QString::fromLatin1(file.readAll()).trimmed();
+
+  KConfigGroup cfg(KSharedConfig::openConfig("kcmsystemdrc"), "Boot");
+  if (finishTime && !bootId.isEmpty())
+  {
+    QString storedId = cfg.readEntry("BootId", QString());
+    if (!storedId.isEmpty() && storedId != bootId)
+    {
+      cfg.writeEntry("PreviousUnitTimes", cfg.readEntry("UnitTimes", QStringList()));
+      cfg.writeEntry("PreviousTotal", cfg.readEntry("Total", qulonglong(0)));
+    }
+
+    QStringList unitTimes;
+    foreach (const BootUnitTimes &t, blame)
+      unitTimes << t.id + '=' + QString::number(t.time);
+    cfg.writeEntry("BootId", bootId);
+    cfg.writeEntry("UnitTimes", unitTimes);
+    cfg.writeEntry("Total", (firmware ? firmware : loader) + finishTime);
+    cfg.sync();
+  }
+
+  previousTimes.clear();
+  foreach (const QString &entry, cfg.readEntry("PreviousUnitTimes", QStringList()))
+    previousTimes.insert(entry.section('=', 0, -2), entry.section('=', -1).toULongLong());
+  previousTotal = cfg.readEntry("PreviousTotal", qulonglong(0));
+}
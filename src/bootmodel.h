@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef BOOTMODEL_H
+#define BOOTMODEL_H
+
+#include <QAbstractTableModel>
+#include <QtDBus/QtDBus>
+
+#include "systemdunit.h"
+
+// When a unit started activating and became active, in monotonic
+// microseconds since boot
+struct BootUnitTimes
+{
+  QString id;
+  qulonglong activating = 0, activated = 0, time = 0;
+  QStringList after;
+};
+
+// Model for the boot tab, equivalent to systemd-analyze blame. The unit
+// timestamps are fetched with one GetAll per unit, a few dozen at a
+// time, and the critical chain is computed from them in memory.
+class BootModel : public QAbstractTableModel
+{
+  Q_OBJECT
+
+public:
+  explicit BootModel(QObject *parent = 0);
+  int rowCount(const QModelIndex & parent = QModelIndex()) const;
+  int columnCount(const QModelIndex & parent = QModelIndex()) const;
+  QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+  QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+  void refresh(const QList<SystemdUnit> &units);
+  bool isLoading() const;
+  QString phaseSummary() const;
+  QList<BootUnitTimes> criticalChain() const;
+  qulonglong userspaceStart() const;
+
+  // Formats microseconds like systemd-analyze, such as 1.234s
+  static QString formatDuration(qulonglong usec);
+
+signals:
+  void finished();
+
+private slots:
+  void slotManagerReply(QDBusPendingCallWatcher *);
+  void slotDefaultTargetReply(QDBusPendingCallWatcher *);
+  void slotUnitReply(QDBusPendingCallWatcher *);
+
+private:
+  void fetchNext();
+  void finish();
+  void compareWithPreviousBoot();
+
+  QList<BootUnitTimes> blame;
+  QHash<QString, BootUnitTimes> times;
+  QList<QPair<QString, QDBusObjectPath> > queue;
+  QList<BootUnitTimes> chain;
+  QHash<QString, qulonglong> previousTimes;
+  QString defaultTarget;
+  qulonglong firmware = 0, loader = 0, initrd = 0, userspace = 0, finishTime = 0, previousTotal = 0;
+  int pending = 0;
+  quint64 generation = 0;
+};
+
+#endif // BOOTMODEL_H
@@ -0,0 +1,273 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "cgroupstat.h"
+
+#include <QFile>
+#include <QStringList>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char cgroupRoot[] = "/sys/fs/cgroup/";
+
+static int openStat(const QString &cgroup, const char *name)
+{
+  QByteArray path = QFile::encodeName(QLatin1String(cgroupRoot) + cgroup + '/' + QLatin1String(name));
+  return ::open(path.constData(), O_RDONLY | O_CLOEXEC);
+}
+
+static bool readFile(int fd, char *buf, size_t size, ssize_t *len)
+{
+  // Reads the whole (small) file from the start into buf
+  if (fd < 0)
+    return false;
+  *len = pread(fd, buf, size - 1, 0);
+  if (*len <= 0)
+    return false;
+  buf[*len] = '\0';
+  return true;
+}
+
+static qulonglong parseNumber(const char *c)
+{
+  qulonglong value = 0;
+  while (*c >= '0' && *c <= '9')
+    value = value * 10 + (*c++ - '0');
+  return value;
+}
+
+static const char *parseDecimal(const char *c, double *value)
+{
+  // PSI averages have the form "12.34"
+  qulonglong whole = 0, frac = 0, scale = 1;
+  while (*c >= '0' && *c <= '9')
+    whole = whole * 10 + (*c++ - '0');
+  if (*c == '.')
+  {
+    ++c;
+    while (*c >= '0' && *c <= '9')
+    {
+      frac = frac * 10 + (*c++ - '0');
+      scale *= 10;
+    }
+  }
+  *value = whole + double(frac) / scale;
+  return c;
+}
+
+const char *pressureFileName(pressureResource resource)
+{
+  static const char *names[pressureCount] = { "cpu.pressure", "memory.pressure", "io.pressure" };
+  return names[resource];
+}
+
+bool parsePressure(const char *buf, PressureStat *stat)
+{
+  // "some avg10=0.00 avg60=0.00 avg300=0.00 total=0"
+  // "full avg10=0.00 avg60=0.00 avg300=0.00 total=0"
+  *stat = PressureStat();
+  for (const char *line = buf; line && *line; )
+  {
+    bool some = strncmp(line, "some ", 5) == 0;
+    bool full = strncmp(line, "full ", 5) == 0;
+    if (some || full)
+    {
+      double avg10 = 0, avg60 = 0;
+      const char *c = line + 5;
+      if (strncmp(c, "avg10=", 6) == 0)
+        c = parseDecimal(c + 6, &avg10);
+      if (strncmp(c, " avg60=", 7) == 0)
+        parseDecimal(c + 7, &avg60);
+      if (some)
+      {
+        stat->someAvg10 = avg10;
+        stat->someAvg60 = avg60;
+        stat->valid = true;
+      }
+      else
+      {
+        stat->fullAvg10 = avg10;
+        stat->fullAvg60 = avg60;
+      }
+    }
+    line = strchr(line, '\n');
+    if (line)
+      ++line;
+  }
+  return stat->valid;
+}
+
+static bool isUnitGroup(const char *name)
+{
+  // Unit types that get a control group of their own
+  static const char *suffixes[] = { ".service", ".scope", ".slice", ".socket", ".mount", ".swap" };
+  size_t len = strlen(name);
+  for (unsigned i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); ++i)
+  {
+    size_t slen = strlen(suffixes[i]);
+    if (len > slen && strcmp(name + len - slen, suffixes[i]) == 0)
+      return true;
+  }
+  return false;
+}
+
+static void findUnitCgroups(const QByteArray &dir, const QString &path, int depth, QList<UnitCgroup> &list)
+{
+  DIR *d = opendir(dir.constData());
+  if (!d)
+    return;
+
+  struct dirent *entry;
+  while ((entry = readdir(d)) != NULL)
+  {
+    if (entry->d_type != DT_DIR || entry->d_name[0] == '.')
+      continue;
+
+    QString name = QFile::decodeName(entry->d_name);
+    QString childPath = path.isEmpty() ? name : path + '/' + name;
+    if (isUnitGroup(entry->d_name))
+    {
+      UnitCgroup group;
+      group.unit = name;
+      group.path = childPath;
+      group.userUnit = childPath.contains(QLatin1String("/user@")) && !name.startsWith(QLatin1String("user@"));
+      list.append(group);
+    }
+
+    // Delegated subtrees can nest deeply, units are never that far down
+    if (depth < 8)
+      findUnitCgroups(dir + '/' + entry->d_name, childPath, depth + 1, list);
+  }
+  closedir(d);
+}
+
+QList<UnitCgroup> findUnitCgroups()
+{
+  QList<UnitCgroup> list;
+  QByteArray root(cgroupRoot);
+  root.chop(1);
+  findUnitCgroups(root, QString(), 0, list);
+  return list;
+}
+
+QString sliceCgroupPath(const QString &slice)
+{
+  // "a-b-c.slice" is nested as "a.slice/a-b.slice/a-b-c.slice"
+  if (slice.isEmpty() || slice == QLatin1String("-.slice"))
+    return QString();
+
+  QStringList parts = slice.left(slice.length() - 6).split('-');
+  QString path, prefix;
+  foreach (const QString &part, parts)
+  {
+    prefix += (prefix.isEmpty() ? QString() : QStringLiteral("-")) + part;
+    path += (path.isEmpty() ? QString() : QStringLiteral("/")) + prefix + QStringLiteral(".slice");
+  }
+  return path;
+}
+
+CgroupStatReader::~CgroupStatReader()
+{
+  for (QHash<QString, Files>::iterator it = groups.begin(); it != groups.end(); ++it)
+    close(it.value());
+}
+
+bool CgroupStatReader::read(const QString &cgroup, CgroupUsage *usage)
+{
+  QHash<QString, Files>::iterator it = groups.find(cgroup);
+  if (it == groups.end())
+  {
+    Files files;
+    files.cpu = openStat(cgroup, "cpu.stat");
+    files.memory = openStat(cgroup, "memory.current");
+    files.pids = openStat(cgroup, "pids.current");
+    it = groups.insert(cgroup, files);
+  }
+  it->lastUsed = pass;
+
+  char buf[512];
+  ssize_t len;
+  bool ok = false;
+  *usage = CgroupUsage();
+
+  if (readFile(it->cpu, buf, sizeof(buf), &len))
+  {
+    // The first line is "usage_usec <n>"
+    static const char key[] = "usage_usec ";
+    for (const char *line = buf; line && *line; )
+    {
+      if (strncmp(line, key, sizeof(key) - 1) == 0)
+      {
+        usage->cpuUsec = parseNumber(line + sizeof(key) - 1);
+        ok = true;
+        break;
+      }
+      line = strchr(line, '\n');
+      if (line)
+        ++line;
+    }
+  }
+  if (readFile(it->memory, buf, sizeof(buf), &len))
+  {
+    usage->memoryBytes = parseNumber(buf);
+    ok = true;
+  }
+  if (readFile(it->pids, buf, sizeof(buf), &len))
+  {
+    usage->tasks = parseNumber(buf);
+    ok = true;
+  }
+
+  if (!ok)
+  {
+    // The group is gone, open it again next time in case it returns
+    close(it.value());
+    groups.erase(it);
+  }
+  usage->valid = ok;
+  return ok;
+}
+
+void CgroupStatReader::expire(int passes)
+{
+  for (QHash<QString, Files>::iterator it = groups.begin(); it != groups.end(); )
+  {
+    if (pass - it->lastUsed >= passes)
+    {
+      close(it.value());
+      it = groups.erase(it);
+    }
+    else
+      ++it;
+  }
+  pass++;
+}
+
+void CgroupStatReader::close(Files &files)
+{
+  if (files.cpu >= 0)
+    ::close(files.cpu);
+  if (files.memory >= 0)
+    ::close(files.memory);
+  if (files.pids >= 0)
+    ::close(files.pids);
+  files.cpu = files.memory = files.pids = -1;
+}
@@ -0,0 +1,144 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef CGROUPSTAT_H
+#define CGROUPSTAT_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+/**
+ * \brief resource usage of a control group, as found in the unified
+ * (cgroup v2) hierarchy.
+ */
+struct CgroupUsage
+{
+  qulonglong cpuUsec = 0, memoryBytes = 0, tasks = 0;
+  bool valid = false;
+
+  bool operator==(const CgroupUsage &right) const
+  {
+    return cpuUsec == right.cpuUsec && memoryBytes == right.memoryBytes &&
+           tasks == right.tasks && valid == right.valid;
+  }
+};
+
+/**
+ * \brief the resources the kernel reports pressure stall information
+ * (PSI) for, in the order of their files.
+ */
+enum pressureResource
+{
+  pressureCpu, pressureMemory, pressureIO, pressureCount
+};
+
+/**
+ * \brief share of time in percent in which some or all tasks of a group
+ * were stalled on a resource, over the last 10 and 60 seconds.
+ */
+struct PressureStat
+{
+  double someAvg10 = 0, someAvg60 = 0, fullAvg10 = 0, fullAvg60 = 0;
+  bool valid = false;
+};
+
+/**
+ * \return the name of the pressure file of \p resource, e.g. "io.pressure".
+ */
+const char *pressureFileName(pressureResource resource);
+
+/**
+ * \brief parses the contents of a *.pressure file without allocating.
+ * \return false if the "some" line is missing.
+ */
+bool parsePressure(const char *buf, PressureStat *stat);
+
+/**
+ * \brief the control group of a unit, found by findUnitCgroups().
+ */
+struct UnitCgroup
+{
+  QString unit, path;
+  bool userUnit = false;
+};
+
+/**
+ * \brief walks the unified hierarchy for the control groups of units.
+ * A unit's group is named after the unit, so this is what the
+ * ControlGroup properties of the units point to. Units below a user
+ * manager are marked as user units.
+ * \return the groups with paths relative to /sys/fs/cgroup.
+ */
+QList<UnitCgroup> findUnitCgroups();
+
+/**
+ * \return the control group of a slice unit relative to the cgroup root,
+ * e.g. "user.slice/user-1000.slice" for "user-1000.slice".
+ */
+QString sliceCgroupPath(const QString &slice);
+
+/**
+ *
+ * \brief reads cpu.stat, memory.current and pids.current of control groups.
+ * Use like this:
+ * \code
+ * CgroupStatReader reader;
+ * CgroupUsage usage;
+ * if (reader.read("user.slice/user-1000.slice", &usage))
+ *   doSomething(usage.memoryBytes);
+ * reader.expire();
+ * \code
+ *
+ * The files of each control group stay open between calls and are read
+ * with pread(), so sampling the same groups again costs one system call
+ * per file. Groups that have not been read for a while are closed by
+ * expire().
+ */
+class CgroupStatReader
+{
+public:
+  ~CgroupStatReader();
+
+  /**
+   * \param cgroup Path of the control group relative to /sys/fs/cgroup.
+   * \param usage Receives the values that could be read.
+   * \return false if none of the files could be read, e.g. because the
+   * group does not exist or the legacy hierarchy is in use.
+   */
+  bool read(const QString &cgroup, CgroupUsage *usage);
+
+  /**
+   * \brief closes the files of groups that were not read in the last
+   * \p passes calls of expire().
+   */
+  void expire(int passes = 30);
+
+private:
+  struct Files
+  {
+    int cpu = -1, memory = -1, pids = -1;
+    int lastUsed = 0;
+  };
+
+  static void close(Files &files);
+  QHash<QString, Files> groups;
+  int pass = 0;
+};
+
+#endif // CGROUPSTAT_H
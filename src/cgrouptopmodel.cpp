@@ -0,0 +1,364 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "cgrouptopmodel.h"
+#include "cgroupstat.h"
+
+#include <QFile>
+#include <KLocalizedString>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+static const char cgroupRoot[] = "/sys/fs/cgroup";
+
+static ssize_t readGroupFile(int fd, const QByteArray &dir, const char *name, char *buf, size_t size)
+{
+  // Reads the whole file into buf. Groups without open files (see
+  // maxOpenFiles) open and close the file each time.
+  ssize_t len;
+  if (fd >= 0)
+  {
+    len = pread(fd, buf, size - 1, 0);
+  }
+  else
+  {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir.constData(), name);
+    fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      return -1;
+    len = pread(fd, buf, size - 1, 0);
+    ::close(fd);
+  }
+  if (len >= 0)
+    buf[len] = '\0';
+  return len;
+}
+
+static const char *parseNumber(const char *c, qulonglong *value)
+{
+  *value = 0;
+  while (*c >= '0' && *c <= '9')
+    *value = *value * 10 + (*c++ - '0');
+  return c;
+}
+
+CgroupTopModel::CgroupTopModel(QObject *parent, QList<SystemdUnit> *systemList, QList<SystemdUnit> *userList)
+ : QAbstractTableModel(parent)
+{
+  systemUnits = systemList;
+  userUnits = userList;
+
+  headers << i18n("Unit")
+          << i18n("Description")
+          << i18n("CPU")
+          << i18n("Memory")
+          << i18n("IO Read")
+          << i18n("IO Write")
+          << i18n("Control Group");
+
+  // Keep files open for as many groups as the file limit comfortably
+  // allows, leaving the rest of it to the process
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+    maxOpenFiles = limit.rlim_cur / 2;
+  else
+    maxOpenFiles = 4096;
+
+  clock.start();
+}
+
+CgroupTopModel::~CgroupTopModel()
+{
+  for (int row = 0; row < groups.size(); ++row)
+    closeFiles(groups[row]);
+}
+
+int CgroupTopModel::rowCount(const QModelIndex &) const
+{
+  return groups.size();
+}
+
+int CgroupTopModel::columnCount(const QModelIndex &) const
+{
+  return 7;
+}
+
+QVariant CgroupTopModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+  if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < headers.size())
+    return headers.at(section);
+  return QVariant();
+}
+
+QVariant CgroupTopModel::data(const QModelIndex &index, int role) const
+{
+  if (!index.isValid() || index.row() >= groups.size())
+    return QVariant();
+
+  const Group &g = groups.at(index.row());
+  if (role == Qt::DisplayRole)
+  {
+    switch (index.column())
+    {
+      case 0: return g.id;
+      case 1: return g.description;
+      case 2: return g.hasRates ? QString::number(g.cpuPercent, 'f', 1) + '%' : QString();
+      case 3: return g.valid ? format.formatByteSize(g.memory) : QString();
+      case 4: return g.hasRates ? i18n("%1/s", format.formatByteSize(g.readRate)) : QString();
+      case 5: return g.hasRates ? i18n("%1/s", format.formatByteSize(g.writeRate)) : QString();
+      case 6: return g.path;
+    }
+  }
+  else if (role == Qt::UserRole)
+  {
+    // Raw values, used for ranking
+    switch (index.column())
+    {
+      case 2: return g.cpuPercent;
+      case 3: return g.memory;
+      case 4: return g.readRate;
+      case 5: return g.writeRate;
+      default: return data(index, Qt::DisplayRole);
+    }
+  }
+  else if (role == Qt::ToolTipRole && g.userUnit)
+  {
+    return i18n("User unit");
+  }
+  return QVariant();
+}
+
+QString CgroupTopModel::cgroup(int row) const
+{
+  if (row < 0 || row >= groups.size())
+    return QString();
+  return groups.at(row).path;
+}
+
+void CgroupTopModel::refresh(int rescanPasses)
+{
+  if (pass++ % rescanPasses == 0)
+    scan();
+
+  qint64 now = clock.elapsed();
+  double secs = lastSample < 0 ? 0 : (now - lastSample) / 1000.0;
+  lastSample = now;
+
+  for (int row = 0; row < groups.size(); ++row)
+    sample(groups[row], secs);
+
+  if (!groups.isEmpty())
+    emit dataChanged(index(0, 2), index(groups.size() - 1, 5));
+}
+
+void CgroupTopModel::sample(Group &g, double secs)
+{
+  char buf[4096];
+  qulonglong cpuUsec = 0, memory = 0, ioRead = 0, ioWrite = 0;
+
+  if (readStat(g, g.cpuFd, "cpu.stat", buf, sizeof(buf)) <= 0)
+  {
+    // The group is gone, it is removed by the next scan
+    g.valid = g.hasRates = false;
+    return;
+  }
+
+  // "usage_usec <n>" is the first line
+  static const char usageKey[] = "usage_usec ";
+  if (strncmp(buf, usageKey, sizeof(usageKey) - 1) == 0)
+    parseNumber(buf + sizeof(usageKey) - 1, &cpuUsec);
+
+  if (readStat(g, g.memoryFd, "memory.current", buf, sizeof(buf)) > 0)
+    parseNumber(buf, &memory);
+
+  // One line per device: "8:0 rbytes=<n> wbytes=<n> rios=<n> ..."
+  if (readStat(g, g.ioFd, "io.stat", buf, sizeof(buf)) > 0)
+  {
+    qulonglong value;
+    for (const char *c = buf; *c; )
+    {
+      if (strncmp(c, "rbytes=", 7) == 0)
+      {
+        c = parseNumber(c + 7, &value);
+        ioRead += value;
+      }
+      else if (strncmp(c, "wbytes=", 7) == 0)
+      {
+        c = parseNumber(c + 7, &value);
+        ioWrite += value;
+      }
+      else
+      {
+        // Skip to the next field
+        while (*c && *c != ' ' && *c != '\n')
+          ++c;
+        while (*c == ' ' || *c == '\n')
+          ++c;
+      }
+    }
+  }
+
+  // Counters only grow while the group lives, anything else means it was
+  // recreated between two samples and its files were opened again
+  g.hasRates = g.valid && secs > 0 && cpuUsec >= g.cpuUsec && ioRead >= g.ioRead && ioWrite >= g.ioWrite;
+  if (g.hasRates)
+  {
+    g.cpuPercent = (cpuUsec - g.cpuUsec) / (secs * 1e4);
+    g.readRate = (ioRead - g.ioRead) / secs;
+    g.writeRate = (ioWrite - g.ioWrite) / secs;
+  }
+  else
+  {
+    g.cpuPercent = g.readRate = g.writeRate = 0;
+  }
+  g.cpuUsec = cpuUsec;
+  g.memory = memory;
+  g.ioRead = ioRead;
+  g.ioWrite = ioWrite;
+  g.valid = true;
+}
+
+ssize_t CgroupTopModel::readStat(Group &g, int &fd, const char *name, char *buf, size_t size)
+{
+  // Open files keep pointing at a removed group. When a unit is
+  // restarted its group is recreated at the same path, so the files are
+  // opened again before giving up.
+  ssize_t len = readGroupFile(fd, g.dir, name, buf, size);
+  if (len <= 0 && fd >= 0)
+  {
+    closeFiles(g);
+    openFiles(g);
+    len = readGroupFile(fd, g.dir, name, buf, size);
+  }
+  return len;
+}
+
+void CgroupTopModel::scan()
+{
+  // Descriptions of the units, looked up by the name of their group
+  QHash<QString, const SystemdUnit *> system, user;
+  if (systemUnits)
+  {
+    system.reserve(systemUnits->size());
+    for (int i = 0; i < systemUnits->size(); ++i)
+      system.insert(systemUnits->at(i).id, &systemUnits->at(i));
+  }
+  if (userUnits)
+  {
+    user.reserve(userUnits->size());
+    for (int i = 0; i < userUnits->size(); ++i)
+      user.insert(userUnits->at(i).id, &userUnits->at(i));
+  }
+
+  for (int row = 0; row < groups.size(); ++row)
+    groups[row].seen = false;
+
+  QVector<Group> added;
+  foreach (const UnitCgroup &found, findUnitCgroups())
+  {
+    QHash<QString, int>::const_iterator it = rowByPath.constFind(found.path);
+    if (it != rowByPath.constEnd())
+    {
+      groups[it.value()].seen = true;
+      continue;
+    }
+    Group g;
+    g.id = found.unit;
+    g.path = found.path;
+    g.dir = QFile::encodeName(QLatin1String(cgroupRoot) + '/' + found.path);
+    g.userUnit = found.userUnit;
+    g.seen = true;
+    added.append(g);
+  }
+
+  for (int row = 0; row < groups.size(); ++row)
+  {
+    Group &g = groups[row];
+    const SystemdUnit *unit = (g.userUnit ? user : system).value(g.id);
+    g.description = unit ? unit->description : QString();
+  }
+
+  for (int row = groups.size() - 1; row >= 0; --row)
+  {
+    if (groups.at(row).seen)
+      continue;
+    beginRemoveRows(QModelIndex(), row, row);
+    closeFiles(groups[row]);
+    groups.remove(row);
+    endRemoveRows();
+  }
+
+  if (!added.isEmpty())
+  {
+    int first = groups.size();
+    beginInsertRows(QModelIndex(), first, first + added.size() - 1);
+    for (int i = 0; i < added.size(); ++i)
+    {
+      Group &g = added[i];
+      const SystemdUnit *unit = (g.userUnit ? user : system).value(g.id);
+      g.description = unit ? unit->description : QString();
+      openFiles(g);
+      groups.append(g);
+    }
+    endInsertRows();
+  }
+  updateRowIndex();
+}
+
+void CgroupTopModel::openFiles(Group &g)
+{
+  if (openFileCount + 3 > maxOpenFiles)
+    return;
+
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/cpu.stat", g.dir.constData());
+  g.cpuFd = ::open(path, O_RDONLY | O_CLOEXEC);
+  snprintf(path, sizeof(path), "%s/memory.current", g.dir.constData());
+  g.memoryFd = ::open(path, O_RDONLY | O_CLOEXEC);
+  snprintf(path, sizeof(path), "%s/io.stat", g.dir.constData());
+  g.ioFd = ::open(path, O_RDONLY | O_CLOEXEC);
+  openFileCount += (g.cpuFd >= 0) + (g.memoryFd >= 0) + (g.ioFd >= 0);
+}
+
+void CgroupTopModel::closeFiles(Group &g)
+{
+  int *fds[3] = { &g.cpuFd, &g.memoryFd, &g.ioFd };
+  for (int i = 0; i < 3; ++i)
+  {
+    if (*fds[i] >= 0)
+    {
+      ::close(*fds[i]);
+      *fds[i] = -1;
+      openFileCount--;
+    }
+  }
+}
+
+void CgroupTopModel::updateRowIndex()
+{
+  rowByPath.clear();
+  rowByPath.reserve(groups.size());
+  for (int row = 0; row < groups.size(); ++row)
+    rowByPath.insert(groups.at(row).path, row);
+}
@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef CGROUPTOPMODEL_H
+#define CGROUPTOPMODEL_H
+
+#include <QAbstractTableModel>
+#include <QElapsedTimer>
+#include <QVector>
+#include <KFormat>
+
+#include <sys/types.h>
+
+#include "systemdunit.h"
+
+/**
+ * \brief ranks the units by the resources used by their control groups,
+ * read straight from the unified cgroup hierarchy.
+ *
+ * The tree under /sys/fs/cgroup is walked every few refreshes to find
+ * the groups of units. cpu.stat, memory.current and io.stat of each
+ * group stay open and are read with pread() and parsed in place on each
+ * refresh, so a refresh allocates nothing. A unit's group is named after
+ * the unit, which is what its ControlGroup property points to, so the
+ * rows are matched to the unit lists by name.
+ */
+class CgroupTopModel : public QAbstractTableModel
+{
+  Q_OBJECT
+
+public:
+  explicit CgroupTopModel(QObject *parent = 0, QList<SystemdUnit> *systemList = NULL, QList<SystemdUnit> *userList = NULL);
+  ~CgroupTopModel();
+  int rowCount(const QModelIndex & parent = QModelIndex()) const;
+  int columnCount(const QModelIndex & parent = QModelIndex()) const;
+  QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+  QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+
+  /**
+   * \brief samples all groups, and looks for new or removed groups every
+   * \p rescanPasses calls.
+   */
+  void refresh(int rescanPasses = 10);
+
+  /**
+   * \return the path of the group of a row relative to the cgroup root.
+   */
+  QString cgroup(int row) const;
+
+private:
+  struct Group
+  {
+    QString id, path, description;
+    QByteArray dir;
+    bool userUnit = false, seen = false;
+    int cpuFd = -1, memoryFd = -1, ioFd = -1;
+    qulonglong cpuUsec = 0, memory = 0, ioRead = 0, ioWrite = 0;
+    double cpuPercent = 0, readRate = 0, writeRate = 0;
+    bool valid = false, hasRates = false;
+  };
+
+  void scan();
+  void sample(Group &group, double secs);
+  ssize_t readStat(Group &group, int &fd, const char *name, char *buf, size_t size);
+  void openFiles(Group &group);
+  void closeFiles(Group &group);
+  void updateRowIndex();
+
+  QVector<Group> groups;
+  QHash<QString, int> rowByPath;
+  QList<SystemdUnit> *systemUnits, *userUnits;
+  QStringList headers;
+  QElapsedTimer clock;
+  qint64 lastSample = -1;
+  int pass = 0, openFileCount = 0, maxOpenFiles = 0;
+  KFormat format;
+};
+
+#endif // CGROUPTOPMODEL_H
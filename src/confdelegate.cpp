@@ -16,6 +16,7 @@
  *******************************************************************************/
 
 #include "confdelegate.h"
+#include "cpuaffinityeditor.h"
 
 #include <QDebug>
 #include <QSpinBox>
@@ -26,9 +27,16 @@
 ConfDelegate::ConfDelegate(QObject *parent, const QList<confOption> *confOptList)
     : QStyledItemDelegate(parent)
     , m_optList(confOptList)
+    , m_unitList(0)
 {
 }
 
+void ConfDelegate::setUnitList(const QList<SystemdUnit> *unitList)
+{
+  // Used by the CPU set editor to list the units overriding the value
+  m_unitList = unitList;
+}
+
 QWidget *ConfDelegate::createEditor(QWidget *parent,
     const QStyleOptionViewItem &/* option */,
     const QModelIndex &index) const
@@ -91,6 +99,10 @@ QWidget *ConfDelegate::createEditor(QWidget *parent,
     // editor->setFrame(false);
     return editor;
   }
+  else if (index.data(Qt::UserRole) == CPUSET)
+  {
+    return new CpuSetEditor(parent, m_unitList);
+  }
   else
   {
     QLineEdit *editor  = new QLineEdit(parent);
@@ -145,6 +157,11 @@ void ConfDelegate::setEditorData(QWidget *editor,
         cmb->setItemData(cmb->findText(iter.key()), Qt::Unchecked, Qt::CheckStateRole);
     }
   }
+  else if (index.data(Qt::UserRole) == CPUSET)
+  {
+    CpuSetEditor *cpuEditor = static_cast<CpuSetEditor*>(editor);
+    cpuEditor->setText(index.model()->data(index, Qt::DisplayRole).toString());
+  }
   else
   {
     QString value = index.model()->data(index, Qt::DisplayRole).toString();
@@ -196,6 +213,16 @@ void ConfDelegate::setModelData(QWidget *editor, QAbstractItemModel *model,
     model->setData(index, QVariant(map), Qt::UserRole+2);
     return;
   }
+  else if (index.data(Qt::UserRole) == CPUSET)
+  {
+    // Keep the old value if the list does not parse
+    CpuSetEditor *cpuEditor = static_cast<CpuSetEditor*>(editor);
+    bool ok;
+    QByteArray mask = cpuListToMask(cpuEditor->text(), &ok);
+    if (!ok)
+      return;
+    value = cpuMaskToList(mask);
+  }
   else
   {
     QLineEdit *le = static_cast<QLineEdit*>(editor);
@@ -21,6 +21,7 @@
 #include <QStyledItemDelegate>
 
 #include "confoption.h"
+#include "systemdunit.h"
 
 class ConfDelegate : public QStyledItemDelegate
 {
@@ -39,8 +40,11 @@ public:
   void updateEditorGeometry(QWidget *editor,
       const QStyleOptionViewItem &option, const QModelIndex &index) const Q_DECL_OVERRIDE;
 
+  void setUnitList(const QList<SystemdUnit> *unitList);
+
 private:
   const QList<confOption> *m_optList;
+  const QList<SystemdUnit> *m_unitList;
 };
 
 #endif // CONFDELEGATE_H
@@ -17,6 +17,7 @@
 
 #include "confoption.h"
 #include "fsutil.h"
+#include "cputopology.h"
 
 #include <QDebug>
 
@@ -338,6 +339,20 @@ int confOption::setValueFromFile(QString line)
     
   }
   
+  else if (type == CPUSET)
+  {
+    // Store CPU lists in range syntax, whatever form the file used
+    bool ok;
+    QByteArray mask = cpuListToMask(rval, &ok);
+    if (ok)
+    {
+      value = cpuMaskToList(mask);
+      return 0;
+    }
+    qDebug() << rval << "is not a valid value for setting" << realName << ". Ignoring...";
+    return -1;
+  }
+
   else if (type == SIZE)
   {
     // RegExp to match a number (possibly with decimals) followed by a
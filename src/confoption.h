@@ -38,7 +38,7 @@ namespace chrono = boost::chrono;
 
 enum settingType
 {
-  BOOL, TIME, INTEGER, STRING, LIST, MULTILIST, RESLIMIT, SIZE
+  BOOL, TIME, INTEGER, STRING, LIST, MULTILIST, RESLIMIT, SIZE, CPUSET
 };
 
 enum confFile
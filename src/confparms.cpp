@@ -18,8 +18,6 @@
 #include "confparms.h"
 #include "fsutil.h"
 
-#include <QThread>
-
 #include <KLocalizedString>
 
 QList<confOption> getConfigParms(const int systemdVersion)
@@ -107,12 +105,9 @@ QList<confOption> getConfigParms(const int systemdVersion)
   map.clear();
   map["name"] = "CPUAffinity";
   map["file"] = SYSTEMD;
-  map["type"] = MULTILIST;
-  QStringList CPUAffinityList;
-  for (int i = 1; i <= QThread::idealThreadCount(); ++i)
-    CPUAffinityList << QString::number(i);
-  map["possibleVals"] = CPUAffinityList;
-  map["toolTip"] = i18n("<p>The initial CPU affinity for the systemd init process.</p>");
+  map["type"] = CPUSET;
+  map["defVal"] = QString();
+  map["toolTip"] = i18n("<p>The initial CPU affinity for the systemd init process, as a list of CPUs or CPU ranges such as 0-3,8.</p>");
   list.append(confOption(map));
 
   map.clear();
@@ -0,0 +1,230 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "cpuaffinityeditor.h"
+
+#include <QDialogButtonBox>
+#include <QHBoxLayout>
+#include <QMap>
+#include <QPointer>
+#include <QPushButton>
+#include <QToolButton>
+#include <QVBoxLayout>
+
+#include <KLocalizedString>
+
+static const QString connSystemd = QStringLiteral("org.freedesktop.systemd1");
+
+CpuAffinityDialog::CpuAffinityDialog(QWidget *parent, const QString &cpus, const QList<SystemdUnit> *units)
+ : QDialog(parent)
+{
+  setWindowTitle(i18n("CPU Affinity"));
+
+  tree = new QTreeWidget(this);
+  tree->setHeaderLabels(QStringList() << i18n("CPU") << i18n("SMT Siblings"));
+
+  bool ok;
+  QByteArray mask = cpuListToMask(cpus, &ok);
+  QList<CpuInfo> topology = readCpuTopology();
+
+  // Group the CPUs by node, socket and core. The node level is left out
+  // on machines with a single node.
+  QMap<int, QMap<int, QMap<int, QList<CpuInfo> > > > groups;
+  foreach (const CpuInfo &info, topology)
+    groups[info.node][info.package][info.core] << info;
+  bool showNodes = groups.size() > 1;
+
+  for (QMap<int, QMap<int, QMap<int, QList<CpuInfo> > > >::const_iterator node = groups.constBegin(); node != groups.constEnd(); ++node)
+  {
+    QTreeWidgetItem *nodeItem = NULL;
+    if (showNodes)
+    {
+      nodeItem = new QTreeWidgetItem(tree, QStringList() << i18n("Node %1", node.key()));
+      nodeItem->setFlags(nodeItem->flags() | Qt::ItemIsUserCheckable | Qt::ItemIsTristate);
+      nodeItem->setExpanded(true);
+    }
+    for (QMap<int, QMap<int, QList<CpuInfo> > >::const_iterator package = node->constBegin(); package != node->constEnd(); ++package)
+    {
+      QTreeWidgetItem *packageItem = nodeItem ? new QTreeWidgetItem(nodeItem) : new QTreeWidgetItem(tree);
+      packageItem->setText(0, i18n("Socket %1", package.key()));
+      packageItem->setFlags(packageItem->flags() | Qt::ItemIsUserCheckable | Qt::ItemIsTristate);
+      packageItem->setExpanded(true);
+      for (QMap<int, QList<CpuInfo> >::const_iterator core = package->constBegin(); core != package->constEnd(); ++core)
+      {
+        QTreeWidgetItem *coreItem = new QTreeWidgetItem(packageItem, QStringList() << i18n("Core %1", core.key()));
+        coreItem->setFlags(coreItem->flags() | Qt::ItemIsUserCheckable | Qt::ItemIsTristate);
+        foreach (const CpuInfo &info, core.value())
+        {
+          QTreeWidgetItem *cpuItem = new QTreeWidgetItem(coreItem);
+          cpuItem->setText(0, info.online ? i18n("CPU %1", info.cpu) : i18n("CPU %1 (offline)", info.cpu));
+          cpuItem->setText(1, info.siblings);
+          cpuItem->setData(0, Qt::UserRole, info.cpu);
+          cpuItem->setFlags(cpuItem->flags() | Qt::ItemIsUserCheckable);
+          bool selected = mask.isEmpty() || (info.cpu / 8 < mask.size() && (mask.at(info.cpu / 8) & (1 << (info.cpu % 8))));
+          cpuItem->setCheckState(0, selected ? Qt::Checked : Qt::Unchecked);
+          cpuItems << cpuItem;
+        }
+        coreItem->setExpanded(core.value().size() > 1);
+      }
+    }
+  }
+  tree->resizeColumnToContents(0);
+  connect(tree, SIGNAL(itemChanged(QTreeWidgetItem*,int)), this, SLOT(slotItemChanged()));
+
+  lblSelection = new QLabel(this);
+
+  overrides = new QTreeWidget(this);
+  overrides->setHeaderLabels(QStringList() << i18n("Unit") << i18n("CPU Affinity"));
+  overrides->setRootIsDecorated(false);
+  overrides->setMaximumHeight(120);
+
+  QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok |
+                                                     QDialogButtonBox::Cancel,
+                                                     this);
+  btnOk = buttonBox->button(QDialogButtonBox::Ok);
+  connect(buttonBox, SIGNAL(accepted()), this, SLOT(accept()));
+  connect(buttonBox, SIGNAL(rejected()), this, SLOT(reject()));
+
+  QVBoxLayout *vlayout = new QVBoxLayout;
+  vlayout->addWidget(tree);
+  vlayout->addWidget(lblSelection);
+  vlayout->addWidget(new QLabel(i18n("Running services with their own affinity:"), this));
+  vlayout->addWidget(overrides);
+  vlayout->addWidget(buttonBox);
+  setLayout(vlayout);
+  resize(480, 560);
+
+  slotItemChanged();
+  if (units)
+    queryOverrides(units);
+}
+
+QByteArray CpuAffinityDialog::selectedMask(int *count) const
+{
+  QByteArray mask;
+  *count = 0;
+  foreach (QTreeWidgetItem *item, cpuItems)
+  {
+    if (item->checkState(0) != Qt::Checked)
+      continue;
+    int cpu = item->data(0, Qt::UserRole).toInt();
+    if (mask.size() <= cpu / 8)
+      mask.append(QByteArray(cpu / 8 + 1 - mask.size(), '\0'));
+    mask[cpu / 8] = mask.at(cpu / 8) | char(1 << (cpu % 8));
+    ++*count;
+  }
+  return mask;
+}
+
+void CpuAffinityDialog::slotItemChanged()
+{
+  // At least one CPU has to stay selected
+  int count;
+  QByteArray mask = selectedMask(&count);
+  if (count == 0)
+    lblSelection->setText(i18n("<b>Select at least one CPU.</b>"));
+  else if (count == cpuItems.size())
+    lblSelection->setText(i18n("All CPUs (%1)", cpuMaskToList(mask)));
+  else
+    lblSelection->setText(i18n("CPUAffinity=%1", cpuMaskToList(mask)));
+  btnOk->setEnabled(count > 0);
+}
+
+QString CpuAffinityDialog::cpus() const
+{
+  int count;
+  QByteArray mask = selectedMask(&count);
+  if (count == cpuItems.size())
+    return QString();
+  return cpuMaskToList(mask);
+}
+
+void CpuAffinityDialog::queryOverrides(const QList<SystemdUnit> *units)
+{
+  // One asynchronous Get per running service
+  QDBusConnection bus = QDBusConnection::systemBus();
+  foreach (const SystemdUnit &unit, *units)
+  {
+    if (!unit.id.endsWith(QLatin1String(".service")) || unit.active_state != QLatin1String("active") ||
+        unit.unit_path.path().isEmpty())
+      continue;
+    QDBusMessage msg = QDBusMessage::createMethodCall(connSystemd, unit.unit_path.path(),
+                                                      QStringLiteral("org.freedesktop.DBus.Properties"),
+                                                      QStringLiteral("Get"));
+    msg << QStringLiteral("org.freedesktop.systemd1.Service") << QStringLiteral("CPUAffinity");
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(bus.asyncCall(msg), this);
+    watcher->setProperty("unit", unit.id);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(slotAffinityReply(QDBusPendingCallWatcher*)));
+  }
+}
+
+void CpuAffinityDialog::slotAffinityReply(QDBusPendingCallWatcher *watcher)
+{
+  QDBusPendingReply<QDBusVariant> reply = *watcher;
+  watcher->deleteLater();
+  if (reply.isError())
+    return;
+
+  QString cpus = cpuMaskToList(reply.value().variant().toByteArray());
+  if (cpus.isEmpty())
+    return;
+  new QTreeWidgetItem(overrides, QStringList() << watcher->property("unit").toString() << cpus);
+  overrides->sortItems(0, Qt::AscendingOrder);
+}
+
+CpuSetEditor::CpuSetEditor(QWidget *parent, const QList<SystemdUnit> *units)
+ : QWidget(parent)
+{
+  unitList = units;
+  lineEdit = new QLineEdit(this);
+  lineEdit->setFrame(false);
+  lineEdit->setPlaceholderText(i18n("All CPUs"));
+  QToolButton *button = new QToolButton(this);
+  button->setText(QStringLiteral("..."));
+  button->setToolTip(i18n("Choose CPUs by topology"));
+  connect(button, SIGNAL(clicked()), this, SLOT(slotShowDialog()));
+
+  QHBoxLayout *layout = new QHBoxLayout;
+  layout->setContentsMargins(0, 0, 0, 0);
+  layout->setSpacing(0);
+  layout->addWidget(lineEdit);
+  layout->addWidget(button);
+  setLayout(layout);
+  setFocusProxy(lineEdit);
+}
+
+QString CpuSetEditor::text() const
+{
+  return lineEdit->text();
+}
+
+void CpuSetEditor::setText(const QString &text)
+{
+  lineEdit->setText(text);
+}
+
+void CpuSetEditor::slotShowDialog()
+{
+  // The dialog is a child of the editor, so the delegate does not close
+  // the editor when the dialog takes the focus
+  QPointer<CpuAffinityDialog> dlg = new CpuAffinityDialog(this, lineEdit->text(), unitList);
+  int result = dlg->exec();
+  if (dlg && result == QDialog::Accepted)
+    lineEdit->setText(dlg->cpus());
+  delete dlg;
+}
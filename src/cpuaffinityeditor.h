@@ -0,0 +1,80 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef CPUAFFINITYEDITOR_H
+#define CPUAFFINITYEDITOR_H
+
+#include <QDialog>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QtDBus/QtDBus>
+
+#include "systemdunit.h"
+#include "cputopology.h"
+
+// Picks CPUs by NUMA node, socket, core and SMT sibling, and lists the
+// running services that set an affinity of their own
+class CpuAffinityDialog : public QDialog
+{
+  Q_OBJECT
+
+public:
+  CpuAffinityDialog(QWidget *parent, const QString &cpus, const QList<SystemdUnit> *units);
+
+  /**
+   * \return the selected CPUs in range syntax, or an empty string if all
+   * CPUs are selected.
+   */
+  QString cpus() const;
+
+private slots:
+  void slotItemChanged();
+  void slotAffinityReply(QDBusPendingCallWatcher *);
+
+private:
+  void queryOverrides(const QList<SystemdUnit> *units);
+  QByteArray selectedMask(int *count) const;
+
+  QTreeWidget *tree, *overrides;
+  QLabel *lblSelection;
+  QList<QTreeWidgetItem *> cpuItems;
+  QPushButton *btnOk;
+};
+
+// Cell editor for CPU sets in the configuration table, a line edit with
+// a button opening the CpuAffinityDialog
+class CpuSetEditor : public QWidget
+{
+  Q_OBJECT
+
+public:
+  CpuSetEditor(QWidget *parent, const QList<SystemdUnit> *units);
+  QString text() const;
+  void setText(const QString &text);
+
+private slots:
+  void slotShowDialog();
+
+private:
+  QLineEdit *lineEdit;
+  const QList<SystemdUnit> *unitList;
+};
+
+#endif // CPUAFFINITYEDITOR_H
@@ -0,0 +1,122 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "cputopology.h"
+
+#include <QDir>
+#include <QFile>
+#include <QRegExp>
+#include <QStringList>
+
+static const QString cpuDir = QStringLiteral("/sys/devices/system/cpu");
+static const QString nodeDir = QStringLiteral("/sys/devices/system/node");
+
+static QString readLine(const QString &path)
+{
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly))
+    return QString();
+  return QString::fromLatin1(file.readLine()).trimmed();
+}
+
+QList<CpuInfo> readCpuTopology()
+{
+  QList<CpuInfo> list;
+  bool ok;
+  QByteArray present = cpuListToMask(readLine(cpuDir + QStringLiteral("/present")), &ok);
+  QByteArray online = cpuListToMask(readLine(cpuDir + QStringLiteral("/online")), &ok);
+
+  for (int cpu = 0; cpu < present.size() * 8; ++cpu)
+  {
+    if (!(present.at(cpu / 8) & (1 << (cpu % 8))))
+      continue;
+
+    // The topology of offline CPUs is not known
+    CpuInfo info;
+    info.cpu = cpu;
+    info.online = cpu / 8 < online.size() && (online.at(cpu / 8) & (1 << (cpu % 8)));
+    QString topology = QStringLiteral("%1/cpu%2/topology/").arg(cpuDir).arg(cpu);
+    info.package = qMax(0, readLine(topology + QStringLiteral("physical_package_id")).toInt());
+    info.core = readLine(topology + QStringLiteral("core_id")).toInt();
+    info.siblings = readLine(topology + QStringLiteral("thread_siblings_list"));
+    list << info;
+  }
+
+  // Machines without NUMA have no node directories, everything is node 0
+  QStringList nodes = QDir(nodeDir).entryList(QStringList() << QStringLiteral("node*"), QDir::Dirs);
+  foreach (const QString &node, nodes)
+  {
+    QByteArray mask = cpuListToMask(readLine(nodeDir + '/' + node + QStringLiteral("/cpulist")), &ok);
+    for (int i = 0; i < list.size(); ++i)
+    {
+      int cpu = list.at(i).cpu;
+      if (cpu / 8 < mask.size() && (mask.at(cpu / 8) & (1 << (cpu % 8))))
+        list[i].node = node.mid(4).toInt();
+    }
+  }
+  return list;
+}
+
+QByteArray cpuListToMask(const QString &cpus, bool *ok)
+{
+  // Bit n of byte n/8 is set for CPU n
+  QByteArray mask;
+  *ok = true;
+  foreach (const QString &item, cpus.split(QRegExp("[,\\s]+"), QString::SkipEmptyParts))
+  {
+    QString range = item.trimmed();
+    int first, last;
+    bool ok1, ok2 = true;
+    if (range.contains('-'))
+    {
+      first = range.section('-', 0, 0).toInt(&ok1);
+      last = range.section('-', 1, 1).toInt(&ok2);
+    }
+    else
+    {
+      first = last = range.toInt(&ok1);
+    }
+    if (!ok1 || !ok2 || first < 0 || last < first || last >= 8192)
+    {
+      *ok = false;
+      return QByteArray();
+    }
+    if (mask.size() <= last / 8)
+      mask.append(QByteArray(last / 8 + 1 - mask.size(), '\0'));
+    for (int cpu = first; cpu <= last; ++cpu)
+      mask[cpu / 8] = mask.at(cpu / 8) | char(1 << (cpu % 8));
+  }
+  return mask;
+}
+
+QString cpuMaskToList(const QByteArray &mask)
+{
+  QStringList ranges;
+  int bits = mask.size() * 8;
+  for (int cpu = 0; cpu < bits; ++cpu)
+  {
+    if (!(mask.at(cpu / 8) & (1 << (cpu % 8))))
+      continue;
+    int last = cpu;
+    while (last + 1 < bits && (mask.at((last + 1) / 8) & (1 << ((last + 1) % 8))))
+      ++last;
+    ranges << (last == cpu ? QString::number(cpu) : QString("%1-%2").arg(cpu).arg(last));
+    cpu = last;
+  }
+  return ranges.join(',');
+}
@@ -0,0 +1,45 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef CPUTOPOLOGY_H
+#define CPUTOPOLOGY_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+// Where a logical CPU sits in the machine
+struct CpuInfo
+{
+  int cpu = 0, package = 0, core = 0, node = 0;
+  QString siblings;
+  bool online = true;
+};
+
+// Reads the CPUs from /sys/devices/system/cpu and their NUMA nodes from
+// /sys/devices/system/node, ordered by CPU number
+QList<CpuInfo> readCpuTopology();
+
+// Converts between a CPU list such as "0-3,8" and the byte mask used by
+// the AllowedCPUs and CPUAffinity properties. The list may be separated
+// by commas or whitespace, as in the configuration files. An empty list
+// is an empty mask, which means all CPUs.
+QByteArray cpuListToMask(const QString &cpus, bool *ok);
+QString cpuMaskToList(const QByteArray &mask);
+
+#endif // CPUTOPOLOGY_H
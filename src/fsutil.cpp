@@ -18,8 +18,16 @@
 #include "fsutil.h"
 
 #include <QtDebug>
+#include <QFile>
+#include <QRunnable>
+#include <QThreadPool>
 #include <kdiskfreespaceinfo.h>
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 qulonglong getPartitionSize(const QString &path, bool *ok) {
 
   KDiskFreeSpaceInfo info = KDiskFreeSpaceInfo::freeSpaceInfo(path);
@@ -36,3 +44,115 @@ qulonglong getPartitionSize(const QString &path, bool *ok) {
 
   return info.size();
 }
+
+static bool dirModTime(const QString &dir, qint64 *sec, qint64 *nsec)
+{
+  struct stat st;
+  if (stat(QFile::encodeName(dir).constData(), &st) != 0)
+    return false;
+  *sec = st.st_mtim.tv_sec;
+  *nsec = st.st_mtim.tv_nsec;
+  return true;
+}
+
+static void scanDirectory(const QString &dir, SymlinkCache::Directory *result)
+{
+  // Collect the symbolic links in dir, using the file type from readdir()
+  // and only falling back to fstatat() where the filesystem does not
+  // provide it.
+
+  result->links.clear();
+  int dirfd = open(QFile::encodeName(dir).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dirfd < 0)
+    return;
+
+  // Take the mtime before reading, so a change during the scan triggers a rescan
+  struct stat st;
+  if (fstat(dirfd, &st) == 0)
+  {
+    result->mtimeSec = st.st_mtim.tv_sec;
+    result->mtimeNsec = st.st_mtim.tv_nsec;
+  }
+
+  // fdopendir() takes ownership of the descriptor, keep our own for fstatat()
+  DIR *d = fdopendir(dup(dirfd));
+  if (!d)
+  {
+    close(dirfd);
+    return;
+  }
+
+  struct dirent *entry;
+  while ((entry = readdir(d)) != NULL)
+  {
+    bool link = false;
+    if (entry->d_type == DT_LNK)
+      link = true;
+    else if (entry->d_type == DT_UNKNOWN &&
+             fstatat(dirfd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0)
+      link = S_ISLNK(st.st_mode);
+
+    if (link)
+      result->links.insert(QFile::decodeName(entry->d_name));
+  }
+
+  closedir(d);
+  close(dirfd);
+}
+
+class ScanDirectoryTask : public QRunnable
+{
+public:
+  ScanDirectoryTask(const QString &dir, SymlinkCache::Directory *result)
+    : m_dir(dir), m_result(result) {}
+  void run() Q_DECL_OVERRIDE { scanDirectory(m_dir, m_result); }
+
+private:
+  QString m_dir;
+  SymlinkCache::Directory *m_result;
+};
+
+void SymlinkCache::refresh(const QStringList &files)
+{
+  QSet<QString> dirNames;
+  foreach (const QString &file, files)
+    dirNames.insert(file.section('/', 0, -2));
+
+  // Find the directories that are new or have been modified
+  QStringList stale;
+  foreach (const QString &dir, dirNames)
+  {
+    qint64 sec, nsec;
+    QHash<QString, Directory>::const_iterator it = dirs.constFind(dir);
+    if (!dirModTime(dir, &sec, &nsec))
+      dirs.remove(dir);
+    else if (it == dirs.constEnd() || it->mtimeSec != sec || it->mtimeNsec != nsec)
+      stale << dir;
+  }
+
+  if (stale.isEmpty())
+    return;
+
+  QVector<Directory> results(stale.size());
+  if (stale.size() == 1)
+    scanDirectory(stale.first(), &results[0]);
+  else
+  {
+    QThreadPool pool;
+    for (int i = 0; i < stale.size(); ++i)
+      pool.start(new ScanDirectoryTask(stale.at(i), &results[i]));
+    pool.waitForDone();
+  }
+
+  for (int i = 0; i < stale.size(); ++i)
+    dirs.insert(stale.at(i), results.at(i));
+}
+
+bool SymlinkCache::isSymLink(const QString &path) const
+{
+  int slash = path.lastIndexOf('/');
+  QHash<QString, Directory>::const_iterator it = dirs.constFind(path.left(slash));
+  if (it == dirs.constEnd())
+    return false;
+  return it->links.contains(path.mid(slash + 1));
+}
@@ -19,6 +19,9 @@
 #define KCMSYSTEMD_FSUTIL_H
 
 #include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
 
 /**
  *
@@ -40,4 +43,47 @@
  */
 qulonglong getPartitionSize(const QString &path, bool *ok = NULL);
 
+/**
+ *
+ * \brief remembers which entries of a set of directories are symbolic links.
+ * Use like this:
+ * \code
+ * SymlinkCache cache;
+ * cache.refresh(listOfFiles);
+ * foreach (const QString &file, listOfFiles)
+ *   if (!cache.isSymLink(file))
+ *     doSomething(file);
+ * \code
+ *
+ * Every directory is read in a single pass with fstatat() relative to a
+ * directory file descriptor, and is only read again once its modification
+ * time has changed.
+ */
+class SymlinkCache
+{
+public:
+  /**
+   * \brief makes sure the directories containing the given files are cached.
+   * Directories which have not been read yet, or have changed since, are
+   * scanned in parallel on a thread pool.
+   * \param files Absolute paths of files.
+   */
+  void refresh(const QStringList &files);
+
+  /**
+   * \return true if path is a symbolic link. The directory containing path
+   * must have been passed to refresh() first, otherwise false is returned.
+   */
+  bool isSymLink(const QString &path) const;
+
+  struct Directory
+  {
+    qint64 mtimeSec = -1, mtimeNsec = -1;
+    QSet<QString> links;
+  };
+
+private:
+  QHash<QString, Directory> dirs;
+};
+
 #endif
@@ -21,6 +21,7 @@
 #include <QFile>
 
 #include "../config.h"
+#include "../unitproperty.h"
 
 ActionReply Helper::save(const QVariantMap& args)
 {
@@ -78,6 +79,16 @@ ActionReply Helper::dbusaction(const QVariantMap& args)
   QString interface = args["interface"].toString();
   QString method = args["method"].toString();
   QList<QVariant> argsForCall = args["argsForCall"].toList();
+
+  // Property arrays arrive as plain lists, see unitPropertiesToVariant()
+  if ((method == "SetUnitProperties" && argsForCall.size() == 3) ||
+      (method == "StartTransientUnit" && argsForCall.size() == 4))
+  {
+    registerUnitPropertyTypes();
+    argsForCall[2] = QVariant::fromValue(unitPropertiesFromVariant(argsForCall.at(2).toList()));
+  }
+  if (method == "StartTransientUnit" && argsForCall.size() == 4)
+    argsForCall[3] = QVariant::fromValue(AuxUnitList());
   
   QDBusConnection systembus = QDBusConnection::systemBus();  
   QDBusInterface *iface = new QDBusInterface (service,
@@ -0,0 +1,287 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "joblatencytracker.h"
+
+#include <KConfigGroup>
+#include <KSharedConfig>
+
+#include <algorithm>
+#include <time.h>
+
+static const QString connSystemd = QStringLiteral("org.freedesktop.systemd1");
+static const QString pathSysdMgr = QStringLiteral("/org/freedesktop/systemd1");
+static const QString ifaceMgr = QStringLiteral("org.freedesktop.systemd1.Manager");
+static const QString ifaceUnit = QStringLiteral("org.freedesktop.systemd1.Unit");
+static const QString ifaceDbusProp = QStringLiteral("org.freedesktop.DBus.Properties");
+
+static const int maxHistory = 10;
+
+// Actions that never got a job (authorization refused, unit not found)
+// are forgotten after this long
+static const qulonglong pendingTimeout = 120000000;
+
+JobLatencyTracker::JobLatencyTracker(QObject *parent, const QString &userBusPath)
+ : QObject(parent),
+   userBus(QDBusConnection::connectToBus(userBusPath, connSystemd))
+{
+  // The module has already subscribed to the signals of both managers
+  QDBusConnection systembus = QDBusConnection::systemBus();
+  systembus.connect(connSystemd, pathSysdMgr, ifaceMgr, QStringLiteral("JobNew"),
+                    this, SLOT(slotSystemJobNew(uint,QDBusObjectPath,QString)));
+  systembus.connect(connSystemd, pathSysdMgr, ifaceMgr, QStringLiteral("JobRemoved"),
+                    this, SLOT(slotSystemJobRemoved(uint,QDBusObjectPath,QString,QString)));
+  userBus.connect(connSystemd, pathSysdMgr, ifaceMgr, QStringLiteral("JobNew"),
+                  this, SLOT(slotUserJobNew(uint,QDBusObjectPath,QString)));
+  userBus.connect(connSystemd, pathSysdMgr, ifaceMgr, QStringLiteral("JobRemoved"),
+                  this, SLOT(slotUserJobRemoved(uint,QDBusObjectPath,QString,QString)));
+  load();
+}
+
+QString JobLatencyTracker::unitKey(const QString &unit, bool userUnit)
+{
+  return (userUnit ? QStringLiteral("u:") : QStringLiteral("s:")) + unit;
+}
+
+qulonglong JobLatencyTracker::monotonicNow()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return qulonglong(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+QString JobLatencyTracker::unitPath(const QString &unit)
+{
+  // Object paths of units are their names with everything but letters
+  // and digits escaped as _xx, as sd-bus does it
+  QString path = QStringLiteral("/org/freedesktop/systemd1/unit/");
+  QByteArray name = unit.toUtf8();
+  for (int i = 0; i < name.size(); ++i)
+  {
+    char c = name.at(i);
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (i > 0 && c >= '0' && c <= '9'))
+      path.append(QLatin1Char(c));
+    else
+      path.append(QStringLiteral("_%1").arg(uint(uchar(c)), 2, 16, QLatin1Char('0')));
+  }
+  return path;
+}
+
+void JobLatencyTracker::actionStarted(const QString &unit, const QString &method, bool userUnit)
+{
+  // Called right before the start or restart is sent, so that the
+  // job systemd creates for it can be recognized
+  PendingAction action;
+  action.unit = unit;
+  action.action = method == QLatin1String("RestartUnit") ? QStringLiteral("restart") : QStringLiteral("start");
+  action.userUnit = userUnit;
+  action.time = QDateTime::currentDateTime();
+  action.triggered = monotonicNow();
+
+  for (int i = pending.size() - 1; i >= 0; --i)
+  {
+    if ((pending.at(i).job == 0 && action.triggered - pending.at(i).triggered > pendingTimeout) ||
+        (pending.at(i).job == 0 && pending.at(i).unit == unit && pending.at(i).userUnit == userUnit))
+      pending.removeAt(i);
+  }
+  pending << action;
+}
+
+QList<JobLatencyRecord> JobLatencyTracker::history(const QString &unit, bool userUnit) const
+{
+  return records.value(unitKey(unit, userUnit));
+}
+
+bool JobLatencyTracker::latest(const QString &unit, bool userUnit, JobLatencyRecord *record) const
+{
+  QHash<QString, QList<JobLatencyRecord> >::const_iterator it = records.constFind(unitKey(unit, userUnit));
+  if (it == records.constEnd() || it->isEmpty())
+    return false;
+  *record = it->last();
+  return true;
+}
+
+bool JobLatencyTracker::isRegression(const QString &unit, bool userUnit) const
+{
+  // The last start is a regression if it took more than twice the
+  // median of the earlier successful ones, and at least 200 ms longer
+  QList<JobLatencyRecord> list = history(unit, userUnit);
+  if (list.isEmpty() || !list.last().active)
+    return false;
+
+  QList<qulonglong> earlier;
+  for (int i = 0; i < list.size() - 1; ++i)
+  {
+    if (list.at(i).active)
+      earlier << list.at(i).total;
+  }
+  if (earlier.size() < 3)
+    return false;
+
+  std::sort(earlier.begin(), earlier.end());
+  qulonglong median = earlier.at(earlier.size() / 2);
+  qulonglong last = list.last().total;
+  return last > 2 * median && last - median > 200000;
+}
+
+void JobLatencyTracker::slotSystemJobNew(uint id, const QDBusObjectPath &, const QString &unit)
+{
+  jobNew(id, unit, false);
+}
+
+void JobLatencyTracker::slotSystemJobRemoved(uint id, const QDBusObjectPath &, const QString &unit, const QString &result)
+{
+  jobRemoved(id, unit, result, false);
+}
+
+void JobLatencyTracker::slotUserJobNew(uint id, const QDBusObjectPath &, const QString &unit)
+{
+  jobNew(id, unit, true);
+}
+
+void JobLatencyTracker::slotUserJobRemoved(uint id, const QDBusObjectPath &, const QString &unit, const QString &result)
+{
+  jobRemoved(id, unit, result, true);
+}
+
+void JobLatencyTracker::jobNew(uint id, const QString &unit, bool userUnit)
+{
+  // The first job for the unit after the action is taken to be its job
+  for (int i = 0; i < pending.size(); ++i)
+  {
+    PendingAction &action = pending[i];
+    if (action.job == 0 && action.unit == unit && action.userUnit == userUnit)
+    {
+      action.job = id;
+      action.queued = monotonicNow();
+      return;
+    }
+  }
+}
+
+void JobLatencyTracker::jobRemoved(uint id, const QString &unit, const QString &result, bool userUnit)
+{
+  for (int i = 0; i < pending.size(); ++i)
+  {
+    if (pending.at(i).job != id || pending.at(i).unit != unit || pending.at(i).userUnit != userUnit)
+      continue;
+
+    PendingAction action = pending.takeAt(i);
+    action.removed = monotonicNow();
+    action.result = result;
+
+    // The timestamps of the state transitions tell when the unit
+    // actually became active, independent of how late the signal came
+    QDBusMessage msg = QDBusMessage::createMethodCall(connSystemd, unitPath(unit), ifaceDbusProp, QStringLiteral("GetAll"));
+    msg << ifaceUnit;
+    QDBusConnection bus = userUnit ? userBus : QDBusConnection::systemBus();
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(bus.asyncCall(msg), this);
+    finishing.insert(watcher, action);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(slotUnitReply(QDBusPendingCallWatcher*)));
+    return;
+  }
+}
+
+void JobLatencyTracker::slotUnitReply(QDBusPendingCallWatcher *watcher)
+{
+  QDBusPendingReply<QVariantMap> reply = *watcher;
+  watcher->deleteLater();
+  PendingAction action = finishing.take(watcher);
+
+  JobLatencyRecord rec;
+  rec.time = action.time;
+  rec.action = action.action;
+  rec.result = action.result;
+  rec.wait = action.queued - action.triggered;
+  rec.total = action.removed - action.queued;
+
+  if (!reply.isError())
+  {
+    QVariantMap props = reply.value();
+    qulonglong activeExit = props.value(QStringLiteral("ActiveExitTimestampMonotonic")).toULongLong();
+    qulonglong inactiveEnter = props.value(QStringLiteral("InactiveEnterTimestampMonotonic")).toULongLong();
+    qulonglong inactiveExit = props.value(QStringLiteral("InactiveExitTimestampMonotonic")).toULongLong();
+    qulonglong activeEnter = props.value(QStringLiteral("ActiveEnterTimestampMonotonic")).toULongLong();
+
+    // Transitions from before the action belong to an earlier run. The
+    // phases are measured between systemd's own timestamps, as the job
+    // signals may arrive here well after the unit changed state.
+    bool stopped = action.action == QLatin1String("restart") &&
+                   activeExit >= action.triggered && inactiveEnter >= activeExit;
+    if (stopped)
+      rec.stopping = inactiveEnter - activeExit;
+    if (action.result == QLatin1String("done") &&
+        inactiveExit >= action.triggered && activeEnter >= inactiveExit)
+    {
+      rec.active = true;
+      rec.activating = activeEnter - inactiveExit;
+      rec.total = activeEnter - (stopped ? activeExit : inactiveExit);
+    }
+  }
+  record(action, rec);
+}
+
+void JobLatencyTracker::record(const PendingAction &action, const JobLatencyRecord &rec)
+{
+  QString key = unitKey(action.unit, action.userUnit);
+  QList<JobLatencyRecord> &list = records[key];
+  list << rec;
+  while (list.size() > maxHistory)
+    list.removeFirst();
+
+  QStringList entries;
+  foreach (const JobLatencyRecord &r, list)
+  {
+    entries << QStringLiteral("%1|%2|%3|%4|%5|%6|%7|%8")
+               .arg(r.time.toString(Qt::ISODate), r.action, r.result)
+               .arg(r.wait).arg(r.stopping).arg(r.activating).arg(r.total)
+               .arg(r.active ? 1 : 0);
+  }
+  KConfigGroup cfg(KSharedConfig::openConfig("kcmsystemdrc"), "JobLatency");
+  cfg.writeEntry(key, entries);
+  cfg.sync();
+
+  emit latencyRecorded(action.unit, action.userUnit);
+}
+
+void JobLatencyTracker::load()
+{
+  KConfigGroup cfg(KSharedConfig::openConfig("kcmsystemdrc"), "JobLatency");
+  foreach (const QString &key, cfg.keyList())
+  {
+    QList<JobLatencyRecord> list;
+    foreach (const QString &entry, cfg.readEntry(key, QStringList()))
+    {
+      QStringList fields = entry.split('|');
+      if (fields.size() != 8)
+        continue;
+      JobLatencyRecord r;
+      r.time = QDateTime::fromString(fields.at(0), Qt::ISODate);
+      r.action = fields.at(1);
+      r.result = fields.at(2);
+      r.wait = fields.at(3).toULongLong();
+      r.stopping = fields.at(4).toULongLong();
+      r.activating = fields.at(5).toULongLong();
+      r.total = fields.at(6).toULongLong();
+      r.active = fields.at(7) == QLatin1String("1");
+      list << r;
+    }
+    if (!list.isEmpty())
+      records.insert(key, list);
+  }
+}
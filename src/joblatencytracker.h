@@ -0,0 +1,90 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef JOBLATENCYTRACKER_H
+#define JOBLATENCYTRACKER_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QHash>
+#include <QtDBus/QtDBus>
+
+// One start or restart triggered from the unit lists. All spans are in
+// microseconds and measured on the monotonic clock systemd uses for its
+// own timestamps.
+struct JobLatencyRecord
+{
+  QDateTime time;
+  QString action, result;
+  qulonglong wait = 0;        // from the action until the job was seen here
+  qulonglong stopping = 0;    // restarts: from leaving active until inactive
+  qulonglong activating = 0;  // from leaving inactive until active
+  qulonglong total = 0;       // stopping and activating, or until the job finished
+  bool active = false;
+};
+
+// Follows the jobs of starts and restarts from JobNew to JobRemoved and
+// reads the unit's state transitions when the job is done. The last
+// records of each unit are kept in kcmsystemdrc.
+class JobLatencyTracker : public QObject
+{
+  Q_OBJECT
+
+public:
+  explicit JobLatencyTracker(QObject *parent = 0, const QString &userBusPath = QString());
+  void actionStarted(const QString &unit, const QString &method, bool userUnit);
+  QList<JobLatencyRecord> history(const QString &unit, bool userUnit) const;
+  bool latest(const QString &unit, bool userUnit, JobLatencyRecord *record) const;
+  bool isRegression(const QString &unit, bool userUnit) const;
+  static QString unitPath(const QString &unit);
+
+signals:
+  void latencyRecorded(const QString &unit, bool userUnit);
+
+private slots:
+  void slotSystemJobNew(uint id, const QDBusObjectPath &job, const QString &unit);
+  void slotSystemJobRemoved(uint id, const QDBusObjectPath &job, const QString &unit, const QString &result);
+  void slotUserJobNew(uint id, const QDBusObjectPath &job, const QString &unit);
+  void slotUserJobRemoved(uint id, const QDBusObjectPath &job, const QString &unit, const QString &result);
+  void slotUnitReply(QDBusPendingCallWatcher *watcher);
+
+private:
+  struct PendingAction
+  {
+    QString unit, action;
+    bool userUnit = false;
+    QDateTime time;
+    qulonglong triggered = 0, queued = 0, removed = 0;
+    uint job = 0;
+    QString result;
+  };
+
+  static QString unitKey(const QString &unit, bool userUnit);
+  static qulonglong monotonicNow();
+  void jobNew(uint id, const QString &unit, bool userUnit);
+  void jobRemoved(uint id, const QString &unit, const QString &result, bool userUnit);
+  void record(const PendingAction &action, const JobLatencyRecord &rec);
+  void load();
+
+  QDBusConnection userBus;
+  QList<PendingAction> pending;
+  QHash<QDBusPendingCallWatcher *, PendingAction> finishing;
+  QHash<QString, QList<JobLatencyRecord> > records;
+};
+
+#endif // JOBLATENCYTRACKER_H
@@ -19,18 +19,28 @@
 #include "kcmsystemd.h"
 #include "confparms.h"
 #include "fsutil.h"
+#include "resourcelimitdialog.h"
+#include "transientunitdialog.h"
+#include "timeranalyzerdialog.h"
 
 #include <unistd.h>
 
+#include <QComboBox>
+#include <QFormLayout>
 #include <QMouseEvent>
 #include <QMenu>
 #include <QPlainTextEdit>
+#include <QScrollBar>
+#include <QSpinBox>
+#include <QToolTip>
 
 #include <KAboutData>
 #include <KPluginFactory>
 #include <KMessageBox>
 #include <KAuth>
 #include <KColorScheme>
+#include <KSharedConfig>
+#include <KConfigGroup>
 using namespace KAuth;
 
 K_PLUGIN_FACTORY(kcmsystemdFactory, registerPlugin<kcmsystemd>();)
@@ -130,23 +140,49 @@ kcmsystemd::kcmsystemd(QWidget *parent, const QVariantList &args) : KCModule(par
   userbus.connect(connSystemd, pathSysdMgr, ifaceMgr,
                   QStringLiteral("JobRemoved"), this, SLOT(slotUserUnitsChanged()));
 
-  // logind
-  systembus.connect(connLogind, "", ifaceDbusProp,
-                    QStringLiteral("PropertiesChanged"), this,
-                    SLOT(slotLogindPropertiesChanged(QString,QVariantMap,QStringList)));
-  
-  // Get list of units
-  slotRefreshUnitsList(true, sys);
-  slotRefreshUnitsList(true, user);
+  // Get list of units. If the last run left a snapshot, show it right
+  // away and load the live lists in the background.
+  cacheLoaded = readUnitCache(&unitCache);
+  if (cacheLoaded)
+  {
+    unitslist = unitCache.systemUnits;
+    systemUnitIndex.update(unitslist);
+    systemUnitFacets.update(unitslist);
+    if (enableUserUnits)
+    {
+      userUnitslist = unitCache.userUnits;
+      userUnitIndex.update(userUnitslist);
+      userUnitFacets.update(userUnitslist);
+    }
+  }
+  else
+  {
+    slotRefreshUnitsList(true, sys);
+    slotRefreshUnitsList(true, user);
+  }
 
   setupUnitslist();
   setupConf();
   setupSessionlist();
   setupTimerlist();
+  setupUserlist();
+  setupSeatlist();
+  setupMonitor();
+  setupBoot();
+  setupShutdown();
+
+  if (cacheLoaded)
+  {
+    unitCache = UnitCacheData();
+    loadUnitsAsync(sys);
+    if (enableUserUnits)
+      loadUnitsAsync(user);
+  }
 }
 
 kcmsystemd::~kcmsystemd()
 {
+  saveUnitCache();
 }
 
 QDBusArgument &operator<<(QDBusArgument &argument, const SystemdUnit &unit)
@@ -220,6 +256,11 @@ void kcmsystemd::setupSignalSlots()
   connect(ui.tblUserUnits, SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(slotUnitContextMenu(QPoint)));
   connect(ui.leSearchUnit, SIGNAL(textChanged(QString)), this, SLOT(slotLeSearchUnitChanged(QString)));
   connect(ui.leSearchUserUnit, SIGNAL(textChanged(QString)), this, SLOT(slotLeSearchUnitChanged(QString)));
+  connect(ui.chkFuzzySearch, SIGNAL(stateChanged(int)), this, SLOT(slotChkFuzzySearch(int)));
+  connect(ui.chkFuzzyUserSearch, SIGNAL(stateChanged(int)), this, SLOT(slotChkFuzzySearch(int)));
+
+  // Connect signals for timers tab
+  connect(ui.tblTimers, SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(slotTimerContextMenu(QPoint)));
 
   // Connect signals for sessions tab
   connect(ui.tblSessions, SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(slotSessionContextMenu(QPoint)));
@@ -304,6 +345,7 @@ void kcmsystemd::setupConf()
   // Use a custom delegate to enable different editor elements in the QTableView
   ConfDelegate *myDelegate;
   myDelegate = new ConfDelegate(this, &confOptList);
+  myDelegate->setUnitList(&unitslist);
   ui.tblConf->setItemDelegate(myDelegate);
 
   ui.tblConf->horizontalHeader()->setDefaultAlignment(Qt::AlignLeft | Qt::AlignVCenter);
@@ -317,6 +359,7 @@ void kcmsystemd::setupUnitslist()
 
   // Register the meta type for storing units
   qDBusRegisterMetaType<SystemdUnit>();
+  registerUnitPropertyTypes();
 
   QMap<filterType, QString> filters;
   filters[activeState] = "";
@@ -332,6 +375,7 @@ void kcmsystemd::setupUnitslist()
   systemUnitFilterModel = new SortFilterUnitModel(this);
   systemUnitFilterModel->setDynamicSortFilter(false);
   systemUnitFilterModel->initFilterMap(filters);
+  systemUnitFilterModel->setSearchIndex(&systemUnitIndex);
   systemUnitFilterModel->setSourceModel(systemUnitModel);
   ui.tblUnits->setModel(systemUnitFilterModel);
   ui.tblUnits->sortByColumn(3, Qt::AscendingOrder);
@@ -342,10 +386,55 @@ void kcmsystemd::setupUnitslist()
   userUnitFilterModel = new SortFilterUnitModel(this);
   userUnitFilterModel->setDynamicSortFilter(false);
   userUnitFilterModel->initFilterMap(filters);
+  userUnitFilterModel->setSearchIndex(&userUnitIndex);
   userUnitFilterModel->setSourceModel(userUnitModel);
   ui.tblUserUnits->setModel(userUnitFilterModel);
   ui.tblUserUnits->sortByColumn(3, Qt::AscendingOrder);
 
+  // Optional resource columns, chosen from the context menu of the
+  // headers. Only the units that are on screen are sampled.
+  systemUnitMonitor = new UnitResourceMonitor(this);
+  systemUnitModel->setResourceMonitor(systemUnitMonitor);
+  userUnitMonitor = new UnitResourceMonitor(this, userBusPath);
+  userUnitModel->setResourceMonitor(userUnitMonitor);
+
+  // OOM kills and other memory events, noticed through inotify
+  memoryEventWatcher = new MemoryEventWatcher(this);
+  systemUnitModel->setMemoryEventWatcher(memoryEventWatcher);
+  userUnitModel->setMemoryEventWatcher(memoryEventWatcher);
+
+  // Time from starting or restarting a unit here until it is active
+  jobLatencyTracker = new JobLatencyTracker(this, userBusPath);
+  systemUnitModel->setJobLatencyTracker(jobLatencyTracker);
+  userUnitModel->setJobLatencyTracker(jobLatencyTracker);
+  connect(jobLatencyTracker, SIGNAL(latencyRecorded(QString,bool)), this, SLOT(slotJobLatencyRecorded(QString,bool)));
+
+  KConfigGroup cfg(KSharedConfig::openConfig("kcmsystemdrc"), "Units");
+  unitResourceColumns = cfg.readEntry("ResourceColumns", QList<int>());
+  unitSampleInterval = qBound(1000, cfg.readEntry("SampleInterval", 2000), 60000);
+
+  ui.tblUnits->horizontalHeader()->setContextMenuPolicy(Qt::CustomContextMenu);
+  ui.tblUserUnits->horizontalHeader()->setContextMenuPolicy(Qt::CustomContextMenu);
+  connect(ui.tblUnits->horizontalHeader(), SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(slotUnitHeaderContextMenu(QPoint)));
+  connect(ui.tblUserUnits->horizontalHeader(), SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(slotUnitHeaderContextMenu(QPoint)));
+
+  unitSampleTimer = new QTimer(this);
+  connect(unitSampleTimer, SIGNAL(timeout()), this, SLOT(slotSampleUnits()));
+  connect(ui.tblUnits->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(slotSampleUnits()));
+  connect(ui.tblUserUnits->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(slotSampleUnits()));
+  applyResourceColumns();
+
+  // User defined pressure triggers, see addPressureTrigger()
+  pressureWatcher = new PressureWatcher(this);
+  connect(pressureWatcher, SIGNAL(triggered(PressureTrigger)), this, SLOT(slotPressureTriggered(PressureTrigger)));
+  connect(pressureWatcher, SIGNAL(expired(PressureTrigger)), this, SLOT(slotPressureTriggerExpired(PressureTrigger)));
+
+  // Menus for the facet filters, which are filled when shown
+  ui.btnFacets->setMenu(new QMenu(ui.btnFacets));
+  ui.btnUserFacets->setMenu(new QMenu(ui.btnUserFacets));
+  connect(ui.btnFacets->menu(), SIGNAL(aboutToShow()), this, SLOT(slotFacetMenuAboutToShow()));
+  connect(ui.btnUserFacets->menu(), SIGNAL(aboutToShow()), this, SLOT(slotFacetMenuAboutToShow()));
+
   slotChkShowUnits(-1);
 }
 
@@ -356,58 +445,170 @@ void kcmsystemd::setupSessionlist()
   // Register the meta type for storing units
   qDBusRegisterMetaType<SystemdSession>();
 
-  // Setup model for session list
-  sessionModel = new QStandardItemModel(this);
+  // Setup model for session list. The users and seats tabs share the
+  // logind cache.
+  logindCache = new LogindCache(this);
+  sessionModel = new SessionModel(this, logindCache);
+  connect(sessionModel, SIGNAL(propertiesLoaded(QString)), this, SLOT(slotSessionPropertiesLoaded(QString)));
 
   // Install eventfilter to capture mouse move events
   ui.tblSessions->viewport()->installEventFilter(this);
 
-  // Set header row
-  sessionModel->setHorizontalHeaderItem(0, new QStandardItem(i18n("Session ID")));
-  sessionModel->setHorizontalHeaderItem(1, new QStandardItem(i18n("Session Object Path"))); // This column is hidden
-  sessionModel->setHorizontalHeaderItem(2, new QStandardItem(i18n("State")));
-  sessionModel->setHorizontalHeaderItem(3, new QStandardItem(i18n("User ID")));
-  sessionModel->setHorizontalHeaderItem(4, new QStandardItem(i18n("User Name")));
-  sessionModel->setHorizontalHeaderItem(5, new QStandardItem(i18n("Seat ID")));
   ui.tblSessions->horizontalHeader()->setDefaultAlignment(Qt::AlignLeft | Qt::AlignVCenter);
 
-  // Set model for QTableView (should be called after headers are set)
+  // Set model for QTableView
   ui.tblSessions->setModel(sessionModel);
   ui.tblSessions->setColumnHidden(1, true);
 
-  // Add all the sessions
+  // Show the sessions from the last run until logind has answered
+  if (cacheLoaded)
+    sessionModel->setCachedRows(unitCache.sessionRows);
+
+  // Changes are applied from the logind signals, the full lists are
+  // only fetched at startup and as an occasional resync
   slotRefreshSessionList();
+  sessionResyncTimer = new QTimer(this);
+  connect(sessionResyncTimer, SIGNAL(timeout()), this, SLOT(slotRefreshSessionList()));
+  sessionResyncTimer->start(300000);
+}
+
+void kcmsystemd::setupUserlist()
+{
+  // Sets up the users tab, with the sessions of the selected user below
+  userModel = new UserModel(this, logindCache);
+  userProxyModel = new QSortFilterProxyModel(this);
+  userProxyModel->setSourceModel(userModel);
+  ui.tblUsers->horizontalHeader()->setDefaultAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+  ui.tblUsers->setModel(userProxyModel);
+  ui.tblUsers->sortByColumn(0, Qt::AscendingOrder);
+
+  userSessionsProxyModel = new QSortFilterProxyModel(this);
+  userSessionsProxyModel->setSourceModel(sessionModel);
+  userSessionsProxyModel->setFilterKeyColumn(3);
+  ui.tblUserSessions->horizontalHeader()->setDefaultAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+  ui.tblUserSessions->setModel(userSessionsProxyModel);
+  ui.tblUserSessions->setColumnHidden(1, true);
+
+  connect(ui.tblUsers->selectionModel(), SIGNAL(currentRowChanged(QModelIndex,QModelIndex)),
+          this, SLOT(slotUserSelected(QModelIndex,QModelIndex)));
+
+  // Resource usage of the visible sessions and users, see slotSampleUsage()
+  userProxyModel->setSortRole(Qt::UserRole);
+  userSessionsProxyModel->setSortRole(Qt::UserRole);
+  usageTimer = new QTimer(this);
+  usageTimer->setSingleShot(true);
+  connect(usageTimer, SIGNAL(timeout()), this, SLOT(slotSampleUsage()));
+  connect(ui.tabWidget, SIGNAL(currentChanged(int)), this, SLOT(slotSampleUsage()));
+  usageTimer->start(usageInterval);
+}
+
+void kcmsystemd::setupSeatlist()
+{
+  // Sets up the seats tab, with the sessions of the selected seat below
+  seatModel = new SeatModel(this, logindCache);
+  seatProxyModel = new QSortFilterProxyModel(this);
+  seatProxyModel->setSourceModel(seatModel);
+  ui.tblSeats->horizontalHeader()->setDefaultAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+  ui.tblSeats->setModel(seatProxyModel);
+  ui.tblSeats->sortByColumn(0, Qt::AscendingOrder);
+
+  seatSessionsProxyModel = new QSortFilterProxyModel(this);
+  seatSessionsProxyModel->setSourceModel(sessionModel);
+  seatSessionsProxyModel->setFilterKeyColumn(5);
+  seatSessionsProxyModel->setSortRole(Qt::UserRole);
+  ui.tblSeatSessions->horizontalHeader()->setDefaultAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+  ui.tblSeatSessions->setModel(seatSessionsProxyModel);
+  ui.tblSeatSessions->setColumnHidden(1, true);
+
+  connect(ui.tblSeats->selectionModel(), SIGNAL(currentRowChanged(QModelIndex,QModelIndex)),
+          this, SLOT(slotSeatSelected(QModelIndex,QModelIndex)));
+}
+
+void kcmsystemd::setupMonitor()
+{
+  // Sets up the monitor tab, which ranks units by the resources their
+  // control groups use. It is only refreshed while it is visible.
+  cgroupTopModel = new CgroupTopModel(this, &unitslist, &userUnitslist);
+  monitorProxyModel = new QSortFilterProxyModel(this);
+  monitorProxyModel->setSourceModel(cgroupTopModel);
+  monitorProxyModel->setSortRole(Qt::UserRole);
+  monitorProxyModel->setDynamicSortFilter(true);
+  ui.tblMonitor->horizontalHeader()->setDefaultAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+  ui.tblMonitor->setModel(monitorProxyModel);
+  ui.tblMonitor->sortByColumn(2, Qt::DescendingOrder);
+
+  monitorTimer = new QTimer(this);
+  connect(monitorTimer, SIGNAL(timeout()), this, SLOT(slotRefreshMonitor()));
+  ui.tabMonitor->installEventFilter(this);
+}
+
+void kcmsystemd::setupBoot()
+{
+  // Sets up the boot tab. The boot is analyzed the first time the tab
+  // is shown and when the refresh button is clicked.
+  bootModel = new BootModel(this);
+  bootProxyModel = new QSortFilterProxyModel(this);
+  bootProxyModel->setSourceModel(bootModel);
+  bootProxyModel->setSortRole(Qt::UserRole);
+  ui.tblBlame->horizontalHeader()->setDefaultAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+  ui.tblBlame->setModel(bootProxyModel);
+  ui.tblBlame->sortByColumn(1, Qt::DescendingOrder);
+
+  connect(ui.btnRefreshBoot, SIGNAL(clicked()), this, SLOT(slotRefreshBoot()));
+  connect(bootModel, SIGNAL(finished()), this, SLOT(slotBootAnalyzed()));
+  ui.tabBoot->installEventFilter(this);
+}
+
+void kcmsystemd::setupShutdown()
+{
+  // Sets up the shutdown tab, which ranks units by their stop times.
+  // Like the boot tab it is loaded when first shown.
+  stopLatencyModel = new StopLatencyModel(this);
+  stopProxyModel = new QSortFilterProxyModel(this);
+  stopProxyModel->setSourceModel(stopLatencyModel);
+  stopProxyModel->setSortRole(Qt::UserRole);
+  ui.tblStopTimes->horizontalHeader()->setDefaultAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+  ui.tblStopTimes->setModel(stopProxyModel);
+  ui.tblStopTimes->sortByColumn(3, Qt::DescendingOrder);
+
+  connect(ui.btnRefreshStop, SIGNAL(clicked()), this, SLOT(slotRefreshStopTimes()));
+  connect(stopLatencyModel, SIGNAL(finished()), this, SLOT(slotStopTimesLoaded()));
+  ui.tabShutdown->installEventFilter(this);
 }
 
 void kcmsystemd::setupTimerlist()
 {
   // Sets up the timer list initially
 
-  // Setup model for timer list
-  timerModel = new QStandardItemModel(this);
+  // Setup model for timer list, sorted by the raw timestamps
+  timerModel = new TimerModel(this, enableUserUnits ? userBusPath : QString());
+  timerProxyModel = new QSortFilterProxyModel(this);
+  timerProxyModel->setSourceModel(timerModel);
+  timerProxyModel->setSortRole(timerSortRole);
 
   // Install eventfilter to capture mouse move events
   // ui.tblTimers->viewport()->installEventFilter(this);
 
-  // Set header row
-  timerModel->setHorizontalHeaderItem(0, new QStandardItem(i18n("Timer")));
-  timerModel->setHorizontalHeaderItem(1, new QStandardItem(i18n("Next")));
-  timerModel->setHorizontalHeaderItem(2, new QStandardItem(i18n("Left")));
-  timerModel->setHorizontalHeaderItem(3, new QStandardItem(i18n("Last")));
-  timerModel->setHorizontalHeaderItem(4, new QStandardItem(i18n("Passed")));
-  timerModel->setHorizontalHeaderItem(5, new QStandardItem(i18n("Activates")));
   ui.tblTimers->horizontalHeader()->setDefaultAlignment(Qt::AlignLeft | Qt::AlignVCenter);
 
-  // Set model for QTableView (should be called after headers are set)
-  ui.tblTimers->setModel(timerModel);
+  // Set model for QTableView
+  ui.tblTimers->setModel(timerProxyModel);
   ui.tblTimers->sortByColumn(1, Qt::AscendingOrder);
 
-  // Setup a timer that updates the left and passed columns every 5secs
+  // Setup a timer that updates the left and passed columns every second.
+  // It only runs while the timers tab is shown, see eventFilter().
   timer = new QTimer(this);
   connect(timer, SIGNAL(timeout()), this, SLOT(slotUpdateTimers()));
-  timer->start(1000);
+  ui.tabTimers->installEventFilter(this);
 
-  slotRefreshTimerList();
+  if (cacheLoaded)
+  {
+    // Show the timers from the last run until the units have been loaded
+    timerModel->setTimers(unitCache.timers);
+    ui.tblTimers->resizeColumnsToContents();
+  }
+  else
+    slotRefreshTimerList();
 }
 
 void kcmsystemd::defaults()
@@ -494,6 +695,18 @@ void kcmsystemd::save()
                      i18n("Configuration files successfully written to: %1", helperArgs["etcDir"].toString()));
 }
 
+void kcmsystemd::changeEvent(QEvent *event)
+{
+  // The unit and session models cache their brushes, so update them when the color scheme changes
+  if (event->type() == QEvent::PaletteChange && systemUnitModel && userUnitModel && sessionModel)
+  {
+    systemUnitModel->paletteChanged();
+    userUnitModel->paletteChanged();
+    sessionModel->paletteChanged();
+  }
+  KCModule::changeEvent(event);
+}
+
 void kcmsystemd::slotConfChanged(const QModelIndex &, const QModelIndex &)
 {
   // qDebug() << "dataChanged emitted";
@@ -581,15 +794,12 @@ void kcmsystemd::slotRefreshUnitsList(bool initial, dbusBus bus)
     // get an updated list of system units via dbus
     unitslist.clear();
     unitslist = getUnitsFromDbus(sys);
-    noActSystemUnits = 0;
-    foreach (const SystemdUnit &unit, unitslist)
-    {
-      if (unit.active_state == "active")
-        noActSystemUnits++;
-    }
+    systemUnitIndex.update(unitslist);
+    systemUnitFacets.update(unitslist);
     if (!initial)
     {
-      systemUnitModel->dataChanged(systemUnitModel->index(0, 0), systemUnitModel->index(systemUnitModel->rowCount(), 3));
+      systemUnitModel->listChanged();
+      systemUnitFilterModel->refreshSearch();
       systemUnitFilterModel->invalidate();
       updateUnitCount();
       slotRefreshTimerList();
@@ -603,15 +813,12 @@ void kcmsystemd::slotRefreshUnitsList(bool initial, dbusBus bus)
     // get an updated list of user units via dbus
     userUnitslist.clear();
     userUnitslist = getUnitsFromDbus(user);
-    noActUserUnits = 0;
-    foreach (const SystemdUnit &unit, userUnitslist)
-    {
-      if (unit.active_state == "active")
-        noActUserUnits++;
-    }
+    userUnitIndex.update(userUnitslist);
+    userUnitFacets.update(userUnitslist);
     if (!initial)
     {
-      userUnitModel->dataChanged(userUnitModel->index(0, 0), userUnitModel->index(userUnitModel->rowCount(), 3));
+      userUnitModel->listChanged();
+      userUnitFilterModel->refreshSearch();
       userUnitFilterModel->invalidate();
       updateUnitCount();
       slotRefreshTimerList();
@@ -621,229 +828,40 @@ void kcmsystemd::slotRefreshUnitsList(bool initial, dbusBus bus)
 
 void kcmsystemd::slotRefreshSessionList()
 {
-  // Updates the session list
-  qDebug() << "Refreshing session list...";
-
-  // clear list
-  sessionlist.clear();
-
-  // get an updated list of sessions via dbus
-  QDBusMessage dbusreply = callDbusMethod("ListSessions", logdMgr);
-
-  // extract the list of sessions from the reply
-  const QDBusArgument arg = dbusreply.arguments().at(0).value<QDBusArgument>();
-  if (arg.currentType() == QDBusArgument::ArrayType)
-  {
-    arg.beginArray();
-    while (!arg.atEnd())
-    {
-      SystemdSession session;
-      arg >> session;
-      sessionlist.append(session);
-    }
-    arg.endArray();
-  }
-
-  // Iterate through the new list and compare to model
-  for (int i = 0;  i < sessionlist.size(); ++i)
-  {
-    // This is needed to get the "State" property
-
-    QList<QStandardItem *> items = sessionModel->findItems(sessionlist.at(i).session_id, Qt::MatchExactly, 0);
-
-    if (items.isEmpty())
-    {
-      // New session discovered so add it to the model
-      QList<QStandardItem *> row;
-      row <<
-      new QStandardItem(sessionlist.at(i).session_id) <<
-      new QStandardItem(sessionlist.at(i).session_path.path()) <<
-      new QStandardItem(getDbusProperty("State", logdSession, sessionlist.at(i).session_path).toString()) <<
-      new QStandardItem(QString::number(sessionlist.at(i).user_id)) <<
-      new QStandardItem(sessionlist.at(i).user_name) <<
-      new QStandardItem(sessionlist.at(i).seat_id);
-      sessionModel->appendRow(row);
-    } else {
-      sessionModel->item(items.at(0)->row(), 2)->setData(getDbusProperty("State", logdSession, sessionlist.at(i).session_path).toString(), Qt::DisplayRole);
-    }
-  }
-
-  // Check to see if any sessions were removed
-  if (sessionModel->rowCount() != sessionlist.size())
-  {
-    QList<QPersistentModelIndex> indexes;
-    // Loop through model and compare to retrieved sessionlist
-    for (int row = 0; row < sessionModel->rowCount(); ++row)
-    {
-      SystemdSession session;
-      session.session_id = sessionModel->index(row,0).data().toString();
-      if (!sessionlist.contains(session))
-      {
-        // Add removed units to list for deletion
-        // qDebug() << "Unit removed: " << systemUnitModel->index(row,3).data().toString();
-        indexes << sessionModel->index(row,0);
-      }
-    }
-    // Delete the identified units from model
-    foreach (const QPersistentModelIndex &i, indexes)
-      sessionModel->removeRow(i.row());
-  }
-
-  // Update the text color in model
-  QColor newcolor;
-  for (int row = 0; row < sessionModel->rowCount(); ++row)
-  {
-    QBrush newcolor;
-    const KColorScheme scheme(QPalette::Normal);
-    if (sessionModel->data(sessionModel->index(row,2), Qt::DisplayRole) == "active")
-      newcolor = scheme.foreground(KColorScheme::PositiveText);
-    else if (sessionModel->data(sessionModel->index(row,2), Qt::DisplayRole) == "closing")
-      newcolor = scheme.foreground(KColorScheme::InactiveText);
-    else
-      newcolor = scheme.foreground(KColorScheme::NormalText);
-
-    for (int col = 0; col < sessionModel->columnCount(); ++col)
-      sessionModel->setData(sessionModel->index(row,col), QVariant(newcolor), Qt::ForegroundRole);
-  }
+  // Resyncs the sessions, users and seats with logind. The models
+  // follow the cache.
+  logindCache->refresh();
 }
 
 void kcmsystemd::slotRefreshTimerList()
 {
-  // Updates the timer list
-  // qDebug() << "Refreshing timer list...";
-
-  timerModel->removeRows(0, timerModel->rowCount());
-
-  // Iterate through system unitlist and add timers to the model
-  foreach (const SystemdUnit &unit, unitslist)
-  {
-    if (unit.id.endsWith(QLatin1String(".timer")) &&
-        unit.load_state != QLatin1String("unloaded")) {
-      timerModel->appendRow(buildTimerListRow(unit, unitslist, sys));
-    }
-  }
-
-  // Iterate through user unitlist and add timers to the model
-  foreach (const SystemdUnit &unit, userUnitslist)
-  {
-    if (unit.id.endsWith(QLatin1String(".timer")) &&
-        unit.load_state != QLatin1String("unloaded")) {
-      timerModel->appendRow(buildTimerListRow(unit, userUnitslist, user));
-    }
-  }
-
-  // Update the left and passed columns
-  slotUpdateTimers();
-
-  ui.tblTimers->resizeColumnsToContents();
-  ui.tblTimers->sortByColumn(ui.tblTimers->horizontalHeader()->sortIndicatorSection(),
-                             ui.tblTimers->horizontalHeader()->sortIndicatorOrder());
-}
-
-QList<QStandardItem *> kcmsystemd::buildTimerListRow(const SystemdUnit &unit, const QList<SystemdUnit> &list, dbusBus bus)
-{
-  // Builds a row for the timers list
-
-  QDBusObjectPath path = unit.unit_path;
-  QString unitToActivate = getDbusProperty("Unit", sysdTimer, path, bus).toString();
-
-  QDateTime time;
-  QIcon icon;
-  if (bus == sys)
-    icon = QIcon::fromTheme("applications-system");
-  else
-    icon = QIcon::fromTheme("user-identity");
-
-  // Add the next elapsation point
-  qlonglong nextElapseMonotonicMsec = getDbusProperty("NextElapseUSecMonotonic", sysdTimer, path, bus).toULongLong() / 1000;
-  qlonglong nextElapseRealtimeMsec = getDbusProperty("NextElapseUSecRealtime", sysdTimer, path, bus).toULongLong() / 1000;
-  qlonglong lastTriggerMSec = getDbusProperty("LastTriggerUSec", sysdTimer, path, bus).toULongLong() / 1000;
-
-  if (nextElapseMonotonicMsec == 0)
-  {
-    // Timer is calendar-based
-    time.setMSecsSinceEpoch(nextElapseRealtimeMsec);
-  }
-  else
-  {
-    // Timer is monotonic
-    time = QDateTime().currentDateTime();
-    time = time.addMSecs(nextElapseMonotonicMsec);
-
-    // Get the monotonic system clock
-    struct timespec ts;
-    if (clock_gettime( CLOCK_MONOTONIC, &ts ) != 0)
-      qDebug() << "Failed to get the monotonic system clock!";
-
-    // Convert the monotonic system clock to microseconds
-    qlonglong now_mono_usec = ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
-
-    // And subtract it.
-    time = time.addMSecs(-now_mono_usec/1000);
-  }
-
-  QString next = time.toString("yyyy.MM.dd hh:mm:ss");
-
-  QString last;
-
-  // use unit object to get last time for activated service
-  int index = list.indexOf(SystemdUnit(unitToActivate));
-  if (index != -1)
-  {
-    qlonglong inactivateExitTimestampMsec =
-        getDbusProperty("InactiveExitTimestamp", sysdUnit, list.at(index).unit_path, bus).toULongLong() / 1000;
-
-    if (inactivateExitTimestampMsec == 0)
-    {
-      // The unit has not run in this boot
-      // Use LastTrigger to see if the timer is persistent
-      if (lastTriggerMSec == 0)
-        last = "n/a";
-      else
-      {
-        time.setMSecsSinceEpoch(lastTriggerMSec);
-        last = time.toString("yyyy.MM.dd hh:mm:ss");
-      }
-    }
-    else
-    {
-      QDateTime time;
-      time.setMSecsSinceEpoch(inactivateExitTimestampMsec);
-      last = time.toString("yyyy.MM.dd hh:mm:ss");
-    }
-  }
-
-  // Set icon for id column
-  QStandardItem *id = new QStandardItem(unit.id);
-  id->setData(icon, Qt::DecorationRole);
+  // Adds and removes timers to match the unit lists, the properties
+  // of each timer are loaded by the model itself
+  int rows = timerModel->rowCount();
 
-  // Build a row from QStandardItems
-  QList<QStandardItem *> row;
-  row << id <<
-         new QStandardItem(next) <<
-         new QStandardItem("") <<
-         new QStandardItem(last) <<
-         new QStandardItem("") <<
-         new QStandardItem(unitToActivate);
+  timerModel->syncTimers(unitslist, sys);
+  timerModel->syncTimers(enableUserUnits ? userUnitslist : QList<SystemdUnit>(), user);
 
-  return row;
+  if (timerModel->rowCount() != rows)
+    ui.tblTimers->resizeColumnsToContents();
 }
 
 void kcmsystemd::updateUnitCount()
 {
+  // Totals are read from the facet counters, which are kept up to date on refresh
   QString systemUnits = i18ncp("First part of 'Total: %1, %2, %3'",
-                               "1 unit", "%1 units", QString::number(systemUnitModel->rowCount()));
+                               "1 unit", "%1 units", QString::number(systemUnitFacets.total()));
   QString systemActive = i18ncp("Second part of 'Total: %1, %2, %3'",
-                                "1 active", "%1 active", QString::number(noActSystemUnits));
+                                "1 active", "%1 active", QString::number(systemUnitFacets.count(facetActiveState, QStringLiteral("active"))));
   QString systemDisplayed = i18ncp("Third part of 'Total: %1, %2, %3'",
                                    "1 displayed", "%1 displayed", QString::number(systemUnitFilterModel->rowCount()));
   ui.lblUnitCount->setText(i18nc("%1 is '%1 units' and %2 is '%2 active' and %3 is '%3 displayed'",
                                  "Total: %1, %2, %3", systemUnits, systemActive, systemDisplayed));
 
   QString userUnits = i18ncp("First part of 'Total: %1, %2, %3'",
-                             "1 unit", "%1 units", QString::number(userUnitModel->rowCount()));
+                             "1 unit", "%1 units", QString::number(userUnitFacets.total()));
   QString userActive = i18ncp("Second part of 'Total: %1, %2, %3'",
-                              "1 active", "%1 active", QString::number(noActUserUnits));
+                              "1 active", "%1 active", QString::number(userUnitFacets.count(facetActiveState, QStringLiteral("active"))));
   QString userDisplayed = i18ncp("Third part of 'Total: %1, %2, %3'",
                                  "1 displayed", "%1 displayed", QString::number(userUnitFilterModel->rowCount()));
   ui.lblUserUnitCount->setText(i18nc("%1 is '%1 units' and %2 is '%2 active' and %3 is '%3 displayed'",
@@ -915,6 +933,7 @@ void kcmsystemd::slotUnitContextMenu(const QPoint &pos)
   QAction *reload = menu.addAction(i18n("Re&load unit"));
   menu.addSeparator();
   QAction *edit = menu.addAction(i18n("&Edit unit file"));
+  QAction *limits = menu.addAction(i18n("Edit resource &limits..."));
   QAction *isolate = menu.addAction(i18n("&Isolate unit"));
   menu.addSeparator();
   QAction *enable = menu.addAction(i18n("En&able unit"));
@@ -925,6 +944,10 @@ void kcmsystemd::slotUnitContextMenu(const QPoint &pos)
   menu.addSeparator();
   QAction *reloaddaemon = menu.addAction(i18n("Rel&oad all unit files"));
   QAction *reexecdaemon = menu.addAction(i18n("Ree&xecute systemd"));
+  QAction *runTransient = menu.addAction(i18n("Run &transient unit..."));
+  menu.addSeparator();
+  QAction *addTrigger = menu.addAction(i18n("Add &pressure trigger..."));
+  QAction *removeTriggers = menu.addAction(i18n("Remove pressure triggers"));
   
   // Get UnitFileState (have to use Manager object for this)
   QList<QVariant> args;
@@ -1004,6 +1027,12 @@ void kcmsystemd::slotUnitContextMenu(const QPoint &pos)
   if (frpath.isEmpty())
     edit->setEnabled(false);
 
+  limits->setEnabled(!pathUnit.path().isEmpty() && UnitResourceMonitor::hasResources(unit));
+
+  // Pressure is only tracked for units with a control group
+  addTrigger->setEnabled(ActiveState == "active" && UnitResourceMonitor::hasResources(unit));
+  removeTriggers->setEnabled(!pressureWatcher->triggers(unit, bus == user).isEmpty());
+
   QAction *a = menu.exec(tblView->viewport()->mapToGlobal(pos));
    
   if (a == edit)
@@ -1011,6 +1040,27 @@ void kcmsystemd::slotUnitContextMenu(const QPoint &pos)
     editUnitFile(frpath);
     return;
   }
+  else if (a == runTransient)
+  {
+    runTransientUnit();
+    return;
+  }
+  else if (a == limits)
+  {
+    editResourceLimits(unit, pathUnit, bus);
+    return;
+  }
+  else if (a == addTrigger)
+  {
+    addPressureTrigger(unit, pathUnit, bus);
+    return;
+  }
+  else if (a == removeTriggers)
+  {
+    foreach (const PressureTrigger &trigger, pressureWatcher->triggers(unit, bus == user))
+      pressureWatcher->removeTrigger(trigger.id);
+    return;
+  }
 
   // Setup method and arguments for DBus call
   QStringList unitsForCall = QStringList() << unit;
@@ -1067,6 +1117,10 @@ void kcmsystemd::slotUnitContextMenu(const QPoint &pos)
   else if (a == reexecdaemon)
     method = "Reexecute";
 
+  // Register starts and restarts before the job can be created
+  if ((a == start || a == restart) && !method.isEmpty())
+    jobLatencyTracker->actionStarted(unit, method, bus == user);
+
   // Execute the DBus actions
   if (!method.isEmpty() && requiresAuth)
     authServiceAction(connSystemd, pathSysdMgr, ifaceMgr, method, argsForCall);
@@ -1079,6 +1133,43 @@ void kcmsystemd::slotUnitContextMenu(const QPoint &pos)
   }
 }
 
+void kcmsystemd::slotJobLatencyRecorded(const QString &unit, bool userUnit)
+{
+  JobLatencyRecord record;
+  if (!jobLatencyTracker->latest(unit, userUnit, &record))
+    return;
+
+  if (!record.active)
+    displayMsgWidget(record.result == "done" ? KMessageWidget::Information : KMessageWidget::Error,
+                     i18n("The %1 job of %2 finished with result \"%3\" after %4.",
+                          record.action, unit, record.result, BootModel::formatDuration(record.total)));
+  else if (jobLatencyTracker->isRegression(unit, userUnit))
+    displayMsgWidget(KMessageWidget::Warning,
+                     i18n("%1 became active after %2, much slower than its earlier starts.",
+                          unit, BootModel::formatDuration(record.total)));
+  else
+    displayMsgWidget(KMessageWidget::Positive,
+                     i18n("%1 became active after %2.", unit, BootModel::formatDuration(record.total)));
+}
+
+void kcmsystemd::slotTimerContextMenu(const QPoint &pos)
+{
+  // Slot for creating the right-click menu in the timer list
+
+  QMenu menu(this);
+  QAction *analyze = menu.addAction(i18n("Analyze timer &coalescing..."));
+  analyze->setEnabled(timerModel->rowCount() > 0);
+
+  QAction *a = menu.exec(ui.tblTimers->viewport()->mapToGlobal(pos));
+
+  if (a == analyze)
+  {
+    TimerAnalyzerDialog *dlg = new TimerAnalyzerDialog(this, timerModel->timers());
+    dlg->setAttribute(Qt::WA_DeleteOnClose);
+    dlg->show();
+  }
+}
+
 void kcmsystemd::slotSessionContextMenu(const QPoint &pos)
 {
   // Slot for creating the right-click menu in the session list
@@ -1127,76 +1218,62 @@ bool kcmsystemd::eventFilter(QObject *obj, QEvent* event)
   // Eventfilter for catching mouse move events over session list
   // Used for dynamically generating tooltips
 
+  if (obj == ui.tabTimers)
+  {
+    // The countdowns in the timers tab only tick while it is visible.
+    // Hiding the module also hides the tab.
+    if (event->type() == QEvent::Show)
+    {
+      slotUpdateTimers();
+      timer->start(1000);
+    }
+    else if (event->type() == QEvent::Hide)
+      timer->stop();
+    return false;
+  }
+
+  if (obj == ui.tabMonitor)
+  {
+    if (event->type() == QEvent::Show)
+    {
+      slotRefreshMonitor();
+      monitorTimer->start(1000);
+    }
+    else if (event->type() == QEvent::Hide)
+      monitorTimer->stop();
+    return false;
+  }
+
+  if (obj == ui.tabShutdown)
+  {
+    if (event->type() == QEvent::Show && stopLatencyModel->rowCount() == 0 && !stopLatencyModel->isLoading())
+      slotRefreshStopTimes();
+    return false;
+  }
+
+  if (obj == ui.tabBoot)
+  {
+    if (event->type() == QEvent::Show && bootModel->rowCount() == 0 && !bootModel->isLoading())
+      slotRefreshBoot();
+    return false;
+  }
+
   if (event->type() == QEvent::MouseMove && obj->parent()->objectName() == "tblSessions")
   {
-    // Session list
+    // Session list. The tooltip is built by the model from the cached
+    // session properties. Only load them when moving the cursor to a new
+    // row; the tooltip is shown once they arrive.
     QMouseEvent *me = static_cast<QMouseEvent*>(event);
     QModelIndex inSessionModel = ui.tblSessions->indexAt(me->pos());
     if (!inSessionModel.isValid())
       return false;
 
-    if (sessionModel->itemFromIndex(inSessionModel)->row() != lastSessionRowChecked)
+    if (inSessionModel.row() != lastSessionRowChecked)
     {
-      // Cursor moved to a different row. Only build tooltips when moving
-      // cursor to a new row to avoid excessive DBus calls.
-
-      QString selSession = ui.tblSessions->model()->index(ui.tblSessions->indexAt(me->pos()).row(),0).data().toString();
-      QDBusObjectPath spath = QDBusObjectPath(ui.tblSessions->model()->index(ui.tblSessions->indexAt(me->pos()).row(),1).data().toString());
-
-      QString toolTipText;
-      toolTipText.append("<FONT COLOR=white>");
-      toolTipText.append("<b>" + selSession + "</b><hr>");
-
-      // Use the DBus interface to get session properties
-      if (getDbusProperty("test", logdSession, spath) != "invalidIface")
-      {
-        // Session has a valid session DBus object
-        toolTipText.append(i18n("<b>VT:</b> %1", getDbusProperty("VTNr", logdSession, spath).toString()));
-
-        QString remoteHost = getDbusProperty("RemoteHost", logdSession, spath).toString();
-        if (getDbusProperty("Remote", logdSession, spath).toBool())
-        {
-          toolTipText.append(i18n("<br><b>Remote host:</b> %1", remoteHost));
-          toolTipText.append(i18n("<br><b>Remote user:</b> %1", getDbusProperty("RemoteUser", logdSession, spath).toString()));
-        }
-        toolTipText.append(i18n("<br><b>Service:</b> %1", getDbusProperty("Service", logdSession, spath).toString()));
-
-        QString type = getDbusProperty("Type", logdSession, spath).toString();
-        toolTipText.append(i18n("<br><b>Type:</b> %1", type));
-        if (type == "x11")
-          toolTipText.append(i18n(" (display %1)", getDbusProperty("Display", logdSession, spath).toString()));
-        else if (type == "tty")
-        {
-          QString path, tty = getDbusProperty("TTY", logdSession, spath).toString();
-          if (!tty.isEmpty())
-            path = tty;
-          else if (!remoteHost.isEmpty())
-            path = getDbusProperty("Name", logdSession, spath).toString() + '@' + remoteHost;
-          toolTipText.append(" (" + path + ')');
-        }
-        toolTipText.append(i18n("<br><b>Class:</b> %1", getDbusProperty("Class", logdSession, spath).toString()));
-        toolTipText.append(i18n("<br><b>State:</b> %1", getDbusProperty("State", logdSession, spath).toString()));
-        toolTipText.append(i18n("<br><b>Scope:</b> %1", getDbusProperty("Scope", logdSession, spath).toString()));
-
-
-        toolTipText.append(i18n("<br><b>Created: </b>"));
-        if (getDbusProperty("Timestamp", logdSession, spath).toULongLong() == 0)
-          toolTipText.append("n/a");
-        else
-        {
-          QDateTime time;
-          time.setMSecsSinceEpoch(getDbusProperty("Timestamp", logdSession, spath).toULongLong()/1000);
-          toolTipText.append(time.toString());
-        }
-      }
-
-      toolTipText.append("</FONT");
-      sessionModel->itemFromIndex(inSessionModel)->setToolTip(toolTipText);
-
-      lastSessionRowChecked = sessionModel->itemFromIndex(inSessionModel)->row();
-      return true;
-
-    } // Row was different
+      lastSessionRowChecked = inSessionModel.row();
+      if (!sessionModel->hasProperties(inSessionModel.row()))
+        sessionModel->fetchProperties(inSessionModel.row());
+    }
   }
   return false;
   // return true;
@@ -1242,10 +1319,31 @@ void kcmsystemd::slotUserUnitsChanged()
   slotRefreshUnitsList(false, user);
 }
 
-void kcmsystemd::slotLogindPropertiesChanged(QString, QVariantMap, QStringList)
+void kcmsystemd::slotSessionPropertiesLoaded(const QString &id)
 {
-  // qDebug() << "Logind properties changed on iface " << iface_name;
-  slotRefreshSessionList();
+  // Show the tooltip if the cursor is still over the session
+  QWidget *viewport = ui.tblSessions->viewport();
+  if (!viewport->underMouse())
+    return;
+
+  QModelIndex index = ui.tblSessions->indexAt(viewport->mapFromGlobal(QCursor::pos()));
+  if (index.isValid() && index.row() == lastSessionRowChecked &&
+      sessionModel->index(index.row(), 0).data().toString() == id)
+    QToolTip::showText(QCursor::pos(), index.data(Qt::ToolTipRole).toString(), viewport);
+}
+
+void kcmsystemd::slotUserSelected(const QModelIndex &current, const QModelIndex &)
+{
+  // Show the sessions of the selected user
+  QString uid = current.sibling(current.row(), 0).data().toString();
+  userSessionsProxyModel->setFilterRegExp(QRegExp('^' + QRegExp::escape(uid) + '$'));
+}
+
+void kcmsystemd::slotSeatSelected(const QModelIndex &current, const QModelIndex &)
+{
+  // Show the sessions of the selected seat
+  QString seat = current.sibling(current.row(), 0).data().toString();
+  seatSessionsProxyModel->setFilterRegExp(QRegExp('^' + QRegExp::escape(seat) + '$'));
 }
 
 void kcmsystemd::slotLeSearchUnitChanged(QString term)
@@ -1267,6 +1365,109 @@ void kcmsystemd::slotLeSearchUnitChanged(QString term)
   updateUnitCount();
 }
 
+void kcmsystemd::slotChkFuzzySearch(int state)
+{
+  // Fuzzy results are ranked by score, which is shown when sorting on the
+  // unit column. The previous sorting is restored when leaving fuzzy mode.
+  if (QObject::sender()->objectName() == "chkFuzzySearch")
+  {
+    systemUnitFilterModel->setFuzzySearch(state == Qt::Checked);
+    systemUnitFilterModel->invalidate();
+    if (state == Qt::Checked)
+    {
+      unitSortColumn = ui.tblUnits->horizontalHeader()->sortIndicatorSection();
+      unitSortOrder = ui.tblUnits->horizontalHeader()->sortIndicatorOrder();
+      ui.tblUnits->sortByColumn(3, Qt::AscendingOrder);
+    }
+    else
+      ui.tblUnits->sortByColumn(unitSortColumn, unitSortOrder);
+  }
+  else if (QObject::sender()->objectName() == "chkFuzzyUserSearch")
+  {
+    userUnitFilterModel->setFuzzySearch(state == Qt::Checked);
+    userUnitFilterModel->invalidate();
+    if (state == Qt::Checked)
+    {
+      userUnitSortColumn = ui.tblUserUnits->horizontalHeader()->sortIndicatorSection();
+      userUnitSortOrder = ui.tblUserUnits->horizontalHeader()->sortIndicatorOrder();
+      ui.tblUserUnits->sortByColumn(3, Qt::AscendingOrder);
+    }
+    else
+      ui.tblUserUnits->sortByColumn(userUnitSortColumn, userUnitSortOrder);
+  }
+  updateUnitCount();
+}
+
+void kcmsystemd::slotFacetMenuAboutToShow()
+{
+  // Rebuild the facet menu, so it shows the current count of every value
+  QMenu *menu = qobject_cast<QMenu *>(QObject::sender());
+  bool userTab = (menu == ui.btnUserFacets->menu());
+  const UnitFacets &facets = userTab ? userUnitFacets : systemUnitFacets;
+  SortFilterUnitModel *filterModel = userTab ? userUnitFilterModel : systemUnitFilterModel;
+
+  menu->clear();
+  const QStringList titles = QStringList() << i18n("Load state") << i18n("Active state") << i18n("Sub state")
+                                           << i18n("Type") << i18n("Unit file state");
+  for (int f = 0; f < facetCount; ++f)
+  {
+    facetType type = static_cast<facetType>(f);
+    QMenu *facetMenu = menu->addMenu(titles.at(f));
+    QSet<QString> selected = filterModel->facetFilter(type);
+    foreach (const QString &value, facets.values(type))
+    {
+      QAction *action = facetMenu->addAction(i18nc("facet value (number of units)", "%1 (%2)",
+                                                   value.isEmpty() ? i18n("none") : value,
+                                                   facets.count(type, value)));
+      action->setCheckable(true);
+      action->setChecked(selected.contains(value));
+      action->setData(QVariantList() << f << value << userTab);
+      connect(action, SIGNAL(toggled(bool)), this, SLOT(slotFacetToggled(bool)));
+    }
+  }
+  menu->addSeparator();
+  QAction *clear = menu->addAction(i18n("Clear filters"));
+  clear->setData(QVariantList() << -1 << QString() << userTab);
+  connect(clear, SIGNAL(triggered(bool)), this, SLOT(slotFacetToggled(bool)));
+}
+
+void kcmsystemd::slotFacetToggled(bool checked)
+{
+  QAction *action = qobject_cast<QAction *>(QObject::sender());
+  QVariantList data = action->data().toList();
+  int f = data.at(0).toInt();
+  QString value = data.at(1).toString();
+  bool userTab = data.at(2).toBool();
+
+  SortFilterUnitModel *filterModel = userTab ? userUnitFilterModel : systemUnitFilterModel;
+  QTableView *tblView = userTab ? ui.tblUserUnits : ui.tblUnits;
+  QToolButton *button = userTab ? ui.btnUserFacets : ui.btnFacets;
+
+  int selected = 0;
+  for (int i = 0; i < facetCount; ++i)
+  {
+    QSet<QString> values = filterModel->facetFilter(static_cast<facetType>(i));
+    if (f == -1)
+      values.clear();
+    else if (i == f && checked)
+      values.insert(value);
+    else if (i == f)
+      values.remove(value);
+    filterModel->setFacetFilter(static_cast<facetType>(i), values);
+    selected += values.size();
+  }
+
+  if (selected > 0)
+    button->setText(i18nc("%1 is the number of selected filter values", "Filters (%1)", selected));
+  else
+    button->setText(i18n("Filters"));
+
+  filterModel->invalidate();
+  tblView->sortByColumn(tblView->horizontalHeader()->sortIndicatorSection(),
+                        tblView->horizontalHeader()->sortIndicatorOrder());
+  updateUnitCount();
+}
+
 void kcmsystemd::slotCmbConfFileChanged(int index)
 {
   ui.lblConfFile->setText(i18n("File to be written: %1/%2", etcDir, listConfFiles.at(index)));
@@ -1277,51 +1478,388 @@ void kcmsystemd::slotCmbConfFileChanged(int index)
 
 void kcmsystemd::slotUpdateTimers()
 {
-  // Updates the left and passed columns in the timers list
-  for (int row = 0; row < timerModel->rowCount(); ++row)
-  {
-    QDateTime next = timerModel->index(row, 1).data().toDateTime();
-    QDateTime last = timerModel->index(row, 3).data().toDateTime();
-    QDateTime current = QDateTime().currentDateTime();
-    qlonglong leftSecs = current.secsTo(next);
-    qlonglong passedSecs = last.secsTo(current);
-
-    QString left;
-    if (leftSecs >= 31536000)
-      left = QString::number(leftSecs / 31536000) + " years";
-    else if (leftSecs >= 604800)
-      left = QString::number(leftSecs / 604800) + " weeks";
-    else if (leftSecs >= 86400)
-      left = QString::number(leftSecs / 86400) + " days";
-    else if (leftSecs >= 3600)
-      left = QString::number(leftSecs / 3600) + " hr";
-    else if (leftSecs >= 60)
-      left = QString::number(leftSecs / 60) + " min";
-    else if (leftSecs < 0)
-      left = "0 s";
-    else
-      left = QString::number(leftSecs) + " s";
-    timerModel->setData(timerModel->index(row, 2), left);
-
-    QString passed;
-    if (timerModel->index(row, 3).data() == "n/a")
-      passed = "n/a";
-    else if (passedSecs >= 31536000)
-      passed = QString::number(passedSecs / 31536000) + " years";
-    else if (passedSecs >= 604800)
-      passed = QString::number(passedSecs / 604800) + " weeks";
-    else if (passedSecs >= 86400)
-      passed = QString::number(passedSecs / 86400) + " days";
-    else if (passedSecs >= 3600)
-      passed = QString::number(passedSecs / 3600) + " hr";
-    else if (passedSecs >= 60)
-      passed = QString::number(passedSecs / 60) + " min";
-    else if (passedSecs < 0)
-      passed = "0 s";
+  // Updates the left and passed columns of the timers that are on screen
+  timerModel->tick(visibleSourceRows(ui.tblTimers));
+}
+
+void kcmsystemd::slotSampleUsage()
+{
+  // Reads the cgroup usage of the sessions and users that are on screen.
+  // The interval grows while nothing changes and is reset when something
+  // does, so idle machines and hidden tabs cost next to nothing.
+  QList<QTableView *> sessionViews;
+  sessionViews << ui.tblSessions << ui.tblUserSessions << ui.tblSeatSessions;
+
+  bool changed = false;
+  CgroupUsage usage;
+  foreach (QTableView *view, sessionViews)
+  {
+    foreach (int row, visibleSourceRows(view))
+    {
+      QString cgroup = sessionModel->cgroup(row);
+      if (cgroup.isEmpty())
+        continue;
+      cgroupReader.read(cgroup, &usage);
+      changed |= !(sessionModel->index(row, 6).data(Qt::UserRole).toULongLong() == usage.cpuUsec &&
+                   sessionModel->index(row, 7).data(Qt::UserRole).toULongLong() == usage.memoryBytes);
+      sessionModel->setUsage(row, usage);
+    }
+  }
+  foreach (int row, visibleSourceRows(ui.tblUsers))
+  {
+    QString cgroup = userModel->cgroup(row);
+    if (cgroup.isEmpty())
+      continue;
+    cgroupReader.read(cgroup, &usage);
+    changed |= !(userModel->index(row, 6).data(Qt::UserRole).toULongLong() == usage.cpuUsec &&
+                 userModel->index(row, 7).data(Qt::UserRole).toULongLong() == usage.memoryBytes);
+    userModel->setUsage(row, usage);
+  }
+  cgroupReader.expire();
+
+  usageInterval = changed ? 1000 : qMin(usageInterval * 2, 16000);
+  usageTimer->start(usageInterval);
+}
+
+void kcmsystemd::slotSampleUnits()
+{
+  // Samples the resource usage of the units that are on screen
+  if (unitResourceColumns.isEmpty())
+    return;
+
+  QTableView *views[2] = { ui.tblUnits, ui.tblUserUnits };
+  QList<SystemdUnit> *lists[2] = { &unitslist, &userUnitslist };
+  UnitResourceMonitor *monitors[2] = { systemUnitMonitor, userUnitMonitor };
+
+  for (int i = 0; i < 2; ++i)
+  {
+    foreach (int row, visibleSourceRows(views[i]))
+    {
+      if (row >= 0 && row < lists[i]->size())
+        monitors[i]->sample(lists[i]->at(row).id, lists[i]->at(row).unit_path);
+    }
+    monitors[i]->expire();
+  }
+}
+
+void kcmsystemd::applyResourceColumns()
+{
+  // Shows the chosen resource columns in both unit tabs, and only runs
+  // the sampler while at least one of them is shown
+  for (int col = colCpu; col < unitColumnCount; ++col)
+  {
+    ui.tblUnits->setColumnHidden(col, !unitResourceColumns.contains(col));
+    ui.tblUserUnits->setColumnHidden(col, !unitResourceColumns.contains(col));
+  }
+
+  if (unitResourceColumns.isEmpty())
+  {
+    unitSampleTimer->stop();
+  }
+  else
+  {
+    unitSampleTimer->start(unitSampleInterval);
+    slotSampleUnits();
+  }
+}
+
+void kcmsystemd::slotUnitHeaderContextMenu(QPoint pos)
+{
+  QHeaderView *header = qobject_cast<QHeaderView *>(sender());
+  if (!header)
+    return;
+
+  QMenu menu(this);
+  for (int col = colCpu; col < unitColumnCount; ++col)
+  {
+    QAction *action = menu.addAction(systemUnitModel->headerData(col, Qt::Horizontal, Qt::DisplayRole).toString());
+    action->setCheckable(true);
+    action->setChecked(unitResourceColumns.contains(col));
+    action->setData(col);
+  }
+
+  QMenu *intervalMenu = menu.addMenu(i18n("Sampling Interval"));
+  QList<int> intervals;
+  intervals << 1000 << 2000 << 5000 << 10000 << 30000;
+  foreach (int interval, intervals)
+  {
+    QAction *action = intervalMenu->addAction(i18np("1 second", "%1 seconds", interval / 1000));
+    action->setCheckable(true);
+    action->setChecked(interval == unitSampleInterval);
+    action->setData(-interval);
+  }
+
+  QAction *action = menu.exec(header->viewport()->mapToGlobal(pos));
+  if (!action)
+    return;
+
+  int value = action->data().toInt();
+  if (value < 0)
+    unitSampleInterval = -value;
+  else if (unitResourceColumns.contains(value))
+    unitResourceColumns.removeAll(value);
+  else
+    unitResourceColumns.append(value);
+  applyResourceColumns();
+
+  KConfigGroup cfg(KSharedConfig::openConfig("kcmsystemdrc"), "Units");
+  cfg.writeEntry("ResourceColumns", unitResourceColumns);
+  cfg.writeEntry("SampleInterval", unitSampleInterval);
+  cfg.sync();
+}
+
+void kcmsystemd::slotRefreshMonitor()
+{
+  cgroupTopModel->refresh();
+}
+
+void kcmsystemd::slotRefreshBoot()
+{
+  ui.btnRefreshBoot->setEnabled(false);
+  ui.lblBootTimes->setText(i18n("Loading unit timestamps..."));
+  bootModel->refresh(unitslist);
+}
+
+void kcmsystemd::slotBootAnalyzed()
+{
+  ui.btnRefreshBoot->setEnabled(true);
+  ui.lblBootTimes->setText(bootModel->phaseSummary());
+  ui.tblBlame->resizeColumnsToContents();
+
+  // Show the critical chain as a tree, each unit below the one that
+  // waited for it. Units that took time to start are highlighted.
+  const KColorScheme scheme(QPalette::Normal);
+  ui.treeCriticalChain->clear();
+  QTreeWidgetItem *parent = NULL;
+  foreach (const BootUnitTimes &t, bootModel->criticalChain())
+  {
+    QTreeWidgetItem *item = parent ? new QTreeWidgetItem(parent) : new QTreeWidgetItem(ui.treeCriticalChain);
+    item->setText(0, t.id);
+    if (t.activated >= bootModel->userspaceStart())
+      item->setText(1, "@" + BootModel::formatDuration(t.activated - bootModel->userspaceStart()));
+    if (t.time)
+    {
+      item->setText(2, "+" + BootModel::formatDuration(t.time));
+      item->setForeground(0, scheme.foreground(KColorScheme::NegativeText));
+      item->setForeground(2, scheme.foreground(KColorScheme::NegativeText));
+    }
+    parent = item;
+  }
+  ui.treeCriticalChain->expandAll();
+  ui.treeCriticalChain->resizeColumnToContents(0);
+}
+
+void kcmsystemd::slotRefreshStopTimes()
+{
+  ui.btnRefreshStop->setEnabled(false);
+  ui.lblStopSummary->setText(i18n("Reading stop times from the units and the journal..."));
+  stopLatencyModel->refresh(unitslist);
+}
+
+void kcmsystemd::slotStopTimesLoaded()
+{
+  ui.btnRefreshStop->setEnabled(true);
+  ui.lblStopSummary->setText(stopLatencyModel->summary());
+  ui.tblStopTimes->resizeColumnsToContents();
+}
+
+void kcmsystemd::addPressureTrigger(const QString &unit, const QDBusObjectPath &path, dbusBus bus)
+{
+  // Asks for the stall threshold and registers it with the kernel on the
+  // pressure file of the unit's control group
+  UnitResourceMonitor *monitor = bus == user ? userUnitMonitor : systemUnitMonitor;
+  QString cgroup = monitor->controlGroup(unit);
+  if (cgroup.isEmpty())
+  {
+    QDBusConnection abus("");
+    if (bus == user)
+      abus = QDBusConnection::connectToBus(userBusPath, connSystemd);
     else
-      passed = QString::number(passedSecs) + " s";
-    timerModel->setData(timerModel->index(row, 4), passed);
+      abus = systembus;
+    QDBusInterface iface(connSystemd, path.path(), UnitResourceMonitor::resourceInterface(unit), abus);
+    cgroup = iface.property("ControlGroup").toString();
+  }
+  if (cgroup.isEmpty())
+  {
+    displayMsgWidget(KMessageWidget::Error, i18n("%1 has no control group.", unit));
+    return;
+  }
+
+  QPointer<QDialog> dlg = new QDialog(this);
+  dlg->setWindowTitle(i18n("Pressure Trigger for %1", unit));
+  QFormLayout *form = new QFormLayout;
+
+  QComboBox *cmbResource = new QComboBox(dlg);
+  cmbResource->addItems(QStringList() << i18n("CPU") << i18n("Memory") << i18n("IO"));
+  form->addRow(i18n("Resource:"), cmbResource);
+
+  QComboBox *cmbKind = new QComboBox(dlg);
+  cmbKind->addItems(QStringList() << i18n("Some tasks stalled") << i18n("All tasks stalled"));
+  form->addRow(i18n("Stall:"), cmbKind);
+
+  // The kernel accepts windows from 0.5 to 10 seconds. Unprivileged
+  // users are limited to multiples of 2 seconds.
+  QSpinBox *spnWindow = new QSpinBox(dlg);
+  spnWindow->setRange(2, 10);
+  spnWindow->setSingleStep(2);
+  spnWindow->setValue(2);
+  spnWindow->setSuffix(i18n(" s"));
+  form->addRow(i18n("Window:"), spnWindow);
+
+  QSpinBox *spnStall = new QSpinBox(dlg);
+  spnStall->setRange(1, 10000);
+  spnStall->setValue(300);
+  spnStall->setSuffix(i18n(" ms"));
+  form->addRow(i18n("Stalled for at least:"), spnStall);
+
+  QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok |
+                                                     QDialogButtonBox::Cancel,
+                                                     dlg);
+  connect(buttonBox, SIGNAL(accepted()), dlg, SLOT(accept()));
+  connect(buttonBox, SIGNAL(rejected()), dlg, SLOT(reject()));
+
+  QVBoxLayout *vlayout = new QVBoxLayout;
+  vlayout->addLayout(form);
+  vlayout->addWidget(buttonBox);
+  dlg->setLayout(vlayout);
+
+  if (dlg->exec() == QDialog::Accepted)
+  {
+    PressureTrigger trigger;
+    trigger.unit = unit;
+    trigger.cgroup = cgroup;
+    trigger.userUnit = bus == user;
+    trigger.resource = static_cast<pressureResource>(cmbResource->currentIndex());
+    trigger.full = cmbKind->currentIndex() == 1;
+    trigger.windowMs = spnWindow->value() * 1000;
+    trigger.stallMs = qMin(spnStall->value(), trigger.windowMs);
+
+    QString error;
+    if (pressureWatcher->addTrigger(trigger, &error) < 0)
+      displayMsgWidget(KMessageWidget::Error,
+                       i18n("Unable to add pressure trigger for %1: %2", unit, error));
+  }
+  delete dlg;
+}
+
+void kcmsystemd::editResourceLimits(const QString &unit, const QDBusObjectPath &path, dbusBus bus)
+{
+  // Applies the changed limits with SetUnitProperties, which takes effect
+  // immediately and needs no daemon reload
+  QDBusConnection abus("");
+  if (bus == user)
+    abus = QDBusConnection::connectToBus(userBusPath, connSystemd);
+  else
+    abus = systembus;
+
+  QPointer<ResourceLimitDialog> dlg = new ResourceLimitDialog(this, unit, path, abus,
+                                                              bus == user ? userUnitMonitor : systemUnitMonitor);
+  int result = dlg->exec();
+  if (dlg && result == QDialog::Accepted)
+  {
+    UnitPropertyList properties = dlg->properties();
+    if (!properties.isEmpty())
+    {
+      QList<QVariant> args;
+      args << unit << dlg->runtime();
+      if (bus == sys)
+      {
+        args << QVariant(unitPropertiesToVariant(properties));
+        authServiceAction(connSystemd, pathSysdMgr, ifaceMgr, "SetUnitProperties", args);
+      }
+      else
+      {
+        args << QVariant::fromValue(properties);
+        QDBusMessage reply = callDbusMethod("SetUnitProperties", sysdMgr, bus, args);
+        if (reply.type() == QDBusMessage::ErrorMessage)
+          displayMsgWidget(KMessageWidget::Error,
+                           i18n("Unable to set the resource limits of %1: %2", unit, reply.errorMessage()));
+      }
+    }
+  }
+  delete dlg;
+}
+
+void kcmsystemd::runTransientUnit()
+{
+  // Starts a command as a transient service with resource limits, and
+  // shows the new unit with its resource usage
+  QPointer<TransientUnitDialog> dlg = new TransientUnitDialog(this, enableUserUnits);
+  int result = dlg->exec();
+  if (!dlg || result != QDialog::Accepted)
+  {
+    delete dlg;
+    return;
+  }
+
+  QString unit = dlg->unitName();
+  dbusBus bus = dlg->userManager() ? user : sys;
+  QList<QVariant> args;
+  args << unit << "fail";
+  if (bus == sys)
+  {
+    args << QVariant(unitPropertiesToVariant(dlg->properties())) << QVariant(QVariantList());
+    authServiceAction(connSystemd, pathSysdMgr, ifaceMgr, "StartTransientUnit", args);
+  }
+  else
+  {
+    args << QVariant::fromValue(dlg->properties()) << QVariant::fromValue(AuxUnitList());
+    QDBusMessage reply = callDbusMethod("StartTransientUnit", sysdMgr, bus, args);
+    if (reply.type() == QDBusMessage::ErrorMessage)
+    {
+      displayMsgWidget(KMessageWidget::Error,
+                       i18n("Unable to start %1: %2", unit, reply.errorMessage()));
+      delete dlg;
+      return;
+    }
+  }
+  delete dlg;
+
+  // The unit list is refreshed when the start job is done. Filter the
+  // table down to the new unit and show its usage.
+  if (unitResourceColumns.isEmpty())
+  {
+    unitResourceColumns << colCpu << colMemory << colTasks;
+    applyResourceColumns();
   }
+  ui.tabWidget->setCurrentIndex(bus == user ? 1 : 0);
+  (bus == user ? ui.leSearchUserUnit : ui.leSearchUnit)->setText(unit);
+}
+
+void kcmsystemd::slotPressureTriggered(const PressureTrigger &trigger)
+{
+  QStringList resources = QStringList() << i18n("CPU") << i18n("Memory") << i18n("IO");
+  displayMsgWidget(KMessageWidget::Warning,
+                   i18n("%1 was stalled on %2 for more than %3 ms in %4 s.",
+                        trigger.unit, resources.at(trigger.resource),
+                        trigger.stallMs, trigger.windowMs / 1000));
+}
+
+void kcmsystemd::slotPressureTriggerExpired(const PressureTrigger &trigger)
+{
+  displayMsgWidget(KMessageWidget::Information,
+                   i18n("The pressure trigger for %1 was removed because the unit stopped.", trigger.unit));
+}
+
+QList<int> kcmsystemd::visibleSourceRows(QTableView *view) const
+{
+  // Returns the rows of the view's source model that are inside its
+  // viewport, or nothing if the view is hidden
+  QList<int> rows;
+  if (!view->isVisible())
+    return rows;
+
+  int first = view->rowAt(0);
+  if (first == -1)
+    return rows;
+  int last = view->rowAt(view->viewport()->height() - 1);
+  if (last == -1)
+    last = view->model()->rowCount() - 1;
+
+  QSortFilterProxyModel *proxy = qobject_cast<QSortFilterProxyModel *>(view->model());
+  for (int row = first; row <= last; ++row)
+    rows << (proxy ? proxy->mapToSource(proxy->index(row, 0)).row() : row);
+  return rows;
 }
 
 void kcmsystemd::editUnitFile(const QString &filename)
@@ -1383,16 +1921,27 @@ QList<SystemdUnit> kcmsystemd::getUnitsFromDbus(dbusBus bus)
 {
   // get an updated list of units via dbus
 
+  QDBusMessage unitsReply = callDbusMethod("ListUnits", sysdMgr, bus);
+  if (unitsReply.type() != QDBusMessage::ReplyMessage)
+    return QList<SystemdUnit>();
+
+  // Get a list of unit files
+  QDBusMessage unitFilesReply = callDbusMethod("ListUnitFiles", sysdMgr, bus);
+
+  return buildUnitList(unitsReply, unitFilesReply);
+}
+
+QList<SystemdUnit> kcmsystemd::buildUnitList(const QDBusMessage &unitsReply, const QDBusMessage &unitFilesReply)
+{
+  // Merges the replies of ListUnits and ListUnitFiles into a list of units
+
   QList<SystemdUnit> list;
   QList<unitfile> unitfileslist;
-  QDBusMessage dbusreply;
-
-  dbusreply = callDbusMethod("ListUnits", sysdMgr, bus);
 
-  if (dbusreply.type() == QDBusMessage::ReplyMessage)
+  if (unitsReply.type() == QDBusMessage::ReplyMessage)
   {
 
-    const QDBusArgument argUnits = dbusreply.arguments().at(0).value<QDBusArgument>();
+    const QDBusArgument argUnits = unitsReply.arguments().at(0).value<QDBusArgument>();
     int tal = 0;
     if (argUnits.currentType() == QDBusArgument::ArrayType)
     {
@@ -1408,12 +1957,13 @@ QList<SystemdUnit> kcmsystemd::getUnitsFromDbus(dbusBus bus)
       }
       argUnits.endArray();
     }
-    // qDebug() << "Added " << tal << " units on bus " << bus;
+    // qDebug() << "Added " << tal << " units";
     tal = 0;
 
-    // Get a list of unit files
-    dbusreply = callDbusMethod("ListUnitFiles", sysdMgr, bus);
-    const QDBusArgument argUnitFiles = dbusreply.arguments().at(0).value<QDBusArgument>();
+    if (unitFilesReply.type() != QDBusMessage::ReplyMessage)
+      return list;
+
+    const QDBusArgument argUnitFiles = unitFilesReply.arguments().at(0).value<QDBusArgument>();
     argUnitFiles.beginArray();
     while (!argUnitFiles.atEnd())
     {
@@ -1425,10 +1975,25 @@ QList<SystemdUnit> kcmsystemd::getUnitsFromDbus(dbusBus bus)
     }
     argUnitFiles.endArray();
 
+    // Find out in one pass per directory which of the unit files
+    // that are not loaded are symlinks
+    QHash<QString, int> loadedUnits;
+    loadedUnits.reserve(list.size());
+    for (int i = 0; i < list.size(); ++i)
+      loadedUnits.insert(list.at(i).id, i);
+
+    QStringList unloadedFiles;
+    foreach (const unitfile &u, unitfileslist)
+    {
+      if (!loadedUnits.contains(u.name.section('/',-1)))
+        unloadedFiles << u.name;
+    }
+    unitLinkCache.refresh(unloadedFiles);
+
     // Add unloaded units to the list
     for (int i = 0;  i < unitfileslist.size(); ++i)
     {
-      int index = list.indexOf(SystemdUnit(unitfileslist.at(i).name.section('/',-1)));
+      int index = loadedUnits.value(unitfileslist.at(i).name.section('/',-1), -1);
       if (index > -1)
       {
         // The unit was already in the list, add unit file and its status
@@ -1438,8 +2003,7 @@ QList<SystemdUnit> kcmsystemd::getUnitsFromDbus(dbusBus bus)
       else
       {
         // Unit not in the list, add it
-        QFile unitfile(unitfileslist.at(i).name);
-        if (unitfile.symLinkTarget().isEmpty())
+        if (!unitLinkCache.isSymLink(unitfileslist.at(i).name))
         {
           SystemdUnit unit;
           unit.id = unitfileslist.at(i).name.section('/',-1);
@@ -1455,13 +2019,91 @@ QList<SystemdUnit> kcmsystemd::getUnitsFromDbus(dbusBus bus)
         }
       }
     }
-    // qDebug() << "Added " << tal << " units from files on bus " << bus;
+    // qDebug() << "Added " << tal << " units from files";
 
   }
 
   return list;
 }
 
+void kcmsystemd::loadUnitsAsync(dbusBus bus)
+{
+  // Fetches the unit list without blocking, the reply is merged into the
+  // (cached) list in slotAsyncUnitFilesReply
+  QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(asyncCallDbusMethod("ListUnits", sysdMgr, bus), this);
+  watcher->setProperty("bus", bus);
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(slotAsyncUnitsReply(QDBusPendingCallWatcher*)));
+}
+
+void kcmsystemd::slotAsyncUnitsReply(QDBusPendingCallWatcher *watcher)
+{
+  dbusBus bus = static_cast<dbusBus>(watcher->property("bus").toInt());
+  asyncUnitsReply[bus] = watcher->reply();
+  watcher->deleteLater();
+
+  QDBusPendingCallWatcher *next = new QDBusPendingCallWatcher(asyncCallDbusMethod("ListUnitFiles", sysdMgr, bus), this);
+  next->setProperty("bus", bus);
+  connect(next, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(slotAsyncUnitFilesReply(QDBusPendingCallWatcher*)));
+}
+
+void kcmsystemd::slotAsyncUnitFilesReply(QDBusPendingCallWatcher *watcher)
+{
+  dbusBus bus = static_cast<dbusBus>(watcher->property("bus").toInt());
+  QList<SystemdUnit> live = buildUnitList(asyncUnitsReply[bus], watcher->reply());
+  bool ok = (asyncUnitsReply[bus].type() == QDBusMessage::ReplyMessage);
+  asyncUnitsReply[bus] = QDBusMessage();
+  watcher->deleteLater();
+
+  if (!ok)
+  {
+    qDebug() << "Failed to load units on bus" << bus;
+    return;
+  }
+
+  if (bus == sys)
+  {
+    qDebug() << "Reconciling cached system units...";
+    systemUnitModel->reconcile(live);
+    systemUnitIndex.update(unitslist);
+    systemUnitFacets.update(unitslist);
+    systemUnitFilterModel->refreshSearch();
+    systemUnitFilterModel->invalidate();
+    ui.tblUnits->sortByColumn(ui.tblUnits->horizontalHeader()->sortIndicatorSection(),
+                              ui.tblUnits->horizontalHeader()->sortIndicatorOrder());
+  }
+  else
+  {
+    qDebug() << "Reconciling cached user units...";
+    userUnitModel->reconcile(live);
+    userUnitIndex.update(userUnitslist);
+    userUnitFacets.update(userUnitslist);
+    userUnitFilterModel->refreshSearch();
+    userUnitFilterModel->invalidate();
+    ui.tblUserUnits->sortByColumn(ui.tblUserUnits->horizontalHeader()->sortIndicatorSection(),
+                                  ui.tblUserUnits->horizontalHeader()->sortIndicatorOrder());
+  }
+  updateUnitCount();
+  slotRefreshTimerList();
+  saveUnitCache();
+}
+
+void kcmsystemd::saveUnitCache()
+{
+  // Stores the current lists for the next start of the module
+  if (!systemUnitModel || !sessionModel || !timerModel)
+    return;
+
+  UnitCacheData data;
+  data.systemUnits = unitslist;
+  data.userUnits = userUnitslist;
+
+  data.sessionRows = sessionModel->cachedRows();
+
+  data.timers = timerModel->timers();
+
+  writeUnitCache(data);
+}
+
 QVariant kcmsystemd::getDbusProperty(QString prop, dbusIface ifaceName, QDBusObjectPath path, dbusBus bus)
 {
   // qDebug() << "Fetching property" << prop << ifaceName << path.path() << "on bus" << bus;
@@ -1538,6 +2180,27 @@ QDBusMessage kcmsystemd::callDbusMethod(QString method, dbusIface ifaceName, dbu
   return msg;
 }
 
+QDBusPendingCall kcmsystemd::asyncCallDbusMethod(QString method, dbusIface ifaceName, dbusBus bus, const QList<QVariant> &args)
+{
+  // Like callDbusMethod, but returns without waiting for the reply. The
+  // message is built directly, as creating a QDBusInterface would block
+  // on introspection.
+  QDBusConnection abus("");
+  if (bus == user)
+    abus = QDBusConnection::connectToBus(userBusPath, connSystemd);
+  else
+    abus = systembus;
+
+  QDBusMessage msg;
+  if (ifaceName == logdMgr)
+    msg = QDBusMessage::createMethodCall(connLogind, pathLogdMgr, ifaceLogdMgr, method);
+  else
+    msg = QDBusMessage::createMethodCall(connSystemd, pathSysdMgr, ifaceMgr, method);
+  msg.setArguments(args);
+
+  return abus.asyncCall(msg);
+}
+
 void kcmsystemd::displayMsgWidget(KMessageWidget::MessageType type, QString msg)
 {
   KMessageWidget *msgWidget = new KMessageWidget;
@@ -30,7 +30,23 @@
 #include "ui_kcmsystemd.h"
 #include "systemdunit.h"
 #include "unitmodel.h"
+#include "unitresourcemonitor.h"
+#include "timermodel.h"
+#include "logindcache.h"
+#include "sessionmodel.h"
+#include "usermodel.h"
+#include "seatmodel.h"
 #include "sortfilterunitmodel.h"
+#include "unitsearchindex.h"
+#include "unitfacets.h"
+#include "unitcache.h"
+#include "fsutil.h"
+#include "cgroupstat.h"
+#include "cgrouptopmodel.h"
+#include "bootmodel.h"
+#include "stoplatencymodel.h"
+#include "pressurewatcher.h"
+#include "unitproperty.h"
 #include "confoption.h"
 #include "confmodel.h"
 #include "confdelegate.h"
@@ -69,12 +85,20 @@ class kcmsystemd : public KCModule
     void load();
     void save();
 
+  protected:
+    void changeEvent(QEvent *event);
+
   private:
     Ui::kcmsystemd ui;
     void setupSignalSlots();
     void setupUnitslist();
     void setupConf();
     void setupSessionlist();
+    void setupUserlist();
+    void setupSeatlist();
+    void setupMonitor();
+    void setupBoot();
+    void setupShutdown();
     void setupTimerlist();
     void readConfFile(int);
     void authServiceAction(QString, QString, QString, QString, QList<QVariant>);
@@ -82,27 +106,63 @@ class kcmsystemd : public KCModule
     void updateUnitCount();
     void displayMsgWidget(KMessageWidget::MessageType type, QString msg);
     QList<SystemdUnit> getUnitsFromDbus(dbusBus bus);
+    QList<SystemdUnit> buildUnitList(const QDBusMessage &unitsReply, const QDBusMessage &unitFilesReply);
+    void loadUnitsAsync(dbusBus bus);
+    void saveUnitCache();
+    void applyResourceColumns();
+    QList<int> visibleSourceRows(QTableView *view) const;
     QVariant getDbusProperty(QString prop, dbusIface ifaceName, QDBusObjectPath path = QDBusObjectPath("/org/freedesktop/systemd1"), dbusBus bus = sys);
     QDBusMessage callDbusMethod(QString method, dbusIface ifaceName, dbusBus bus = sys, const QList<QVariant> &args = QList<QVariant> ());
-    QList<QStandardItem *> buildTimerListRow(const SystemdUnit &unit, const QList<SystemdUnit> &list, dbusBus bus);
+    QDBusPendingCall asyncCallDbusMethod(QString method, dbusIface ifaceName, dbusBus bus = sys, const QList<QVariant> &args = QList<QVariant> ());
     void editUnitFile(const QString &filename);
+    void addPressureTrigger(const QString &unit, const QDBusObjectPath &path, dbusBus bus);
+    void editResourceLimits(const QString &unit, const QDBusObjectPath &path, dbusBus bus);
+    void runTransientUnit();
 
     QList<confOption> confOptList;
     QSortFilterProxyModel *proxyModelConf;
     ConfModel *confModel;
     SortFilterUnitModel *systemUnitFilterModel, *userUnitFilterModel;
-    QStandardItemModel *sessionModel, *timerModel;
-    UnitModel *systemUnitModel, *userUnitModel;
+    LogindCache *logindCache;
+    SessionModel *sessionModel = NULL;
+    UserModel *userModel;
+    SeatModel *seatModel;
+    QSortFilterProxyModel *userProxyModel, *userSessionsProxyModel, *seatProxyModel, *seatSessionsProxyModel;
+    TimerModel *timerModel = NULL;
+    QSortFilterProxyModel *timerProxyModel = NULL;
+    UnitModel *systemUnitModel = NULL, *userUnitModel = NULL;
+    UnitResourceMonitor *systemUnitMonitor, *userUnitMonitor;
+    QTimer *unitSampleTimer;
+    PressureWatcher *pressureWatcher;
+    MemoryEventWatcher *memoryEventWatcher;
+    JobLatencyTracker *jobLatencyTracker;
+    QList<int> unitResourceColumns;
+    int unitSampleInterval = 2000;
+    UnitSearchIndex systemUnitIndex, userUnitIndex;
+    int unitSortColumn = 3, userUnitSortColumn = 3;
+    Qt::SortOrder unitSortOrder = Qt::AscendingOrder, userUnitSortOrder = Qt::AscendingOrder;
+    UnitFacets systemUnitFacets, userUnitFacets;
     QList<SystemdUnit> unitslist, userUnitslist;
-    QList<SystemdSession> sessionlist;
+    UnitCacheData unitCache;
+    SymlinkCache unitLinkCache;
+    bool cacheLoaded = false;
+    QDBusMessage asyncUnitsReply[3];
     QStringList listConfFiles;
     QString etcDir, userBusPath;
     QMenu *contextMenuUnits;
     QAction *actEnableUnit, *actDisableUnit;
-    int systemdVersion, timesLoad = 0, lastUnitRowChecked = -1, lastSessionRowChecked = -1, noActSystemUnits, noActUserUnits;
+    int systemdVersion, timesLoad = 0, lastUnitRowChecked = -1, lastSessionRowChecked = -1;
     qulonglong partPersSizeMB, partVolaSizeMB;
     bool enableUserUnits = true;
-    QTimer *timer;
+    CgroupTopModel *cgroupTopModel;
+    QSortFilterProxyModel *monitorProxyModel;
+    BootModel *bootModel;
+    QSortFilterProxyModel *bootProxyModel;
+    StopLatencyModel *stopLatencyModel;
+    QSortFilterProxyModel *stopProxyModel;
+    QTimer *timer, *sessionResyncTimer, *usageTimer, *monitorTimer;
+    CgroupStatReader cgroupReader;
+    int usageInterval = 1000;
     const QStringList unitTypeSufx = QStringList() << "" << ".target" << ".service" << ".device" << ".mount"
                                                    << ".automount" << ".swap" << ".socket" << ".path"
                                                    << ".timer" << ".snapshot" << ".slice" << ".scope";
@@ -123,6 +183,7 @@ class kcmsystemd : public KCModule
     void slotCmbUnitTypes(int);
     void slotUnitContextMenu(const QPoint &);
     void slotSessionContextMenu(const QPoint &);
+    void slotTimerContextMenu(const QPoint &);
     void slotRefreshUnitsList(bool, dbusBus);
     void slotRefreshSessionList();
     void slotRefreshTimerList();
@@ -130,13 +191,31 @@ class kcmsystemd : public KCModule
     void slotUserSystemdReloading(bool);
     void slotSystemUnitsChanged();
     void slotUserUnitsChanged();
+    void slotJobLatencyRecorded(const QString &unit, bool userUnit);
     // void slotUnitLoaded(QString, QDBusObjectPath);
     // void slotUnitUnloaded(QString, QDBusObjectPath);
-    void slotLogindPropertiesChanged(QString, QVariantMap, QStringList);
+    void slotSessionPropertiesLoaded(const QString &);
+    void slotUserSelected(const QModelIndex &, const QModelIndex &);
+    void slotSeatSelected(const QModelIndex &, const QModelIndex &);
     void slotLeSearchUnitChanged(QString);
+    void slotChkFuzzySearch(int);
+    void slotFacetMenuAboutToShow();
+    void slotFacetToggled(bool);
     void slotConfChanged(const QModelIndex &, const QModelIndex &);
     void slotCmbConfFileChanged(int);
     void slotUpdateTimers();
+    void slotSampleUsage();
+    void slotSampleUnits();
+    void slotRefreshMonitor();
+    void slotRefreshBoot();
+    void slotBootAnalyzed();
+    void slotRefreshStopTimes();
+    void slotStopTimesLoaded();
+    void slotPressureTriggered(const PressureTrigger &trigger);
+    void slotPressureTriggerExpired(const PressureTrigger &trigger);
+    void slotUnitHeaderContextMenu(QPoint);
+    void slotAsyncUnitsReply(QDBusPendingCallWatcher *);
+    void slotAsyncUnitFilesReply(QDBusPendingCallWatcher *);
 };
 
 #endif // kcmsystemd_H
@@ -0,0 +1,341 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "logindcache.h"
+
+static const QString connLogind = QStringLiteral("org.freedesktop.login1");
+static const QString pathLogdMgr = QStringLiteral("/org/freedesktop/login1");
+static const QString ifaceLogdMgr = QStringLiteral("org.freedesktop.login1.Manager");
+static const QString ifaceDbusProp = QStringLiteral("org.freedesktop.DBus.Properties");
+static const QString ifaces[logindTypeCount] = {
+  QStringLiteral("org.freedesktop.login1.Session"),
+  QStringLiteral("org.freedesktop.login1.User"),
+  QStringLiteral("org.freedesktop.login1.Seat")
+};
+static const char *listMethods[logindTypeCount] = { "ListSessions", "ListUsers", "ListSeats" };
+
+// Number of GetAll calls that may be pending at the same time
+static const int maxInFlight = 32;
+
+static QVariant normalize(const QVariant &value)
+{
+  // Replaces (id, path) pairs and arrays of them by the ids
+  if (value.userType() != qMetaTypeId<QDBusArgument>())
+    return value;
+
+  const QDBusArgument arg = value.value<QDBusArgument>();
+  if (arg.currentType() == QDBusArgument::StructureType)
+  {
+    arg.beginStructure();
+    QVariant id = arg.asVariant();
+    arg.endStructure();
+    return id;
+  }
+  if (arg.currentType() == QDBusArgument::ArrayType)
+  {
+    QStringList ids;
+    arg.beginArray();
+    while (!arg.atEnd())
+    {
+      QString id;
+      QDBusObjectPath path;
+      arg.beginStructure();
+      arg >> id >> path;
+      arg.endStructure();
+      ids << id;
+    }
+    arg.endArray();
+    return ids;
+  }
+  return value;
+}
+
+LogindCache::LogindCache(QObject *parent)
+ : QObject(parent)
+{
+  QDBusConnection bus = QDBusConnection::systemBus();
+  bus.connect(connLogind, "", ifaceDbusProp, QStringLiteral("PropertiesChanged"), this,
+              SLOT(slotPropertiesChanged(QString,QVariantMap,QStringList,QDBusMessage)));
+  bus.connect(connLogind, pathLogdMgr, ifaceLogdMgr, QStringLiteral("SessionNew"),
+              this, SLOT(slotSessionNew(QString,QDBusObjectPath)));
+  bus.connect(connLogind, pathLogdMgr, ifaceLogdMgr, QStringLiteral("SessionRemoved"),
+              this, SLOT(slotSessionRemoved(QString,QDBusObjectPath)));
+  bus.connect(connLogind, pathLogdMgr, ifaceLogdMgr, QStringLiteral("UserNew"),
+              this, SLOT(slotUserNew(uint,QDBusObjectPath)));
+  bus.connect(connLogind, pathLogdMgr, ifaceLogdMgr, QStringLiteral("UserRemoved"),
+              this, SLOT(slotUserRemoved(uint,QDBusObjectPath)));
+  bus.connect(connLogind, pathLogdMgr, ifaceLogdMgr, QStringLiteral("SeatNew"),
+              this, SLOT(slotSeatNew(QString,QDBusObjectPath)));
+  bus.connect(connLogind, pathLogdMgr, ifaceLogdMgr, QStringLiteral("SeatRemoved"),
+              this, SLOT(slotSeatRemoved(QString,QDBusObjectPath)));
+}
+
+void LogindCache::refresh()
+{
+  // Resyncs the object lists with logind, see slotListReply()
+  for (int type = 0; type < logindTypeCount; ++type)
+  {
+    QDBusMessage msg = QDBusMessage::createMethodCall(connLogind, pathLogdMgr, ifaceLogdMgr,
+                                                      QLatin1String(listMethods[type]));
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(QDBusConnection::systemBus().asyncCall(msg), this);
+    watcher->setProperty("type", type);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(slotListReply(QDBusPendingCallWatcher*)));
+  }
+}
+
+QStringList LogindCache::objects(logindType type) const
+{
+  QStringList paths;
+  for (QHash<QString, Object>::const_iterator it = objectList.constBegin(); it != objectList.constEnd(); ++it)
+  {
+    if (it->type == type)
+      paths << it.key();
+  }
+  return paths;
+}
+
+bool LogindCache::contains(const QString &path) const
+{
+  return objectList.contains(path);
+}
+
+bool LogindCache::isLoaded(const QString &path) const
+{
+  QHash<QString, Object>::const_iterator it = objectList.constFind(path);
+  return it != objectList.constEnd() && it->loaded;
+}
+
+QVariantMap LogindCache::properties(const QString &path) const
+{
+  return objectList.value(path).properties;
+}
+
+void LogindCache::fetch(const QString &path, bool urgent)
+{
+  if (!objectList.contains(path))
+    return;
+
+  if (urgent)
+  {
+    fetchQueue.removeOne(path);
+    fetchQueue.prepend(path);
+    queued.insert(path);
+  }
+  else if (!queued.contains(path))
+  {
+    fetchQueue.append(path);
+    queued.insert(path);
+  }
+  fetchNext();
+}
+
+void LogindCache::slotListReply(QDBusPendingCallWatcher *watcher)
+{
+  logindType type = static_cast<logindType>(watcher->property("type").toInt());
+  QDBusMessage reply = watcher->reply();
+  watcher->deleteLater();
+  if (reply.type() != QDBusMessage::ReplyMessage)
+  {
+    qDebug() << "Failed to call" << listMethods[type] << reply.errorMessage();
+    return;
+  }
+
+  // The lists carry a few properties of each object, use them until the
+  // GetAll call for the object has returned
+  QSet<QString> live;
+  const QDBusArgument arg = reply.arguments().at(0).value<QDBusArgument>();
+  arg.beginArray();
+  while (!arg.atEnd())
+  {
+    QVariantMap seed;
+    QDBusObjectPath path;
+    arg.beginStructure();
+    if (type == logindSession)
+    {
+      // a(susso)
+      QString id, user, seat;
+      uint uid;
+      arg >> id >> uid >> user >> seat >> path;
+      seed.insert(QStringLiteral("Id"), id);
+      seed.insert(QStringLiteral("User"), uid);
+      seed.insert(QStringLiteral("Name"), user);
+      seed.insert(QStringLiteral("Seat"), seat);
+    }
+    else if (type == logindUser)
+    {
+      // a(uso)
+      uint uid;
+      QString name;
+      arg >> uid >> name >> path;
+      seed.insert(QStringLiteral("UID"), uid);
+      seed.insert(QStringLiteral("Name"), name);
+    }
+    else
+    {
+      // a(so)
+      QString id;
+      arg >> id >> path;
+      seed.insert(QStringLiteral("Id"), id);
+    }
+    arg.endStructure();
+
+    live.insert(path.path());
+    if (!objectList.contains(path.path()))
+      addObject(type, path.path(), seed);
+    else if (!objectList.value(path.path()).loaded)
+      fetch(path.path());
+  }
+  arg.endArray();
+
+  foreach (const QString &path, objects(type))
+  {
+    if (!live.contains(path))
+      removeObject(path);
+  }
+
+  emit listed(type);
+}
+
+void LogindCache::slotPropertiesReply(QDBusPendingCallWatcher *watcher)
+{
+  QDBusPendingReply<QVariantMap> reply = *watcher;
+  watcher->deleteLater();
+  inFlight--;
+
+  // The object may have been removed while the call was pending
+  QString path = watcher->property("path").toString();
+  QHash<QString, Object>::iterator it = objectList.find(path);
+  if (it != objectList.end() && !reply.isError())
+  {
+    QVariantMap props = reply.value();
+    it->properties.clear();
+    for (QVariantMap::const_iterator p = props.constBegin(); p != props.constEnd(); ++p)
+      it->properties.insert(p.key(), normalize(p.value()));
+    it->loaded = true;
+    emit objectChanged(it->type, path);
+  }
+
+  fetchNext();
+}
+
+void LogindCache::slotPropertiesChanged(QString iface, QVariantMap changed, QStringList invalidated, QDBusMessage msg)
+{
+  // The hints change all the time and are applied from the payload.
+  // Properties like State are not signalled at all, so any other change
+  // also reloads the object.
+  QHash<QString, Object>::iterator it = objectList.find(msg.path());
+  if (it == objectList.end() || iface != ifaces[it->type])
+    return;
+
+  bool reload = !invalidated.isEmpty();
+  for (QVariantMap::const_iterator p = changed.constBegin(); p != changed.constEnd(); ++p)
+  {
+    it->properties.insert(p.key(), normalize(p.value()));
+    if (!p.key().contains(QLatin1String("Hint")))
+      reload = true;
+  }
+
+  int type = it->type;
+  if (reload)
+  {
+    it->loaded = false;
+    fetch(msg.path());
+  }
+  emit objectChanged(type, msg.path());
+}
+
+void LogindCache::slotSessionNew(QString id, QDBusObjectPath path)
+{
+  QVariantMap seed;
+  seed.insert(QStringLiteral("Id"), id);
+  addObject(logindSession, path.path(), seed);
+}
+
+void LogindCache::slotSessionRemoved(QString, QDBusObjectPath path)
+{
+  removeObject(path.path());
+}
+
+void LogindCache::slotUserNew(uint uid, QDBusObjectPath path)
+{
+  QVariantMap seed;
+  seed.insert(QStringLiteral("UID"), uid);
+  addObject(logindUser, path.path(), seed);
+}
+
+void LogindCache::slotUserRemoved(uint, QDBusObjectPath path)
+{
+  removeObject(path.path());
+}
+
+void LogindCache::slotSeatNew(QString id, QDBusObjectPath path)
+{
+  QVariantMap seed;
+  seed.insert(QStringLiteral("Id"), id);
+  addObject(logindSeat, path.path(), seed);
+}
+
+void LogindCache::slotSeatRemoved(QString, QDBusObjectPath path)
+{
+  removeObject(path.path());
+}
+
+void LogindCache::addObject(logindType type, const QString &path, const QVariantMap &seed)
+{
+  if (objectList.contains(path))
+    return;
+
+  Object o;
+  o.type = type;
+  o.properties = seed;
+  objectList.insert(path, o);
+  emit objectAdded(type, path);
+  fetch(path);
+}
+
+void LogindCache::removeObject(const QString &path)
+{
+  QHash<QString, Object>::iterator it = objectList.find(path);
+  if (it == objectList.end())
+    return;
+
+  // Listeners may still read the properties while handling the signal
+  int type = it->type;
+  emit objectRemoved(type, path);
+  objectList.remove(path);
+}
+
+void LogindCache::fetchNext()
+{
+  while (inFlight < maxInFlight && !fetchQueue.isEmpty())
+  {
+    QString path = fetchQueue.takeFirst();
+    queued.remove(path);
+    QHash<QString, Object>::const_iterator it = objectList.constFind(path);
+    if (it == objectList.constEnd())
+      continue;
+
+    QDBusMessage msg = QDBusMessage::createMethodCall(connLogind, path, ifaceDbusProp, QStringLiteral("GetAll"));
+    msg << ifaces[it->type];
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(QDBusConnection::systemBus().asyncCall(msg), this);
+    watcher->setProperty("path", path);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(slotPropertiesReply(QDBusPendingCallWatcher*)));
+    inFlight++;
+  }
+}
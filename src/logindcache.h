@@ -0,0 +1,87 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef LOGINDCACHE_H
+#define LOGINDCACHE_H
+
+#include <QObject>
+#include <QtDBus/QtDBus>
+
+// Kinds of objects kept in LogindCache
+enum logindType
+{
+  logindSession, logindUser, logindSeat, logindTypeCount
+};
+
+// Properties of the logind sessions, users and seats, shared by the views
+// that show them. Objects are added and removed from the logind signals
+// and their properties loaded with batched asynchronous GetAll calls. The
+// full lists are only requested by refresh().
+//
+// Properties that refer to other logind objects by an (id, path) pair,
+// like User or Seat of a session, are stored as the id only. Arrays of
+// such pairs become a QStringList of ids.
+class LogindCache : public QObject
+{
+  Q_OBJECT
+
+public:
+  explicit LogindCache(QObject *parent = 0);
+  void refresh();
+  QStringList objects(logindType type) const;
+  bool contains(const QString &path) const;
+  bool isLoaded(const QString &path) const;
+  QVariantMap properties(const QString &path) const;
+  void fetch(const QString &path, bool urgent = false);
+
+signals:
+  void objectAdded(int type, const QString &path);
+  void objectRemoved(int type, const QString &path);
+  void objectChanged(int type, const QString &path);
+  void listed(int type);
+
+private slots:
+  void slotListReply(QDBusPendingCallWatcher *);
+  void slotPropertiesReply(QDBusPendingCallWatcher *);
+  void slotPropertiesChanged(QString, QVariantMap, QStringList, QDBusMessage);
+  void slotSessionNew(QString, QDBusObjectPath);
+  void slotSessionRemoved(QString, QDBusObjectPath);
+  void slotUserNew(uint, QDBusObjectPath);
+  void slotUserRemoved(uint, QDBusObjectPath);
+  void slotSeatNew(QString, QDBusObjectPath);
+  void slotSeatRemoved(QString, QDBusObjectPath);
+
+private:
+  struct Object
+  {
+    logindType type;
+    QVariantMap properties;
+    bool loaded = false;
+  };
+
+  void addObject(logindType type, const QString &path, const QVariantMap &seed);
+  void removeObject(const QString &path);
+  void fetchNext();
+
+  QHash<QString, Object> objectList;
+  QStringList fetchQueue;
+  QSet<QString> queued;
+  int inFlight = 0;
+};
+
+#endif // LOGINDCACHE_H
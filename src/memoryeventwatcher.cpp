@@ -0,0 +1,317 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "memoryeventwatcher.h"
+
+#include <QFile>
+#include <QSet>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <systemd/sd-journal.h>
+
+static const int maxHistory = 16;
+
+MemoryEventWatcher::MemoryEventWatcher(QObject *parent)
+ : QObject(parent)
+{
+  inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotifyFd >= 0)
+  {
+    notifier = new QSocketNotifier(inotifyFd, QSocketNotifier::Read, this);
+    connect(notifier, SIGNAL(activated(int)), this, SLOT(slotInotify()));
+  }
+
+  // New units are picked up by an occasional scan of the tree
+  rescanTimer = new QTimer(this);
+  connect(rescanTimer, SIGNAL(timeout()), this, SLOT(rescan()));
+  rescanTimer->start(30000);
+  rescan();
+}
+
+MemoryEventWatcher::~MemoryEventWatcher()
+{
+  if (inotifyFd >= 0)
+    ::close(inotifyFd);
+}
+
+QString MemoryEventWatcher::unitKey(const QString &unit, bool userUnit)
+{
+  return (userUnit ? QStringLiteral("u:") : QStringLiteral("s:")) + unit;
+}
+
+bool MemoryEventWatcher::events(const QString &unit, bool userUnit, MemoryEvents *events) const
+{
+  QHash<QString, QString>::const_iterator it = pathByUnit.constFind(unitKey(unit, userUnit));
+  if (it == pathByUnit.constEnd())
+    return false;
+  *events = groups.value(it.value()).events;
+  return true;
+}
+
+QList<MemoryEventRecord> MemoryEventWatcher::history(const QString &unit, bool userUnit) const
+{
+  QString path = pathByUnit.value(unitKey(unit, userUnit));
+  if (path.isEmpty())
+    return QList<MemoryEventRecord>();
+  return groups.value(path).history;
+}
+
+void MemoryEventWatcher::rescan()
+{
+  rescanPending = false;
+  if (inotifyFd < 0)
+    return;
+
+  for (QHash<QString, Group>::iterator it = groups.begin(); it != groups.end(); ++it)
+    it->seen = false;
+
+  // Only the units of our own user manager are shown in the user units
+  // tab, those of other users would clash with them by name
+  const QString ownManager = QStringLiteral("/user@%1.service/").arg(getuid());
+
+  foreach (const UnitCgroup &found, findUnitCgroups())
+  {
+    if (found.userUnit && !found.path.contains(ownManager))
+      continue;
+
+    // The kernel signals changes of memory.events as a modification
+    QByteArray file = QFile::encodeName(QStringLiteral("/sys/fs/cgroup/") + found.path + QStringLiteral("/memory.events"));
+
+    QHash<QString, Group>::iterator it = groups.find(found.path);
+    if (it != groups.end())
+    {
+      it->seen = true;
+      if (it->wd < 0)
+      {
+        // The group was recreated, e.g. by a restart after an OOM kill.
+        // Its counters started from zero, count them as new events.
+        it->wd = inotify_add_watch(inotifyFd, file.constData(), IN_MODIFY);
+        if (it->wd >= 0)
+        {
+          pathByWd.insert(it->wd, found.path);
+          checkGroup(found.path);
+        }
+      }
+      continue;
+    }
+
+    int wd = inotify_add_watch(inotifyFd, file.constData(), IN_MODIFY);
+    if (wd < 0)
+      continue;
+
+    Group g;
+    g.cgroup = found;
+    g.wd = wd;
+    g.seen = true;
+    readEvents(found.path, &g.events);
+    groups.insert(found.path, g);
+    pathByWd.insert(wd, found.path);
+    pathByUnit.insert(unitKey(found.unit, found.userUnit), found.path);
+  }
+
+  for (QHash<QString, Group>::iterator it = groups.begin(); it != groups.end(); )
+  {
+    if (it->seen)
+    {
+      ++it;
+      continue;
+    }
+    if (it->wd >= 0)
+    {
+      inotify_rm_watch(inotifyFd, it->wd);
+      pathByWd.remove(it->wd);
+    }
+    QString key = unitKey(it->cgroup.unit, it->cgroup.userUnit);
+    if (pathByUnit.value(key) == it.key())
+      pathByUnit.remove(key);
+    it = groups.erase(it);
+  }
+}
+
+void MemoryEventWatcher::slotInotify()
+{
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t len;
+  QSet<QString> changed;
+
+  while ((len = read(inotifyFd, buf, sizeof(buf))) > 0)
+  {
+    for (char *ptr = buf; ptr < buf + len; )
+    {
+      const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(ptr);
+      ptr += sizeof(struct inotify_event) + event->len;
+
+      // The watch is removed by the kernel when the group goes away. A
+      // restarted unit gets a new group at the same path soon after, so
+      // look for it again shortly instead of waiting for the next rescan.
+      if (event->mask & IN_IGNORED)
+      {
+        QHash<QString, Group>::iterator it = groups.find(pathByWd.take(event->wd));
+        if (it != groups.end())
+        {
+          it->wd = -1;
+          it->events = MemoryEvents();
+          if (!rescanPending)
+          {
+            rescanPending = true;
+            QTimer::singleShot(2000, this, SLOT(rescan()));
+          }
+        }
+        continue;
+      }
+      QString path = pathByWd.value(event->wd);
+      if (!path.isEmpty())
+        changed.insert(path);
+    }
+  }
+
+  foreach (const QString &path, changed)
+    checkGroup(path);
+}
+
+void MemoryEventWatcher::checkGroup(const QString &path)
+{
+  // Records the change of the counters since they were last read
+  QHash<QString, Group>::iterator it = groups.find(path);
+  MemoryEvents now;
+  if (it == groups.end() || !readEvents(path, &now))
+    return;
+
+  MemoryEventRecord record;
+  record.time = QDateTime::currentDateTime();
+  record.delta.oom = now.oom - it->events.oom;
+  record.delta.oomKill = now.oomKill - it->events.oomKill;
+  record.delta.high = now.high - it->events.high;
+  record.delta.max = now.max - it->events.max;
+  it->events = now;
+
+  // Only "low" changed, which is not tracked
+  if (record.delta.oom == 0 && record.delta.oomKill == 0 && record.delta.high == 0 && record.delta.max == 0)
+    return;
+
+  it->history.append(record);
+  if (it->history.size() > maxHistory)
+    it->history.removeFirst();
+
+  // The kernel logs the kill right around the counter change
+  if (record.delta.oomKill > 0 && !pendingCorrelation.contains(path))
+  {
+    pendingCorrelation.append(path);
+    QTimer::singleShot(2000, this, SLOT(slotCorrelate()));
+  }
+
+  emit eventsChanged(it->cgroup.unit, it->cgroup.userUnit);
+}
+
+void MemoryEventWatcher::slotCorrelate()
+{
+  foreach (const QString &path, pendingCorrelation)
+  {
+    QHash<QString, Group>::iterator it = groups.find(path);
+    if (it == groups.end())
+      continue;
+    for (int i = it->history.size() - 1; i >= 0; --i)
+    {
+      MemoryEventRecord &record = it->history[i];
+      if (record.delta.oomKill > 0 && record.kernelMessage.isEmpty())
+        record.kernelMessage = kernelMessage(path, record.time);
+    }
+    emit eventsChanged(it->cgroup.unit, it->cgroup.userUnit);
+  }
+  pendingCorrelation.clear();
+}
+
+bool MemoryEventWatcher::readEvents(const QString &path, MemoryEvents *events) const
+{
+  // "low 0\nhigh 0\nmax 0\noom 0\noom_kill 0\n..."
+  QByteArray file = QFile::encodeName(QStringLiteral("/sys/fs/cgroup/") + path + QStringLiteral("/memory.events"));
+  int fd = ::open(file.constData(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  char buf[512];
+  ssize_t len = read(fd, buf, sizeof(buf) - 1);
+  ::close(fd);
+  if (len <= 0)
+    return false;
+  buf[len] = '\0';
+
+  *events = MemoryEvents();
+  for (const char *line = buf; line && *line; )
+  {
+    const char *value = strchr(line, ' ');
+    if (!value)
+      break;
+    qulonglong n = strtoull(value + 1, NULL, 10);
+    size_t keyLen = value - line;
+    if (keyLen == 4 && strncmp(line, "high", 4) == 0)
+      events->high = n;
+    else if (keyLen == 3 && strncmp(line, "max", 3) == 0)
+      events->max = n;
+    else if (keyLen == 3 && strncmp(line, "oom", 3) == 0)
+      events->oom = n;
+    else if (keyLen == 8 && strncmp(line, "oom_kill", 8) == 0)
+      events->oomKill = n;
+    line = strchr(line, '\n');
+    if (line)
+      ++line;
+  }
+  return true;
+}
+
+QString MemoryEventWatcher::kernelMessage(const QString &path, const QDateTime &time) const
+{
+  // Finds the kernel's report of an OOM kill in the group. The
+  // "oom-kill:" line names the group, the "Killed process" line that
+  // follows it names the victim and is preferred.
+  sd_journal *journal;
+  if (sd_journal_open(&journal, SD_JOURNAL_LOCAL_ONLY | SD_JOURNAL_SYSTEM) != 0)
+    return QString();
+
+  QString result;
+  QByteArray memcg = "task_memcg=/" + QFile::encodeName(path);
+  sd_journal_add_match(journal, "_TRANSPORT=kernel", 0);
+  if (sd_journal_seek_realtime_usec(journal, quint64(time.addSecs(-30).toMSecsSinceEpoch()) * 1000) == 0)
+  {
+    const void *data;
+    size_t length;
+    bool found = false;
+    while (sd_journal_next(journal) > 0)
+    {
+      if (sd_journal_get_data(journal, "MESSAGE", &data, &length) != 0)
+        continue;
+      QByteArray msg((const char *)data + 8, int(length) - 8);
+      if (msg.contains(memcg.constData()))
+      {
+        found = true;
+        result = QString::fromUtf8(msg);
+      }
+      else if (found && msg.contains("Killed process"))
+      {
+        result = QString::fromUtf8(msg);
+        found = false;
+      }
+    }
+  }
+  sd_journal_close(journal);
+  return result;
+}
@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef MEMORYEVENTWATCHER_H
+#define MEMORYEVENTWATCHER_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QHash>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include "cgroupstat.h"
+
+// Counters from the memory.events file of a control group
+struct MemoryEvents
+{
+  qulonglong oom = 0, oomKill = 0, high = 0, max = 0;
+};
+
+// A change of the counters, with the kernel's report of the kill if the
+// OOM killer struck
+struct MemoryEventRecord
+{
+  QDateTime time;
+  MemoryEvents delta;
+  QString kernelMessage;
+};
+
+// Watches memory.events of the control groups of all units with
+// inotify, so changes are noticed without reading the files
+// periodically. The groups are looked for again now and then to pick
+// up new units.
+class MemoryEventWatcher : public QObject
+{
+  Q_OBJECT
+
+public:
+  explicit MemoryEventWatcher(QObject *parent = 0);
+  ~MemoryEventWatcher();
+  bool events(const QString &unit, bool userUnit, MemoryEvents *events) const;
+  QList<MemoryEventRecord> history(const QString &unit, bool userUnit) const;
+
+signals:
+  void eventsChanged(const QString &unit, bool userUnit);
+
+public slots:
+  void rescan();
+
+private slots:
+  void slotInotify();
+  void slotCorrelate();
+
+private:
+  struct Group
+  {
+    UnitCgroup cgroup;
+    int wd = -1;
+    bool seen = false;
+    MemoryEvents events;
+    QList<MemoryEventRecord> history;
+  };
+
+  static QString unitKey(const QString &unit, bool userUnit);
+  void checkGroup(const QString &path);
+  bool readEvents(const QString &path, MemoryEvents *events) const;
+  QString kernelMessage(const QString &path, const QDateTime &time) const;
+
+  int inotifyFd;
+  QSocketNotifier *notifier = NULL;
+  QTimer *rescanTimer;
+  QHash<QString, Group> groups;
+  QHash<int, QString> pathByWd;
+  QHash<QString, QString> pathByUnit;
+  QStringList pendingCorrelation;
+  bool rescanPending = false;
+};
+
+#endif // MEMORYEVENTWATCHER_H
@@ -0,0 +1,197 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "pressurewatcher.h"
+
+#include <QFile>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+PressureWatcher::PressureWatcher(QObject *parent)
+ : QThread(parent)
+{
+  qRegisterMetaType<PressureTrigger>();
+  if (pipe2(wakeFds, O_CLOEXEC | O_NONBLOCK) != 0)
+    wakeFds[0] = wakeFds[1] = -1;
+}
+
+PressureWatcher::~PressureWatcher()
+{
+  {
+    QMutexLocker locker(&mutex);
+    stopping = true;
+  }
+  wake();
+  wait();
+
+  foreach (const Watch &w, watches)
+    ::close(w.fd);
+  if (wakeFds[0] >= 0)
+  {
+    ::close(wakeFds[0]);
+    ::close(wakeFds[1]);
+  }
+}
+
+int PressureWatcher::addTrigger(const PressureTrigger &trigger, QString *error)
+{
+  // The trigger is registered by writing "<some|full> <stall us> <window us>"
+  // to the pressure file. It lives as long as the file stays open.
+  if (wakeFds[0] < 0)
+  {
+    *error = QString::fromLocal8Bit(strerror(EMFILE));
+    return -1;
+  }
+
+  QByteArray path = QFile::encodeName(QStringLiteral("/sys/fs/cgroup") + trigger.cgroup + '/' +
+                                      QLatin1String(pressureFileName(trigger.resource)));
+  int fd = ::open(path.constData(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0)
+  {
+    *error = QString::fromLocal8Bit(strerror(errno));
+    return -1;
+  }
+
+  char buf[64];
+  int len = snprintf(buf, sizeof(buf), "%s %lld %lld", trigger.full ? "full" : "some",
+                     qint64(trigger.stallMs) * 1000, qint64(trigger.windowMs) * 1000);
+  if (write(fd, buf, len + 1) < 0)
+  {
+    *error = QString::fromLocal8Bit(strerror(errno));
+    ::close(fd);
+    return -1;
+  }
+
+  Watch w;
+  w.trigger = trigger;
+  w.fd = fd;
+  {
+    QMutexLocker locker(&mutex);
+    w.trigger.id = nextId++;
+    watches.append(w);
+  }
+  if (!isRunning())
+    start(QThread::LowPriority);
+  wake();
+  return w.trigger.id;
+}
+
+void PressureWatcher::removeTrigger(int id)
+{
+  // The thread closes the file, it may be polling it right now
+  QMutexLocker locker(&mutex);
+  for (int i = 0; i < watches.size(); ++i)
+  {
+    if (watches.at(i).trigger.id == id)
+      watches[i].removed = true;
+  }
+  locker.unlock();
+  wake();
+}
+
+QList<PressureTrigger> PressureWatcher::triggers(const QString &unit, bool userUnit) const
+{
+  QList<PressureTrigger> list;
+  QMutexLocker locker(&mutex);
+  foreach (const Watch &w, watches)
+  {
+    if (!w.removed && w.trigger.unit == unit && w.trigger.userUnit == userUnit)
+      list << w.trigger;
+  }
+  return list;
+}
+
+void PressureWatcher::wake()
+{
+  if (wakeFds[1] >= 0)
+  {
+    // A full pipe wakes the thread just as well
+    char c = 0;
+    ssize_t ret = write(wakeFds[1], &c, 1);
+    Q_UNUSED(ret);
+  }
+}
+
+void PressureWatcher::run()
+{
+  QVector<pollfd> fds;
+  QVector<PressureTrigger> polled;
+
+  forever
+  {
+    {
+      QMutexLocker locker(&mutex);
+      if (stopping)
+        return;
+
+      for (int i = watches.size() - 1; i >= 0; --i)
+      {
+        if (watches.at(i).removed)
+        {
+          ::close(watches.at(i).fd);
+          watches.remove(i);
+        }
+      }
+
+      fds.resize(watches.size() + 1);
+      polled.resize(watches.size());
+      fds[0].fd = wakeFds[0];
+      fds[0].events = POLLIN;
+      for (int i = 0; i < watches.size(); ++i)
+      {
+        fds[i + 1].fd = watches.at(i).fd;
+        fds[i + 1].events = POLLPRI;
+        polled[i] = watches.at(i).trigger;
+      }
+    }
+
+    if (poll(fds.data(), fds.size(), -1) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+
+    if (fds.at(0).revents & POLLIN)
+    {
+      char buf[64];
+      while (read(wakeFds[0], buf, sizeof(buf)) > 0)
+        ;
+    }
+
+    for (int i = 1; i < fds.size(); ++i)
+    {
+      short revents = fds.at(i).revents;
+      if (revents & POLLERR)
+      {
+        // The control group is gone, the trigger cannot fire any more
+        removeTrigger(polled.at(i - 1).id);
+        emit expired(polled.at(i - 1));
+      }
+      else if (revents & POLLPRI)
+      {
+        emit triggered(polled.at(i - 1));
+      }
+    }
+  }
+}
@@ -0,0 +1,78 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef PRESSUREWATCHER_H
+#define PRESSUREWATCHER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QVector>
+
+#include "cgroupstat.h"
+
+// A PSI trigger registered with the kernel on a pressure file
+struct PressureTrigger
+{
+  int id = -1;
+  QString unit, cgroup;
+  pressureResource resource = pressureCpu;
+  bool full = false, userUnit = false;
+  int stallMs = 0, windowMs = 0;
+};
+
+// Registers pressure triggers with the kernel and waits for them with
+// poll() on a thread of its own, so an alert arrives as soon as the
+// kernel raises it.
+class PressureWatcher : public QThread
+{
+  Q_OBJECT
+
+public:
+  explicit PressureWatcher(QObject *parent = 0);
+  ~PressureWatcher();
+  int addTrigger(const PressureTrigger &trigger, QString *error);
+  void removeTrigger(int id);
+  QList<PressureTrigger> triggers(const QString &unit, bool userUnit) const;
+
+signals:
+  void triggered(const PressureTrigger &trigger);
+  void expired(const PressureTrigger &trigger);
+
+protected:
+  void run();
+
+private:
+  struct Watch
+  {
+    PressureTrigger trigger;
+    int fd = -1;
+    bool removed = false;
+  };
+
+  void wake();
+
+  mutable QMutex mutex;
+  QVector<Watch> watches;
+  int wakeFds[2];
+  int nextId = 0;
+  bool stopping = false;
+};
+
+Q_DECLARE_METATYPE(PressureTrigger)
+
+#endif // PRESSUREWATCHER_H
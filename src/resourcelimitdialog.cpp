@@ -0,0 +1,211 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "resourcelimitdialog.h"
+
+#include <QDialogButtonBox>
+#include <QPushButton>
+#include <QThread>
+#include <QVBoxLayout>
+
+#include <KFormat>
+#include <KLocalizedString>
+
+#include <limits.h>
+
+// systemd uses this for "no limit" and "default"
+static const qulonglong unset = Q_UINT64_C(0xffffffffffffffff);
+static const qulonglong mebibyte = 1024 * 1024;
+
+ResourceLimitDialog::ResourceLimitDialog(QWidget *parent, const QString &unit, const QDBusObjectPath &path,
+                                         QDBusConnection bus, UnitResourceMonitor *monitor)
+ : QDialog(parent)
+{
+  unitId = unit;
+  unitPath = path;
+  resourceMonitor = monitor;
+  setWindowTitle(i18n("Resource Limits of %1", unit));
+
+  QGridLayout *grid = new QGridLayout;
+  grid->addWidget(new QLabel(i18n("<b>Limit</b>"), this), 0, 1);
+  grid->addWidget(new QLabel(i18n("<b>Current usage</b>"), this), 0, 2);
+  QVBoxLayout *vlayout = new QVBoxLayout;
+  vlayout->addLayout(grid);
+  setLayout(vlayout);
+
+  // Spin boxes at their minimum show the "no limit" text
+  addLimit(grid, limitCpuQuota, i18n("CPU quota:"), i18n("No limit"), 100 * QThread::idealThreadCount());
+  addLimit(grid, limitCpuWeight, i18n("CPU weight:"), i18n("Default"), 10000);
+  addLimit(grid, limitMemoryHigh, i18n("Memory high:"), i18n("No limit"), INT_MAX);
+  addLimit(grid, limitMemoryMax, i18n("Memory max:"), i18n("No limit"), INT_MAX);
+  addLimit(grid, limitIOWeight, i18n("IO weight:"), i18n("Default"), 10000);
+  addLimit(grid, limitTasksMax, i18n("Tasks max:"), i18n("No limit"), INT_MAX);
+  spinBoxes[limitCpuQuota]->setSuffix(i18n(" %"));
+  spinBoxes[limitMemoryHigh]->setSuffix(i18n(" MiB"));
+  spinBoxes[limitMemoryMax]->setSuffix(i18n(" MiB"));
+
+  int row = grid->rowCount();
+  leAllowedCpus = new QLineEdit(this);
+  leAllowedCpus->setPlaceholderText(i18n("All CPUs"));
+  leAllowedCpus->setToolTip(i18n("A list of CPUs and ranges, e.g. 0-3,8"));
+  lblCpusUsage = new QLabel(this);
+  grid->addWidget(new QLabel(i18n("Allowed CPUs:"), this), row, 0);
+  grid->addWidget(leAllowedCpus, row, 1);
+  grid->addWidget(lblCpusUsage, row, 2);
+
+  // Read the current limits from the unit
+  QDBusInterface iface("org.freedesktop.systemd1", path.path(),
+                       UnitResourceMonitor::resourceInterface(unit), bus);
+  const char *props[limitCount] = { "CPUQuotaPerSecUSec", "CPUWeight", "MemoryHigh",
+                                    "MemoryMax", "IOWeight", "TasksMax" };
+  for (int i = 0; i < limitCount; ++i)
+  {
+    QVariant value = iface.property(props[i]);
+    qulonglong v = value.toULongLong();
+    int shown = 0;
+    if (!value.isValid())
+      spinBoxes[i]->setEnabled(false);
+    else if (v != unset)
+    {
+      if (i == limitCpuQuota)
+        shown = qMax<qulonglong>(1, v / 10000);
+      else if (i == limitMemoryHigh || i == limitMemoryMax)
+        shown = qMin<qulonglong>(INT_MAX, qMax<qulonglong>(1, v / mebibyte));
+      else
+        shown = qMin<qulonglong>(INT_MAX, v);
+    }
+    spinBoxes[i]->setValue(shown);
+    initialValues[i] = spinBoxes[i]->value();
+  }
+  QVariant cpus = iface.property("AllowedCPUs");
+  if (cpus.isValid())
+    initialCpus = cpuMaskToList(cpus.toByteArray());
+  else
+    leAllowedCpus->setEnabled(false);
+  leAllowedCpus->setText(initialCpus);
+  lblCpusUsage->setText(cpuMaskToList(iface.property("EffectiveCPUs").toByteArray()));
+
+  chkRuntime = new QCheckBox(i18n("Apply until the next reboot only"), this);
+  chkRuntime->setChecked(true);
+  chkRuntime->setToolTip(i18n("When unchecked, the limits are written to a drop-in in /etc/systemd/system.control"));
+  vlayout->addWidget(chkRuntime);
+
+  QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok |
+                                                     QDialogButtonBox::Cancel,
+                                                     this);
+  connect(buttonBox, SIGNAL(accepted()), this, SLOT(accept()));
+  connect(buttonBox, SIGNAL(rejected()), this, SLOT(reject()));
+  vlayout->addWidget(buttonBox);
+  connect(leAllowedCpus, SIGNAL(textChanged(QString)), this, SLOT(slotValidate()));
+
+  // Show the usage live while the dialog is open
+  connect(resourceMonitor, SIGNAL(sampled(QString)), this, SLOT(slotSampled(QString)));
+  sampleTimer = new QTimer(this);
+  connect(sampleTimer, SIGNAL(timeout()), this, SLOT(slotSample()));
+  sampleTimer->start(1000);
+  slotSample();
+  slotSampled(unitId);
+}
+
+void ResourceLimitDialog::addLimit(QGridLayout *grid, limitType type, const QString &label, const QString &unlimited, int max)
+{
+  int row = grid->rowCount();
+
+  QSpinBox *spinBox = new QSpinBox(this);
+  spinBox->setRange(0, max);
+  spinBox->setSpecialValueText(unlimited);
+  usageLabels[type] = new QLabel(this);
+  spinBoxes[type] = spinBox;
+
+  grid->addWidget(new QLabel(label, this), row, 0);
+  grid->addWidget(spinBox, row, 1);
+  grid->addWidget(usageLabels[type], row, 2);
+}
+
+void ResourceLimitDialog::slotSample()
+{
+  resourceMonitor->sample(unitId, unitPath);
+}
+
+void ResourceLimitDialog::slotSampled(const QString &id)
+{
+  if (id != unitId)
+    return;
+
+  UnitUsage u = resourceMonitor->usage(unitId);
+  QString cpu = u.hasRates ? i18n("%1% CPU", QString::number(u.cpuPercent, 'f', 1)) : QString();
+  QString io = u.hasRates ? i18n("%1/s read, %2/s written",
+                                 KFormat().formatByteSize(u.ioReadRate),
+                                 KFormat().formatByteSize(u.ioWriteRate)) : QString();
+  QString memory = u.valid ? KFormat().formatByteSize(u.memory) : QString();
+
+  usageLabels[limitCpuQuota]->setText(cpu);
+  usageLabels[limitCpuWeight]->setText(cpu);
+  usageLabels[limitMemoryHigh]->setText(memory);
+  usageLabels[limitMemoryMax]->setText(memory);
+  usageLabels[limitIOWeight]->setText(io);
+  usageLabels[limitTasksMax]->setText(u.valid ? i18np("1 task", "%1 tasks", u.tasks) : QString());
+}
+
+void ResourceLimitDialog::slotValidate()
+{
+  bool ok;
+  cpuListToMask(leAllowedCpus->text(), &ok);
+  QDialogButtonBox *buttonBox = findChild<QDialogButtonBox *>();
+  if (buttonBox)
+    buttonBox->button(QDialogButtonBox::Ok)->setEnabled(ok);
+}
+
+UnitPropertyList ResourceLimitDialog::properties() const
+{
+  // Only the limits that were changed are applied
+  UnitPropertyList list;
+  const char *props[limitCount] = { "CPUQuotaPerSecUSec", "CPUWeight", "MemoryHigh",
+                                    "MemoryMax", "IOWeight", "TasksMax" };
+  for (int i = 0; i < limitCount; ++i)
+  {
+    int value = spinBoxes[i]->value();
+    if (value == initialValues[i])
+      continue;
+    qulonglong v = unset;
+    if (value > 0)
+    {
+      if (i == limitCpuQuota)
+        v = qulonglong(value) * 10000;
+      else if (i == limitMemoryHigh || i == limitMemoryMax)
+        v = qulonglong(value) * mebibyte;
+      else
+        v = value;
+    }
+    list << UnitProperty(QLatin1String(props[i]), QVariant(v));
+  }
+
+  if (leAllowedCpus->text() != initialCpus)
+  {
+    bool ok;
+    QByteArray mask = cpuListToMask(leAllowedCpus->text(), &ok);
+    if (ok)
+      list << UnitProperty(QStringLiteral("AllowedCPUs"), QVariant(mask));
+  }
+  return list;
+}
+
+bool ResourceLimitDialog::runtime() const
+{
+  return chkRuntime->isChecked();
+}
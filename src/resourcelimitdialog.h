@@ -0,0 +1,74 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef RESOURCELIMITDIALOG_H
+#define RESOURCELIMITDIALOG_H
+
+#include <QDialog>
+#include <QCheckBox>
+#include <QGridLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QSpinBox>
+#include <QTimer>
+
+#include "unitproperty.h"
+#include "cputopology.h"
+#include "unitresourcemonitor.h"
+
+// Edits the resource control properties of a unit, showing the current
+// usage of the unit next to each limit. The changed limits are applied
+// by the caller with SetUnitProperties.
+class ResourceLimitDialog : public QDialog
+{
+  Q_OBJECT
+
+public:
+  ResourceLimitDialog(QWidget *parent, const QString &unit, const QDBusObjectPath &path,
+                      QDBusConnection bus, UnitResourceMonitor *monitor);
+  UnitPropertyList properties() const;
+  bool runtime() const;
+
+private slots:
+  void slotSample();
+  void slotSampled(const QString &id);
+  void slotValidate();
+
+private:
+  enum limitType
+  {
+    limitCpuQuota, limitCpuWeight, limitMemoryHigh, limitMemoryMax,
+    limitIOWeight, limitTasksMax, limitCount
+  };
+
+  void addLimit(QGridLayout *grid, limitType type, const QString &label, const QString &unlimited, int max);
+
+  QString unitId;
+  QDBusObjectPath unitPath;
+  UnitResourceMonitor *resourceMonitor;
+  QSpinBox *spinBoxes[limitCount];
+  QLabel *usageLabels[limitCount];
+  int initialValues[limitCount];
+  QLineEdit *leAllowedCpus;
+  QLabel *lblCpusUsage;
+  QString initialCpus;
+  QCheckBox *chkRuntime;
+  QTimer *sampleTimer;
+};
+
+#endif // RESOURCELIMITDIALOG_H
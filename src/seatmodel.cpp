@@ -0,0 +1,190 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "seatmodel.h"
+
+#include <KLocalizedString>
+
+SeatModel::SeatModel(QObject *parent, LogindCache *cache)
+ : QAbstractTableModel(parent)
+{
+  logind = cache;
+
+  headerCache << i18n("Seat ID")
+              << i18n("Active Session")
+              << i18n("Sessions")
+              << i18n("Graphical")
+              << i18n("Text Terminals");
+
+  connect(logind, SIGNAL(objectAdded(int,QString)), this, SLOT(slotObjectAdded(int,QString)));
+  connect(logind, SIGNAL(objectRemoved(int,QString)), this, SLOT(slotObjectRemoved(int,QString)));
+  connect(logind, SIGNAL(objectChanged(int,QString)), this, SLOT(slotObjectChanged(int,QString)));
+  foreach (const QString &path, logind->objects(logindSeat))
+    slotObjectAdded(logindSeat, path);
+  foreach (const QString &path, logind->objects(logindSession))
+    slotObjectAdded(logindSession, path);
+}
+
+int SeatModel::rowCount(const QModelIndex &) const
+{
+  return seatList.size();
+}
+
+int SeatModel::columnCount(const QModelIndex &) const
+{
+  return 5;
+}
+
+QVariant SeatModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+  if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < headerCache.size())
+    return headerCache.at(section);
+  return QVariant();
+}
+
+QVariant SeatModel::data(const QModelIndex &index, int role) const
+{
+  if (!index.isValid() || index.row() >= seatList.size() || role != Qt::DisplayRole)
+    return QVariant();
+
+  const Seat &seat = seatList.at(index.row());
+  switch (index.column())
+  {
+    case 0: return seat.id;
+    case 1: return seat.activeSession;
+    case 2: return sessionCount.value(seat.id);
+    case 3: return seat.canGraphical ? i18n("yes") : i18n("no");
+    case 4: return seat.canTTY ? i18n("yes") : i18n("no");
+  }
+  return QVariant();
+}
+
+void SeatModel::slotObjectAdded(int type, const QString &path)
+{
+  if (type == logindSession)
+  {
+    updateSession(path, false);
+  }
+  else if (type == logindSeat && !rowByPath.contains(path))
+  {
+    Seat seat;
+    seat.path = path;
+    int row = seatList.size();
+    beginInsertRows(QModelIndex(), row, row);
+    seatList.append(seat);
+    rowByPath.insert(path, row);
+    endInsertRows();
+    applyProperties(row);
+  }
+}
+
+void SeatModel::slotObjectRemoved(int type, const QString &path)
+{
+  if (type == logindSession)
+  {
+    updateSession(path, true);
+  }
+  else if (type == logindSeat)
+  {
+    int row = rowByPath.value(path, -1);
+    if (row == -1)
+      return;
+    beginRemoveRows(QModelIndex(), row, row);
+    seatList.removeAt(row);
+    endRemoveRows();
+    rebuildIndex();
+  }
+}
+
+void SeatModel::slotObjectChanged(int type, const QString &path)
+{
+  if (type == logindSession)
+  {
+    updateSession(path, false);
+  }
+  else if (type == logindSeat)
+  {
+    int row = rowByPath.value(path, -1);
+    if (row != -1)
+      applyProperties(row);
+  }
+}
+
+void SeatModel::applyProperties(int row)
+{
+  QVariantMap props = logind->properties(seatList.at(row).path);
+  Seat &seat = seatList[row];
+  QString id = props.value(QStringLiteral("Id"), seat.id).toString();
+  if (id != seat.id || !rowById.contains(id))
+  {
+    rowById.remove(seat.id);
+    seat.id = id;
+    rowById.insert(id, row);
+  }
+  seat.activeSession = props.value(QStringLiteral("ActiveSession"), seat.activeSession).toString();
+  seat.canGraphical = props.value(QStringLiteral("CanGraphical"), seat.canGraphical).toBool();
+  seat.canTTY = props.value(QStringLiteral("CanTTY"), seat.canTTY).toBool();
+
+  emit dataChanged(index(row, 0), index(row, columnCount() - 1));
+}
+
+void SeatModel::updateSession(const QString &path, bool removed)
+{
+  // Moves the session between the per-seat totals. Sessions without a
+  // seat, like remote logins, are not counted.
+  QString seat;
+  if (!removed)
+    seat = logind->properties(path).value(QStringLiteral("Seat")).toString();
+
+  QHash<QString, QString>::iterator it = sessionSeat.find(path);
+  if (it != sessionSeat.end())
+  {
+    if (it.value() == seat)
+      return;
+    addToTotals(it.value(), -1);
+    sessionSeat.erase(it);
+  }
+  if (!seat.isEmpty())
+  {
+    sessionSeat.insert(path, seat);
+    addToTotals(seat, 1);
+  }
+}
+
+void SeatModel::addToTotals(const QString &seat, int delta)
+{
+  int &count = sessionCount[seat];
+  count += delta;
+  if (count == 0)
+    sessionCount.remove(seat);
+
+  int row = rowById.value(seat, -1);
+  if (row != -1)
+    emit dataChanged(index(row, 2), index(row, 2));
+}
+
+void SeatModel::rebuildIndex()
+{
+  rowByPath.clear();
+  rowById.clear();
+  for (int row = 0; row < seatList.size(); ++row)
+  {
+    rowByPath.insert(seatList.at(row).path, row);
+    rowById.insert(seatList.at(row).id, row);
+  }
+}
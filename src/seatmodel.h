@@ -0,0 +1,65 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef SEATMODEL_H
+#define SEATMODEL_H
+
+#include <QAbstractTableModel>
+
+#include "logindcache.h"
+
+// Model for the seats tab. The session count of each seat is a total over
+// the sessions in the LogindCache, updated as single sessions come, go
+// or change seat.
+class SeatModel : public QAbstractTableModel
+{
+  Q_OBJECT
+
+public:
+  explicit SeatModel(QObject *parent = 0, LogindCache *cache = NULL);
+  int rowCount(const QModelIndex & parent = QModelIndex()) const;
+  int columnCount(const QModelIndex & parent = QModelIndex()) const;
+  QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+  QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+
+private slots:
+  void slotObjectAdded(int type, const QString &path);
+  void slotObjectRemoved(int type, const QString &path);
+  void slotObjectChanged(int type, const QString &path);
+
+private:
+  struct Seat
+  {
+    QString path, id, activeSession;
+    bool canGraphical = false, canTTY = false;
+  };
+
+  void applyProperties(int row);
+  void updateSession(const QString &path, bool removed);
+  void addToTotals(const QString &seat, int delta);
+  void rebuildIndex();
+
+  LogindCache *logind;
+  QList<Seat> seatList;
+  QHash<QString, int> rowByPath, rowById;
+  QHash<QString, int> sessionCount;
+  QHash<QString, QString> sessionSeat;
+  QVector<QVariant> headerCache;
+};
+
+#endif // SEATMODEL_H
@@ -0,0 +1,362 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "sessionmodel.h"
+
+#include <QDateTime>
+#include <QFont>
+#include <KLocalizedString>
+#include <KColorScheme>
+
+// Indexes into brushCache
+enum sessionForeground
+{
+  fgNormal, fgActive, fgClosing
+};
+
+SessionModel::SessionModel(QObject *parent, LogindCache *cache)
+ : QAbstractTableModel(parent)
+{
+  logind = cache;
+
+  headerCache << i18n("Session ID")
+              << i18n("Session Object Path") // This column is hidden
+              << i18n("State")
+              << i18n("User ID")
+              << i18n("User Name")
+              << i18n("Seat ID")
+              << i18n("CPU Time")
+              << i18n("Memory")
+              << i18n("Tasks");
+  QFont font;
+  font.setItalic(true);
+  staleFont = font;
+  updateBrushes();
+
+  connect(logind, SIGNAL(objectAdded(int,QString)), this, SLOT(slotObjectAdded(int,QString)));
+  connect(logind, SIGNAL(objectRemoved(int,QString)), this, SLOT(slotObjectRemoved(int,QString)));
+  connect(logind, SIGNAL(objectChanged(int,QString)), this, SLOT(slotObjectChanged(int,QString)));
+  connect(logind, SIGNAL(listed(int)), this, SLOT(slotListed(int)));
+  foreach (const QString &path, logind->objects(logindSession))
+    slotObjectAdded(logindSession, path);
+}
+
+int SessionModel::rowCount(const QModelIndex &) const
+{
+  return sessionList.size();
+}
+
+int SessionModel::columnCount(const QModelIndex &) const
+{
+  return 9;
+}
+
+QVariant SessionModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+  if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < headerCache.size())
+    return headerCache.at(section);
+  return QVariant();
+}
+
+QVariant SessionModel::data(const QModelIndex &index, int role) const
+{
+  if (!index.isValid() || index.row() >= sessionList.size())
+    return QVariant();
+
+  const Session &s = sessionList.at(index.row());
+
+  if (role == Qt::UserRole && index.column() >= 6)
+  {
+    switch (index.column())
+    {
+      case 6: return s.usage.cpuUsec;
+      case 7: return s.usage.memoryBytes;
+      case 8: return s.usage.tasks;
+    }
+  }
+  else if (role == Qt::DisplayRole || role == Qt::UserRole)
+  {
+    switch (index.column())
+    {
+      case 0: return s.session.session_id;
+      case 1: return s.session.session_path.path();
+      case 2: return s.session.session_state;
+      case 3: return s.session.user_id != noUid ? QString::number(s.session.user_id) : QString();
+      case 4: return s.session.user_name;
+      case 5: return s.session.seat_id;
+      case 6: return s.usage.valid ? format.formatDuration(s.usage.cpuUsec / 1000) : QString();
+      case 7: return s.usage.valid ? format.formatByteSize(s.usage.memoryBytes) : QString();
+      case 8: return s.usage.valid ? QString::number(s.usage.tasks) : QString();
+    }
+  }
+  else if (role == Qt::ForegroundRole)
+  {
+    if (s.session.session_state == QLatin1String("active"))
+      return brushCache.at(fgActive);
+    else if (s.session.session_state == QLatin1String("closing"))
+      return brushCache.at(fgClosing);
+    return brushCache.at(fgNormal);
+  }
+  else if (role == Qt::FontRole)
+  {
+    // Sessions from the cache are shown in italics until logind confirms them
+    if (s.stale)
+      return staleFont;
+  }
+  else if (role == Qt::ToolTipRole)
+  {
+    // Built from the cached properties, see fetchProperties()
+    if (logind->isLoaded(s.session.session_path.path()))
+      return toolTip(s.session.session_path.path());
+  }
+
+  return QVariant();
+}
+
+void SessionModel::setCachedRows(const QList<QStringList> &rows)
+{
+  // Rows that logind does not confirm are removed by slotListed()
+  beginResetModel();
+  sessionList.clear();
+  foreach (const QStringList &cols, rows)
+  {
+    Session s;
+    s.session.session_id = cols.value(0);
+    s.session.session_path = QDBusObjectPath(cols.value(1));
+    s.session.session_state = cols.value(2);
+    s.session.user_id = cols.value(3).isEmpty() ? noUid : cols.value(3).toUInt();
+    s.session.user_name = cols.value(4);
+    s.session.seat_id = cols.value(5);
+    s.stale = true;
+    sessionList.append(s);
+  }
+  rebuildIndex();
+  endResetModel();
+}
+
+QList<QStringList> SessionModel::cachedRows() const
+{
+  QList<QStringList> rows;
+  rows.reserve(sessionList.size());
+  foreach (const Session &s, sessionList)
+  {
+    rows << (QStringList() << s.session.session_id
+                           << s.session.session_path.path()
+                           << s.session.session_state
+                           << (s.session.user_id != noUid ? QString::number(s.session.user_id) : QString())
+                           << s.session.user_name
+                           << s.session.seat_id);
+  }
+  return rows;
+}
+
+QString SessionModel::cgroup(int row) const
+{
+  // Sessions are scopes in the slice of their user
+  QVariantMap props = logind->properties(sessionList.at(row).session.session_path.path());
+  QString scope = props.value(QStringLiteral("Scope")).toString();
+  if (scope.isEmpty() || !props.contains(QStringLiteral("User")))
+    return QString();
+  return sliceCgroupPath(QStringLiteral("user-%1.slice").arg(props.value(QStringLiteral("User")).toUInt())) + '/' + scope;
+}
+
+void SessionModel::setUsage(int row, const CgroupUsage &usage)
+{
+  if (sessionList.at(row).usage == usage)
+    return;
+  sessionList[row].usage = usage;
+  emit dataChanged(index(row, 6), index(row, 8));
+}
+
+bool SessionModel::hasProperties(int row) const
+{
+  return row >= 0 && row < sessionList.size() && logind->isLoaded(sessionList.at(row).session.session_path.path());
+}
+
+void SessionModel::fetchProperties(int row)
+{
+  // Puts the session first in line, propertiesLoaded() is emitted
+  // when the reply arrives
+  if (row >= 0 && row < sessionList.size())
+    logind->fetch(sessionList.at(row).session.session_path.path(), true);
+}
+
+void SessionModel::paletteChanged()
+{
+  updateBrushes();
+  if (rowCount() > 0)
+    emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+}
+
+void SessionModel::slotObjectAdded(int type, const QString &path)
+{
+  if (type != logindSession)
+    return;
+
+  int row = rowByPath.value(path, -1);
+  if (row == -1)
+  {
+    Session s;
+    s.session.session_path = QDBusObjectPath(path);
+    s.session.user_id = noUid;
+    row = sessionList.size();
+    beginInsertRows(QModelIndex(), row, row);
+    sessionList.append(s);
+    rowByPath.insert(path, row);
+    endInsertRows();
+  }
+  applyProperties(row);
+}
+
+void SessionModel::slotObjectRemoved(int type, const QString &path)
+{
+  if (type != logindSession)
+    return;
+
+  int row = rowByPath.value(path, -1);
+  if (row == -1)
+    return;
+  removeSessionRow(row);
+  rebuildIndex();
+}
+
+void SessionModel::slotObjectChanged(int type, const QString &path)
+{
+  if (type != logindSession)
+    return;
+
+  int row = rowByPath.value(path, -1);
+  if (row == -1)
+    return;
+  applyProperties(row);
+  if (logind->isLoaded(path))
+    emit propertiesLoaded(sessionList.at(row).session.session_id);
+}
+
+void SessionModel::slotListed(int type)
+{
+  // Drop the sessions from the cache that have ended since the last run
+  if (type != logindSession)
+    return;
+
+  bool removed = false;
+  for (int row = sessionList.size() - 1; row >= 0; --row)
+  {
+    if (!logind->contains(sessionList.at(row).session.session_path.path()))
+    {
+      removeSessionRow(row);
+      removed = true;
+    }
+  }
+  if (removed)
+    rebuildIndex();
+}
+
+void SessionModel::applyProperties(int row)
+{
+  QString path = sessionList.at(row).session.session_path.path();
+  if (!logind->contains(path))
+    return;
+
+  QVariantMap props = logind->properties(path);
+  SystemdSession &session = sessionList[row].session;
+  if (props.contains(QStringLiteral("Id")))
+    session.session_id = props.value(QStringLiteral("Id")).toString();
+  if (props.contains(QStringLiteral("State")))
+    session.session_state = props.value(QStringLiteral("State")).toString();
+  if (props.contains(QStringLiteral("User")))
+    session.user_id = props.value(QStringLiteral("User")).toUInt();
+  if (props.contains(QStringLiteral("Name")))
+    session.user_name = props.value(QStringLiteral("Name")).toString();
+  if (props.contains(QStringLiteral("Seat")))
+    session.seat_id = props.value(QStringLiteral("Seat")).toString();
+  if (logind->isLoaded(path))
+    sessionList[row].stale = false;
+
+  emit dataChanged(index(row, 0), index(row, columnCount() - 1));
+}
+
+QString SessionModel::toolTip(const QString &sessionPath) const
+{
+  QVariantMap p = logind->properties(sessionPath);
+
+  QString toolTipText;
+  toolTipText.append("<FONT COLOR=white>");
+  toolTipText.append("<b>" + p.value(QStringLiteral("Id")).toString() + "</b><hr>");
+  toolTipText.append(i18n("<b>VT:</b> %1", p.value(QStringLiteral("VTNr")).toString()));
+
+  QString remoteHost = p.value(QStringLiteral("RemoteHost")).toString();
+  if (p.value(QStringLiteral("Remote")).toBool())
+  {
+    toolTipText.append(i18n("<br><b>Remote host:</b> %1", remoteHost));
+    toolTipText.append(i18n("<br><b>Remote user:</b> %1", p.value(QStringLiteral("RemoteUser")).toString()));
+  }
+  toolTipText.append(i18n("<br><b>Service:</b> %1", p.value(QStringLiteral("Service")).toString()));
+
+  QString type = p.value(QStringLiteral("Type")).toString();
+  toolTipText.append(i18n("<br><b>Type:</b> %1", type));
+  if (type == "x11")
+    toolTipText.append(i18n(" (display %1)", p.value(QStringLiteral("Display")).toString()));
+  else if (type == "tty")
+  {
+    QString path, tty = p.value(QStringLiteral("TTY")).toString();
+    if (!tty.isEmpty())
+      path = tty;
+    else if (!remoteHost.isEmpty())
+      path = p.value(QStringLiteral("Name")).toString() + '@' + remoteHost;
+    toolTipText.append(" (" + path + ')');
+  }
+  toolTipText.append(i18n("<br><b>Class:</b> %1", p.value(QStringLiteral("Class")).toString()));
+  toolTipText.append(i18n("<br><b>State:</b> %1", p.value(QStringLiteral("State")).toString()));
+  toolTipText.append(i18n("<br><b>Scope:</b> %1", p.value(QStringLiteral("Scope")).toString()));
+
+  toolTipText.append(i18n("<br><b>Created: </b>"));
+  qulonglong created = p.value(QStringLiteral("Timestamp")).toULongLong();
+  if (created == 0)
+    toolTipText.append("n/a");
+  else
+    toolTipText.append(QDateTime::fromMSecsSinceEpoch(created / 1000).toString());
+
+  toolTipText.append("</FONT");
+  return toolTipText;
+}
+
+void SessionModel::removeSessionRow(int row)
+{
+  // Callers rebuild the index afterwards
+  beginRemoveRows(QModelIndex(), row, row);
+  sessionList.removeAt(row);
+  endRemoveRows();
+}
+
+void SessionModel::rebuildIndex()
+{
+  rowByPath.clear();
+  rowByPath.reserve(sessionList.size());
+  for (int row = 0; row < sessionList.size(); ++row)
+    rowByPath.insert(sessionList.at(row).session.session_path.path(), row);
+}
+
+void SessionModel::updateBrushes()
+{
+  const KColorScheme scheme(QPalette::Normal);
+  brushCache.clear();
+  brushCache << scheme.foreground(KColorScheme::NormalText)
+             << scheme.foreground(KColorScheme::PositiveText)
+             << scheme.foreground(KColorScheme::InactiveText);
+}
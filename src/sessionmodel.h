@@ -0,0 +1,85 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef SESSIONMODEL_H
+#define SESSIONMODEL_H
+
+#include <QAbstractTableModel>
+#include <QtDBus/QtDBus>
+#include <KFormat>
+
+#include "systemdunit.h"
+#include "logindcache.h"
+#include "cgroupstat.h"
+
+// Model for the sessions tab, keyed by session object path. Rows follow
+// the sessions in the LogindCache and are updated in place. For
+// Qt::UserRole the usage columns return the raw values, for sorting.
+class SessionModel : public QAbstractTableModel
+{
+  Q_OBJECT
+
+public:
+  explicit SessionModel(QObject *parent = 0, LogindCache *cache = NULL);
+  int rowCount(const QModelIndex & parent = QModelIndex()) const;
+  int columnCount(const QModelIndex & parent = QModelIndex()) const;
+  QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+  QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+  void setCachedRows(const QList<QStringList> &rows);
+  QList<QStringList> cachedRows() const;
+  QString cgroup(int row) const;
+  void setUsage(int row, const CgroupUsage &usage);
+  bool hasProperties(int row) const;
+  void fetchProperties(int row);
+  void paletteChanged();
+
+signals:
+  void propertiesLoaded(const QString &id);
+
+private slots:
+  void slotObjectAdded(int type, const QString &path);
+  void slotObjectRemoved(int type, const QString &path);
+  void slotObjectChanged(int type, const QString &path);
+  void slotListed(int type);
+
+private:
+  // user_id of a session whose properties have not been read yet
+  static const uint noUid = uint(-1);
+
+  struct Session
+  {
+    SystemdSession session;
+    CgroupUsage usage;
+    bool stale = false;
+  };
+
+  void applyProperties(int row);
+  QString toolTip(const QString &sessionPath) const;
+  void removeSessionRow(int row);
+  void rebuildIndex();
+  void updateBrushes();
+
+  LogindCache *logind;
+  QList<Session> sessionList;
+  QHash<QString, int> rowByPath;
+  QVector<QVariant> headerCache, brushCache;
+  QVariant staleFont;
+  KFormat format;
+};
+
+#endif // SESSIONMODEL_H
@@ -16,6 +16,7 @@
  *******************************************************************************/
 
 #include "sortfilterunitmodel.h"
+#include "unitmodel.h"
 
 SortFilterUnitModel::SortFilterUnitModel(QObject *parent)
      : QSortFilterProxyModel(parent)
@@ -40,11 +41,63 @@ void SortFilterUnitModel::addFilterRegExp(filterType type, const QString &patter
 
   filtersMap[type] = pattern;
 
+  if (type == unitName)
+    refreshSearch();
+
   // qDebug() << "filtersMap changed: " << filtersMap;
 }
 
+void SortFilterUnitModel::setSearchIndex(UnitSearchIndex *index)
+{
+  searchIndex = index;
+  refreshSearch();
+}
+
+void SortFilterUnitModel::refreshSearch()
+{
+  // Look up the units matching the search term in the index. This must be
+  // called after the index has been updated, before invalidating the filter.
+  searchResult.clear();
+  if (!searchIndex || filtersMap.value(unitName).isEmpty())
+    return;
+
+  if (fuzzySearch)
+    searchResult = searchIndex->fuzzySearch(filtersMap.value(unitName));
+  else
+  {
+    foreach (const QString &id, searchIndex->search(filtersMap.value(unitName)))
+      searchResult.insert(id, 0);
+  }
+}
+
+void SortFilterUnitModel::setFuzzySearch(bool fuzzy)
+{
+  fuzzySearch = fuzzy;
+  refreshSearch();
+}
+
+void SortFilterUnitModel::setFacetFilter(facetType type, const QSet<QString> &values)
+{
+  facetFilters[type] = values;
+}
+
+QSet<QString> SortFilterUnitModel::facetFilter(facetType type) const
+{
+  return facetFilters[type];
+}
+
 bool SortFilterUnitModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
 {
+  // Values within a facet are alternatives, different facets must all match
+  for (int f = 0; f < facetCount; ++f)
+  {
+    if (facetFilters[f].isEmpty())
+      continue;
+    QModelIndex index0 = sourceModel()->index(sourceRow, 0, sourceParent);
+    if (!facetFilters[f].contains(index0.data(unitFacetRole + f).toString()))
+      return false;
+  }
+
   if(filtersMap.isEmpty())
     return true;
 
@@ -59,6 +112,8 @@ bool SortFilterUnitModel::filterAcceptsRow(int sourceRow, const QModelIndex &sou
       ret = (index1.data().toString().contains(QRegExp(iter.value())));
     else if (iter.key() == unitType)
       ret = (index3.data().toString().contains(QRegExp(iter.value())));
+    else if (iter.key() == unitName && searchIndex)
+      ret = (iter.value().isEmpty() || searchResult.contains(index3.data().toString()));
     else if (iter.key() == unitName)
       ret = (index3.data().toString().contains(QRegExp(iter.value(), Qt::CaseInsensitive)));
 
@@ -69,3 +124,23 @@ bool SortFilterUnitModel::filterAcceptsRow(int sourceRow, const QModelIndex &sou
   return ret;
 }
  
+
+bool SortFilterUnitModel::lessThan(const QModelIndex &left, const QModelIndex &right) const
+{
+  // In fuzzy mode, rank units by score when sorting on the unit column
+  if (fuzzySearch && !searchResult.isEmpty() && left.column() == 3 && right.column() == 3)
+  {
+    QString leftId = left.data().toString();
+    QString rightId = right.data().toString();
+    int leftScore = searchResult.value(leftId);
+    int rightScore = searchResult.value(rightId);
+    if (leftScore != rightScore)
+      return leftScore > rightScore;
+    return leftId < rightId;
+  }
+
+  // The resource columns sort by their raw values
+  if (left.column() >= colCpu && right.column() >= colCpu)
+    return left.data(Qt::UserRole).toDouble() < right.data(Qt::UserRole).toDouble();
+  return QSortFilterProxyModel::lessThan(left, right);
+}
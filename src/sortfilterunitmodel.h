@@ -19,6 +19,11 @@
 #define SORTFILTERUNITMODEL_H
 
 #include <QSortFilterProxyModel>
+#include <QHash>
+#include <QSet>
+
+#include "unitsearchindex.h"
+#include "unitfacets.h"
 
 enum filterType
 {
@@ -33,12 +38,24 @@ public:
   explicit SortFilterUnitModel(QObject *parent = 0);
   void initFilterMap(const QMap<filterType, QString> &map);
   void addFilterRegExp(filterType type, const QString &pattern);
+  void setSearchIndex(UnitSearchIndex *index);
+  void refreshSearch();
+  void setFuzzySearch(bool fuzzy);
+  void setFacetFilter(facetType type, const QSet<QString> &values);
+  QSet<QString> facetFilter(facetType type) const;
 
 protected:
   bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const;
+  bool lessThan(const QModelIndex &left, const QModelIndex &right) const;
 
 private:
   QMap<filterType, QString> filtersMap;
+  UnitSearchIndex *searchIndex = NULL;
+  // Matching unit ids with their score, scores are only used in fuzzy mode
+  QHash<QString, int> searchResult;
+  bool fuzzySearch = false;
+  // Accepted values of each facet, an empty set accepts all values
+  QSet<QString> facetFilters[facetCount];
 };
 
 #endif // SORTFILTERUNITMODEL_H
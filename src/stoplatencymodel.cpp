@@ -0,0 +1,460 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "stoplatencymodel.h"
+#include "bootmodel.h"
+
+#include <QDateTime>
+#include <QSet>
+#include <KColorScheme>
+#include <KLocalizedString>
+
+#include <algorithm>
+#include <systemd/sd-journal.h>
+
+static const QString connSystemd = QStringLiteral("org.freedesktop.systemd1");
+static const QString pathSysdMgr = QStringLiteral("/org/freedesktop/systemd1");
+static const QString ifaceMgr = QStringLiteral("org.freedesktop.systemd1.Manager");
+static const QString ifaceUnit = QStringLiteral("org.freedesktop.systemd1.Unit");
+static const QString ifaceService = QStringLiteral("org.freedesktop.systemd1.Service");
+static const QString ifaceDbusProp = QStringLiteral("org.freedesktop.DBus.Properties");
+
+// Number of calls waiting for a reply at the same time
+static const int maxInFlight = 32;
+
+// TimeoutStopUSec of units without a stop timeout
+static const qulonglong infinity = ~0ULL;
+
+StopJournalScanner::StopJournalScanner(QObject *parent)
+ : QThread(parent)
+{
+}
+
+void StopJournalScanner::setDays(int days)
+{
+  scanDays = days;
+}
+
+QHash<QString, QList<UnitStop> > StopJournalScanner::stops() const
+{
+  return result;
+}
+
+int StopJournalScanner::bootCount() const
+{
+  return boots;
+}
+
+void StopJournalScanner::setScanId(qulonglong id)
+{
+  scanId = id;
+}
+
+void StopJournalScanner::run()
+{
+  // The signal of an earlier run may still be queued when the next one
+  // starts, the id tells the model which run is done
+  scan();
+  emit scanned(scanId);
+}
+
+void StopJournalScanner::scan()
+{
+  // Pairs the manager's "Stopping" messages with the "Stopped" message
+  // for the same unit in the same boot. Messages about timeouts in
+  // between mark the stop as timed out.
+  result.clear();
+  boots = 0;
+
+  sd_journal *journal;
+  if (sd_journal_open(&journal, SD_JOURNAL_LOCAL_ONLY | SD_JOURNAL_SYSTEM) != 0)
+    return;
+
+  sd_id128_t currentBoot;
+  sd_id128_get_boot(&currentBoot);
+  sd_journal_add_match(journal, "_PID=1", 0);
+
+  QHash<QByteArray, UnitStop> pending;
+  QSet<QByteArray> bootIds;
+  quint64 since = quint64(QDateTime::currentMSecsSinceEpoch() - qint64(scanDays) * 86400000) * 1000;
+  if (sd_journal_seek_realtime_usec(journal, since) == 0)
+  {
+    const void *data;
+    size_t length;
+    while (sd_journal_next(journal) > 0)
+    {
+      // This boot is read from the units
+      uint64_t usec;
+      sd_id128_t boot;
+      if (sd_journal_get_monotonic_usec(journal, &usec, &boot) != 0 || sd_id128_equal(boot, currentBoot))
+        continue;
+      if (sd_journal_get_data(journal, "UNIT", &data, &length) != 0)
+        continue;
+      QByteArray unit((const char *)data + 5, int(length) - 5);
+      if (sd_journal_get_data(journal, "MESSAGE", &data, &length) != 0)
+        continue;
+      QByteArray msg((const char *)data + 8, int(length) - 8);
+
+      char bootString[SD_ID128_STRING_MAX];
+      sd_id128_to_string(boot, bootString);
+      QByteArray key = QByteArray(bootString) + unit;
+
+      if (msg.startsWith("Stopping ") || msg.startsWith("Unmounting ") || msg.startsWith("Deactivating swap "))
+      {
+        // The start of the stop is kept in duration until it ends
+        UnitStop stop;
+        stop.duration = usec;
+        pending.insert(key, stop);
+        continue;
+      }
+
+      QHash<QByteArray, UnitStop>::iterator it = pending.find(key);
+      if (it == pending.end())
+        continue;
+      if (msg.contains("timed out") || msg.contains("result 'timeout'"))
+        it->timedOut = true;
+      else if (msg.startsWith("Stopped ") || msg.startsWith("Unmounted ") || msg.startsWith("Deactivated swap "))
+      {
+        UnitStop stop = it.value();
+        stop.duration = usec >= stop.duration ? usec - stop.duration : 0;
+        result[QString::fromUtf8(unit)] << stop;
+        bootIds.insert(bootString);
+        pending.erase(it);
+      }
+    }
+  }
+  boots = bootIds.size();
+  sd_journal_close(journal);
+}
+
+StopLatencyModel::StopLatencyModel(QObject *parent)
+ : QAbstractTableModel(parent)
+{
+  scanner = new StopJournalScanner(this);
+  connect(scanner, SIGNAL(scanned(qulonglong)), this, SLOT(slotScanFinished(qulonglong)));
+}
+
+int StopLatencyModel::rowCount(const QModelIndex &) const
+{
+  return rows.size();
+}
+
+int StopLatencyModel::columnCount(const QModelIndex &) const
+{
+  return 7;
+}
+
+QVariant StopLatencyModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+  if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
+    return QVariant();
+
+  switch (section)
+  {
+    case 0: return i18n("Unit");
+    case 1: return i18n("This Boot");
+    case 2: return i18n("Median");
+    case 3: return i18n("Longest");
+    case 4: return i18n("Stops");
+    case 5: return i18n("Timeouts");
+    case 6: return i18n("Stop Timeout");
+  }
+  return QVariant();
+}
+
+QVariant StopLatencyModel::data(const QModelIndex &index, int role) const
+{
+  if (!index.isValid() || index.row() >= rows.size())
+    return QVariant();
+
+  const UnitStopStats &stats = rows.at(index.row());
+
+  if (role == Qt::DisplayRole)
+  {
+    switch (index.column())
+    {
+      case 0:
+        return stats.id;
+      case 1:
+        return stats.current.duration ? BootModel::formatDuration(stats.current.duration) : QString();
+      case 2:
+        return BootModel::formatDuration(stats.median);
+      case 3:
+        return BootModel::formatDuration(stats.longest);
+      case 4:
+        return stats.stops.size();
+      case 5:
+        return stats.timeouts;
+      case 6:
+        if (stats.timeout == infinity)
+          return i18n("infinity");
+        return stats.timeout ? BootModel::formatDuration(stats.timeout) : QString();
+    }
+  }
+  else if (role == Qt::UserRole)
+  {
+    // Used for sorting
+    switch (index.column())
+    {
+      case 0:
+        return stats.id;
+      case 1:
+        return stats.current.duration;
+      case 2:
+        return stats.median;
+      case 3:
+        return stats.longest;
+      case 4:
+        return stats.stops.size();
+      case 5:
+        return stats.timeouts;
+      case 6:
+        return stats.timeout;
+    }
+  }
+  else if (role == Qt::ForegroundRole && regularlyTimesOut(stats))
+  {
+    const KColorScheme scheme(QPalette::Normal);
+    return scheme.foreground(KColorScheme::NegativeText);
+  }
+  else if (role == Qt::ToolTipRole && regularlyTimesOut(stats))
+  {
+    return i18n("%1 of %2 stops of %3 ran into the stop timeout.", stats.timeouts, stats.stops.size(), stats.id);
+  }
+  return QVariant();
+}
+
+void StopLatencyModel::refresh(const QList<SystemdUnit> &units)
+{
+  // Replies to an earlier refresh are ignored by their generation
+  ++generation;
+  beginResetModel();
+  rows.clear();
+  endResetModel();
+  currentStops.clear();
+  timeouts.clear();
+  queue.clear();
+  defaultTimeout = 0;
+  pending = 0;
+
+  // Stopped units have the timestamps of their last stop, services
+  // also need their stop timeout
+  foreach (const SystemdUnit &unit, units)
+  {
+    if (unit.load_state != QLatin1String("loaded") || unit.unit_path.path().isEmpty())
+      continue;
+    if (unit.active_state == QLatin1String("inactive") || unit.active_state == QLatin1String("failed") ||
+        unit.id.endsWith(QLatin1String(".service")))
+      queue << unit;
+  }
+
+  QDBusMessage msg = QDBusMessage::createMethodCall(connSystemd, pathSysdMgr, ifaceDbusProp, QStringLiteral("Get"));
+  msg << ifaceMgr << QStringLiteral("DefaultTimeoutStopUSec");
+  QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(QDBusConnection::systemBus().asyncCall(msg), this);
+  watcher->setProperty("generation", generation);
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(slotDefaultTimeoutReply(QDBusPendingCallWatcher*)));
+  pending++;
+
+  // A scan that is still running is waited for, its result is as good
+  if (!scanner->isRunning())
+  {
+    scanning = true;
+    scanner->setScanId(++scanId);
+    scanner->start();
+  }
+
+  fetchNext();
+}
+
+bool StopLatencyModel::isLoading() const
+{
+  return pending > 0 || scanning;
+}
+
+QString StopLatencyModel::summary() const
+{
+  if (isLoading())
+    return QString();
+
+  // Suggest a default timeout from the stops that finished in time,
+  // with half of the 95th percentile as headroom
+  QList<qulonglong> durations;
+  int regular = 0;
+  foreach (const UnitStopStats &stats, rows)
+  {
+    if (regularlyTimesOut(stats))
+      ++regular;
+    foreach (const UnitStop &stop, stats.stops)
+    {
+      if (!stop.timedOut)
+        durations << stop.duration;
+    }
+  }
+
+  QString text = i18np("%1 unit has been stopped in the last %2 boots.", "%1 units have been stopped in the last %2 boots.",
+                       rows.size(), scanner->bootCount() + 1);
+  text += ' ' + i18np("%1 of them regularly runs into its stop timeout.", "%1 of them regularly run into their stop timeout.", regular);
+  if (!durations.isEmpty())
+  {
+    std::sort(durations.begin(), durations.end());
+    qulonglong p95 = durations.at(qMax(0, int(durations.size() * 0.95 + 0.5) - 1));
+    qulonglong suggested = qMax(qulonglong(5), (p95 * 3 / 2 + 4999999) / 5000000 * 5) * 1000000;
+    text += ' ' + i18n("95% of the stops that finished in time took at most %1. DefaultTimeoutStopSec is %2, %3 would leave half of that as headroom.",
+                       BootModel::formatDuration(p95), BootModel::formatDuration(defaultTimeout),
+                       BootModel::formatDuration(suggested));
+  }
+  return text;
+}
+
+void StopLatencyModel::fetchNext()
+{
+  QDBusConnection bus = QDBusConnection::systemBus();
+  while (pending < maxInFlight && !queue.isEmpty())
+  {
+    SystemdUnit unit = queue.takeFirst();
+    if (unit.active_state == QLatin1String("inactive") || unit.active_state == QLatin1String("failed"))
+    {
+      QDBusMessage msg = QDBusMessage::createMethodCall(connSystemd, unit.unit_path.path(), ifaceDbusProp, QStringLiteral("GetAll"));
+      msg << ifaceUnit;
+      QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(bus.asyncCall(msg), this);
+      watcher->setProperty("generation", generation);
+      watcher->setProperty("unit", unit.id);
+      connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(slotUnitReply(QDBusPendingCallWatcher*)));
+      pending++;
+    }
+    if (unit.id.endsWith(QLatin1String(".service")))
+    {
+      QDBusMessage msg = QDBusMessage::createMethodCall(connSystemd, unit.unit_path.path(), ifaceDbusProp, QStringLiteral("Get"));
+      msg << ifaceService << QStringLiteral("TimeoutStopUSec");
+      QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(bus.asyncCall(msg), this);
+      watcher->setProperty("generation", generation);
+      watcher->setProperty("unit", unit.id);
+      watcher->setProperty("timeout", true);
+      connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(slotUnitReply(QDBusPendingCallWatcher*)));
+      pending++;
+    }
+  }
+
+  if (pending == 0 && !scanning)
+    finish();
+}
+
+void StopLatencyModel::slotScanFinished(qulonglong id)
+{
+  // The result is only read once the latest scan is done
+  if (id != scanId)
+    return;
+  scanning = false;
+  if (pending == 0)
+    finish();
+}
+
+void StopLatencyModel::slotDefaultTimeoutReply(QDBusPendingCallWatcher *watcher)
+{
+  QDBusPendingReply<QVariant> reply = *watcher;
+  watcher->deleteLater();
+  if (watcher->property("generation").toULongLong() != generation)
+    return;
+
+  if (!reply.isError())
+    defaultTimeout = reply.value().toULongLong();
+  pending--;
+  fetchNext();
+}
+
+void StopLatencyModel::slotUnitReply(QDBusPendingCallWatcher *watcher)
+{
+  watcher->deleteLater();
+  if (watcher->property("generation").toULongLong() != generation)
+    return;
+
+  QString id = watcher->property("unit").toString();
+  if (watcher->property("timeout").toBool())
+  {
+    QDBusPendingReply<QVariant> reply = *watcher;
+    if (!reply.isError())
+      timeouts.insert(id, reply.value().toULongLong());
+  }
+  else
+  {
+    // The unit enters deactivating when it leaves the active state
+    QDBusPendingReply<QVariantMap> reply = *watcher;
+    if (!reply.isError())
+    {
+      qulonglong deactivating = reply.value().value(QStringLiteral("ActiveExitTimestampMonotonic")).toULongLong();
+      qulonglong inactive = reply.value().value(QStringLiteral("InactiveEnterTimestampMonotonic")).toULongLong();
+      if (deactivating && inactive >= deactivating)
+      {
+        UnitStop stop;
+        stop.duration = inactive - deactivating;
+        currentStops.insert(id, stop);
+      }
+    }
+  }
+  pending--;
+  fetchNext();
+}
+
+bool StopLatencyModel::regularlyTimesOut(const UnitStopStats &stats) const
+{
+  return stats.timeouts >= 2 || (stats.timeouts > 0 && stats.timeouts * 2 >= stats.stops.size());
+}
+
+void StopLatencyModel::finish()
+{
+  QHash<QString, UnitStopStats> units;
+  QHash<QString, QList<UnitStop> > journalStops = scanner->stops();
+  for (QHash<QString, QList<UnitStop> >::const_iterator it = journalStops.constBegin(); it != journalStops.constEnd(); ++it)
+    units[it.key()].stops = it.value();
+  for (QHash<QString, UnitStop>::const_iterator it = currentStops.constBegin(); it != currentStops.constEnd(); ++it)
+  {
+    units[it.key()].current = it.value();
+    units[it.key()].stops << it.value();
+  }
+
+  // A stop that lasted as long as the timeout ran into it, even if no
+  // message said so. Units other than services use the default.
+  QList<UnitStopStats> list;
+  for (QHash<QString, UnitStopStats>::iterator it = units.begin(); it != units.end(); ++it)
+  {
+    UnitStopStats &stats = it.value();
+    stats.id = it.key();
+    stats.timeout = timeouts.contains(stats.id) ? timeouts.value(stats.id) : defaultTimeout;
+    QList<qulonglong> durations;
+    for (int i = 0; i < stats.stops.size(); ++i)
+    {
+      UnitStop &stop = stats.stops[i];
+      if (stats.timeout && stats.timeout != infinity && stop.duration + 1000000 >= stats.timeout)
+        stop.timedOut = true;
+      if (stop.timedOut)
+        ++stats.timeouts;
+      durations << stop.duration;
+    }
+    std::sort(durations.begin(), durations.end());
+    stats.median = durations.at(durations.size() / 2);
+    stats.longest = durations.last();
+    list << stats;
+  }
+  std::sort(list.begin(), list.end(),
+            [](const UnitStopStats &a, const UnitStopStats &b) { return a.longest > b.longest; });
+
+  beginResetModel();
+  rows = list;
+  endResetModel();
+  emit finished();
+}
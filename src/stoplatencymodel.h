@@ -0,0 +1,117 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef STOPLATENCYMODEL_H
+#define STOPLATENCYMODEL_H
+
+#include <QAbstractTableModel>
+#include <QThread>
+#include <QtDBus/QtDBus>
+
+#include "systemdunit.h"
+
+// A stop of a unit, from entering deactivation to becoming inactive
+struct UnitStop
+{
+  qulonglong duration = 0;
+  bool timedOut = false;
+};
+
+// The stops of one unit in this boot and in earlier boots
+struct UnitStopStats
+{
+  QString id;
+  QList<UnitStop> stops;
+  UnitStop current;
+  // TimeoutStopUSec of the unit, 0 if unknown
+  qulonglong timeout = 0;
+  int timeouts = 0;
+  qulonglong median = 0, longest = 0;
+};
+
+// Reads the stops of system units in earlier boots from the "Stopping"
+// and "Stopped" messages of the manager in the journal
+class StopJournalScanner : public QThread
+{
+  Q_OBJECT
+
+public:
+  explicit StopJournalScanner(QObject *parent = 0);
+  void setDays(int days);
+  void setScanId(qulonglong id);
+  QHash<QString, QList<UnitStop> > stops() const;
+  int bootCount() const;
+
+signals:
+  void scanned(qulonglong id);
+
+protected:
+  void run() Q_DECL_OVERRIDE;
+
+private:
+  void scan();
+
+  int scanDays = 30;
+  qulonglong scanId = 0;
+  QHash<QString, QList<UnitStop> > result;
+  int boots = 0;
+};
+
+// Model for the shutdown tab, ranking units by how long they take to
+// stop. The current boot is read from the units' timestamps, earlier
+// boots from the journal.
+class StopLatencyModel : public QAbstractTableModel
+{
+  Q_OBJECT
+
+public:
+  explicit StopLatencyModel(QObject *parent = 0);
+  int rowCount(const QModelIndex & parent = QModelIndex()) const;
+  int columnCount(const QModelIndex & parent = QModelIndex()) const;
+  QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+  QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+  void refresh(const QList<SystemdUnit> &units);
+  bool isLoading() const;
+  QString summary() const;
+
+signals:
+  void finished();
+
+private slots:
+  void slotScanFinished(qulonglong id);
+  void slotDefaultTimeoutReply(QDBusPendingCallWatcher *);
+  void slotUnitReply(QDBusPendingCallWatcher *);
+
+private:
+  void fetchNext();
+  void finish();
+  bool regularlyTimesOut(const UnitStopStats &stats) const;
+
+  StopJournalScanner *scanner;
+  QList<UnitStopStats> rows;
+  QHash<QString, UnitStop> currentStops;
+  QHash<QString, qulonglong> timeouts;
+  QList<SystemdUnit> queue;
+  qulonglong defaultTimeout = 0;
+  int pending = 0;
+  bool scanning = false;
+  quint64 generation = 0;
+  qulonglong scanId = 0;
+};
+
+#endif // STOPLATENCYMODEL_H
@@ -19,14 +19,22 @@
 #define SYSTEMDUNIT_H
 
 #include <QString>
+#include <QStringList>
 #include <QDBusObjectPath>
 
+enum dbusBus
+{
+  sys, session, user
+};
+
 // struct for storing units retrieved from systemd via DBus
 struct SystemdUnit
 {
   QString id, description, load_state, active_state, sub_state, following, job_type, unit_file, unit_file_status;
   QDBusObjectPath unit_path, job_path;
   unsigned int job_id;
+  // Set for units read from the cache that systemd has not confirmed yet
+  bool stale = false;
   
   // The == operator must be provided to use contains() and indexOf()
   // on QLists of this struct
@@ -65,9 +73,54 @@ struct SystemdSession
 };
 Q_DECLARE_METATYPE(SystemdSession)
 
-enum dbusBus
+// A run of the unit activated by a timer, in realtime microseconds.
+// scheduled is 0 if the elapse that started the run is not known.
+struct TimerRun
 {
-  sys, session, user
+  qulonglong scheduled = 0, start = 0, exit = 0;
+};
+
+// Ring buffer with the latest runs of a timer, at(0) is the oldest
+struct TimerRunHistory
+{
+  static const int size = 32;
+  TimerRun runs[size];
+  int head = 0, count = 0;
+
+  const TimerRun &at(int i) const
+  {
+    return runs[(head + size - count + i) % size];
+  }
+  TimerRun &latest()
+  {
+    return runs[(head + size - 1) % size];
+  }
+  void append(const TimerRun &run)
+  {
+    runs[head] = run;
+    head = (head + 1) % size;
+    if (count < size)
+      ++count;
+  }
+};
+
+// struct for storing timers and the times they report, all in microseconds
+struct SystemdTimer
+{
+  QString id, unit_to_activate;
+  QDBusObjectPath timer_path, unit_path;
+  dbusBus bus = sys;
+  qulonglong next_elapse_realtime = 0, next_elapse_monotonic = 0, last_trigger = 0, last_run = 0;
+  qulonglong accuracy = 0, randomized_delay = 0;
+  // Calendar specifications, and the intervals of OnUnitActiveSec= and
+  // OnUnitInactiveSec=, used to project the elapses after the next one
+  QStringList calendar;
+  QList<qulonglong> repeat;
+  // The elapse before the current one, to match runs that start after
+  // the timer has moved on
+  qulonglong previous_elapse = 0;
+  TimerRunHistory history;
+  bool stale = false;
 };
 
 #endif // SYSTEMDUNIT_H
@@ -0,0 +1,350 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "timeranalyzer.h"
+#include "timermodel.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QMap>
+#include <QRegExp>
+
+#include <algorithm>
+
+// Elapses projected per timer, enough for a minutely timer over 16 hours
+static const int maxElapses = 1000;
+
+// Largest number of histogram bins, limits the window for small bins
+static const int maxBins = 20000;
+
+TimerAnalyzer::TimerAnalyzer(QObject *parent)
+ : QObject(parent)
+{
+  process = NULL;
+}
+
+void TimerAnalyzer::analyze(const QList<SystemdTimer> &timers, qulonglong horizon, qulonglong binWidth, double threshold)
+{
+  timerList = timers;
+  bin = qMax(binWidth, qulonglong(1000000));
+  window = qMin(horizon, bin * maxBins);
+  minElapses = threshold;
+  specElapses.clear();
+
+  specs.clear();
+  foreach (const SystemdTimer &timer, timerList)
+  {
+    foreach (const QString &spec, timer.calendar)
+    {
+      if (!specs.contains(spec))
+        specs << spec;
+    }
+  }
+
+  if (process)
+  {
+    // Drop a projection that is still running
+    process->disconnect(this);
+    process->kill();
+    process->deleteLater();
+    process = NULL;
+  }
+
+  if (specs.isEmpty())
+  {
+    compute();
+    emit finished();
+    return;
+  }
+
+  // Let systemd expand the calendar specifications, in UTC so the
+  // output does not depend on the local time zone
+  process = new QProcess(this);
+  QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+  env.insert(QStringLiteral("TZ"), QStringLiteral("UTC"));
+  env.insert(QStringLiteral("LC_ALL"), QStringLiteral("C"));
+  process->setProcessEnvironment(env);
+  connect(process, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(slotCalendarFinished()));
+  connect(process, SIGNAL(error(QProcess::ProcessError)), this, SLOT(slotCalendarFinished()));
+  process->start(QStringLiteral("systemd-analyze"), QStringList() << QStringLiteral("calendar")
+                 << QStringLiteral("--iterations=%1").arg(maxElapses) << specs);
+}
+
+bool TimerAnalyzer::isRunning() const
+{
+  return process != NULL;
+}
+
+QList<SystemdTimer> TimerAnalyzer::timers() const
+{
+  return timerList;
+}
+
+QVector<double> TimerAnalyzer::histogram() const
+{
+  return bins;
+}
+
+qulonglong TimerAnalyzer::start() const
+{
+  return windowStart;
+}
+
+qulonglong TimerAnalyzer::binWidth() const
+{
+  return bin;
+}
+
+int TimerAnalyzer::elapseCount() const
+{
+  return elapses;
+}
+
+QList<TimerCluster> TimerAnalyzer::clusters() const
+{
+  return clusterList;
+}
+
+QList<TimerAdvice> TimerAnalyzer::advice() const
+{
+  return adviceList;
+}
+
+QString TimerAnalyzer::formatSpan(qulonglong usec)
+{
+  if (usec == 0)
+    return QStringLiteral("0");
+  if (usec % 3600000000ULL == 0)
+    return QString::number(usec / 3600000000ULL) + "h";
+  if (usec % 60000000ULL == 0)
+    return QString::number(usec / 60000000ULL) + "min";
+  if (usec % 1000000ULL == 0)
+    return QString::number(usec / 1000000ULL) + "s";
+  if (usec % 1000ULL == 0)
+    return QString::number(usec / 1000ULL) + "ms";
+  return QString::number(usec) + "us";
+}
+
+void TimerAnalyzer::slotCalendarFinished()
+{
+  // Errors are also reported while the process runs, wait for the end
+  if (process->state() != QProcess::NotRunning)
+    return;
+
+  // Each specification starts with its original form, followed by the
+  // next elapse and the iterations after it. Specifications that cannot
+  // be parsed only get an error on stderr, so the elapses are credited
+  // by the original form rather than by position.
+  QString output = QString::fromLocal8Bit(process->readAllStandardOutput());
+  if (process->exitCode() != 0 || process->error() == QProcess::FailedToStart)
+    qDebug() << "systemd-analyze calendar failed:" << process->readAllStandardError();
+  process->disconnect(this);
+  process->deleteLater();
+  process = NULL;
+
+  QRegExp rxElapse("(?:Next elapse|Iter\\. #\\d+): \\w+ (\\d{4}-\\d{2}-\\d{2} \\d{2}:\\d{2}:\\d{2}) UTC");
+  static const QString originalForm = QStringLiteral("Original form:");
+  QString spec;
+  foreach (const QString &line, output.split('\n'))
+  {
+    QString trimmed = line.trimmed();
+    if (trimmed.startsWith(originalForm))
+    {
+      spec = trimmed.mid(originalForm.length()).trimmed();
+      if (!specs.contains(spec))
+      {
+        qDebug() << "systemd-analyze calendar reported an unknown specification:" << spec;
+        spec.clear();
+      }
+    }
+    else if (!spec.isEmpty() && rxElapse.indexIn(line) != -1)
+    {
+      QDateTime time = QDateTime::fromString(rxElapse.cap(1), QStringLiteral("yyyy-MM-dd hh:mm:ss"));
+      time.setTimeSpec(Qt::UTC);
+      specElapses[spec] << qulonglong(time.toMSecsSinceEpoch()) * 1000;
+    }
+  }
+
+  compute();
+  emit finished();
+}
+
+QList<qulonglong> TimerAnalyzer::projectElapses(const SystemdTimer &timer) const
+{
+  // Calendar timers use the expanded specifications, which include the
+  // next elapse. Monotonic timers only repeat if they are relative to
+  // the last activation.
+  qulonglong end = windowStart + window;
+  QList<qulonglong> times;
+  if (!timer.calendar.isEmpty())
+  {
+    foreach (const QString &spec, timer.calendar)
+    {
+      foreach (qulonglong t, specElapses.value(spec))
+      {
+        if (t >= end)
+          break;
+        times << t;
+      }
+    }
+  }
+  else
+  {
+    qulonglong next = TimerModel::nextElapse(timer);
+    if (next && next < end)
+    {
+      times << next;
+      foreach (qulonglong interval, timer.repeat)
+      {
+        for (qulonglong t = next + interval; t < end && times.size() < maxElapses; t += interval)
+          times << t;
+      }
+    }
+  }
+
+  std::sort(times.begin(), times.end());
+  times.erase(std::unique(times.begin(), times.end()), times.end());
+  return times.mid(0, maxElapses);
+}
+
+qulonglong TimerAnalyzer::coalesce(qulonglong usec, qulonglong accuracy) const
+{
+  // systemd fires a timer at the latest whole minute, ten seconds, second
+  // or 250 ms that fits in its accuracy window, so timers with overlapping
+  // windows wake up together. The per-boot offset is the same for all
+  // timers and is left out.
+  static const qulonglong granularity[] = { 60000000, 10000000, 1000000, 250000 };
+  for (unsigned i = 0; i < sizeof(granularity) / sizeof(granularity[0]); ++i)
+  {
+    qulonglong g = granularity[i];
+    if (accuracy < g)
+      continue;
+    qulonglong c = (usec + accuracy) / g * g;
+    if (c >= usec)
+      return c;
+  }
+  return usec;
+}
+
+void TimerAnalyzer::compute()
+{
+  qulonglong now = qulonglong(QDateTime::currentMSecsSinceEpoch()) * 1000;
+  windowStart = now - now % bin;
+  int count = qMax(1, int(window / bin));
+  bins = QVector<double>(count, 0);
+  QVector<QHash<int, double> > binTimers(count);
+  QVector<qulonglong> periods(timerList.size(), 0);
+  elapses = 0;
+
+  for (int i = 0; i < timerList.size(); ++i)
+  {
+    const SystemdTimer &timer = timerList.at(i);
+    QList<qulonglong> times = projectElapses(timer);
+    elapses += times.size();
+
+    // The shortest gap between elapses bounds how far a timer can be
+    // delayed without running into its next elapse
+    for (int j = 1; j < times.size(); ++j)
+    {
+      qulonglong gap = times.at(j) - times.at(j - 1);
+      if (!periods.at(i) || gap < periods.at(i))
+        periods[i] = gap;
+    }
+    foreach (qulonglong interval, timer.repeat)
+    {
+      if (!periods.at(i) || interval < periods.at(i))
+        periods[i] = interval;
+    }
+
+    // Spread elapses with a randomized delay evenly over the delay
+    qulonglong delay = timer.randomized_delay;
+    int steps = delay ? qBound(1, int((delay + bin - 1) / bin), 60) : 1;
+    foreach (qulonglong t, times)
+    {
+      for (int j = 0; j < steps; ++j)
+      {
+        qulonglong fire = coalesce(t + delay * (2 * j + 1) / (2 * steps), timer.accuracy);
+        if (fire < windowStart)
+          continue;
+        qulonglong idx = (fire - windowStart) / bin;
+        if (idx >= qulonglong(count))
+          continue;
+        bins[idx] += 1.0 / steps;
+        binTimers[idx][i] += 1.0 / steps;
+      }
+    }
+  }
+
+  // A cluster is a run of bins reaching the threshold, shared by at
+  // least two timers
+  clusterList.clear();
+  QHash<int, double> weights;
+  TimerCluster cluster;
+  for (int idx = 0; idx <= count; ++idx)
+  {
+    bool hot = idx < count && bins.at(idx) >= minElapses && binTimers.at(idx).size() > 1;
+    if (hot)
+    {
+      if (weights.isEmpty())
+      {
+        cluster = TimerCluster();
+        cluster.start = windowStart + idx * bin;
+      }
+      cluster.end = windowStart + (idx + 1) * bin;
+      cluster.peak = qMax(cluster.peak, bins.at(idx));
+      for (QHash<int, double>::const_iterator it = binTimers.at(idx).constBegin(); it != binTimers.at(idx).constEnd(); ++it)
+        weights[it.key()] += it.value();
+    }
+    else if (!weights.isEmpty())
+    {
+      cluster.timers = weights.keys();
+      std::sort(cluster.timers.begin(), cluster.timers.end(),
+                [&weights](int a, int b) { return weights.value(a) > weights.value(b); });
+      clusterList << cluster;
+      weights.clear();
+    }
+  }
+
+  // Spreading n timers over k bins puts n/k elapses in each, so the
+  // delay needs k > n/threshold bins to bring the cluster below it
+  QMap<int, TimerAdvice> advice;
+  foreach (const TimerCluster &c, clusterList)
+  {
+    qulonglong spread = (qulonglong(c.timers.size() / qMax(minElapses, 1.0)) + 1) * bin;
+    foreach (int i, c.timers)
+    {
+      const SystemdTimer &timer = timerList.at(i);
+      TimerAdvice &a = advice[i];
+      a.timer = i;
+      qulonglong target = spread;
+      if (periods.at(i))
+        target = qMin(target, periods.at(i) / 2 / bin * bin);
+      if (target > timer.randomized_delay)
+        a.randomizedDelay = qMax(a.randomizedDelay, target);
+      if (timer.accuracy > bin)
+        a.accuracy = bin;
+    }
+  }
+
+  adviceList.clear();
+  foreach (const TimerAdvice &a, advice)
+  {
+    if (a.randomizedDelay || a.accuracy)
+      adviceList << a;
+  }
+}
@@ -0,0 +1,90 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef TIMERANALYZER_H
+#define TIMERANALYZER_H
+
+#include <QHash>
+#include <QProcess>
+#include <QVector>
+
+#include "systemdunit.h"
+
+// A run of histogram bins where at least the threshold of elapses fall
+struct TimerCluster
+{
+  qulonglong start = 0, end = 0;
+  double peak = 0;
+  // Indexes into the analyzed timer list, most elapses first
+  QList<int> timers;
+};
+
+// Settings that would spread a timer out of the clusters it is part of.
+// Zero means the current value can stay.
+struct TimerAdvice
+{
+  int timer = 0;
+  qulonglong randomizedDelay = 0, accuracy = 0;
+};
+
+// Projects the elapses of timers over a time window and finds where many
+// of them coincide. Calendar specifications are expanded by
+// systemd-analyze, monotonic timers are repeated by their interval.
+class TimerAnalyzer : public QObject
+{
+  Q_OBJECT
+
+public:
+  explicit TimerAnalyzer(QObject *parent = 0);
+  void analyze(const QList<SystemdTimer> &timers, qulonglong horizon, qulonglong binWidth, double threshold);
+  bool isRunning() const;
+  QList<SystemdTimer> timers() const;
+  QVector<double> histogram() const;
+  qulonglong start() const;
+  qulonglong binWidth() const;
+  int elapseCount() const;
+  QList<TimerCluster> clusters() const;
+  QList<TimerAdvice> advice() const;
+
+  // Formats microseconds as a systemd time span, such as 5min
+  static QString formatSpan(qulonglong usec);
+
+signals:
+  void finished();
+
+private slots:
+  void slotCalendarFinished();
+
+private:
+  QList<qulonglong> projectElapses(const SystemdTimer &timer) const;
+  qulonglong coalesce(qulonglong usec, qulonglong accuracy) const;
+  void compute();
+
+  QProcess *process;
+  QList<SystemdTimer> timerList;
+  QStringList specs;
+  QHash<QString, QList<qulonglong> > specElapses;
+  qulonglong windowStart = 0, window = 0, bin = 0;
+  double minElapses = 0;
+  int elapses = 0;
+  QVector<double> bins;
+  QList<TimerCluster> clusterList;
+  QList<TimerAdvice> adviceList;
+};
+
+#endif // TIMERANALYZER_H
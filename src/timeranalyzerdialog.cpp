@@ -0,0 +1,261 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "timeranalyzerdialog.h"
+
+#include <QApplication>
+#include <QClipboard>
+#include <QDateTime>
+#include <QDialogButtonBox>
+#include <QHBoxLayout>
+#include <QHelpEvent>
+#include <QPainter>
+#include <QToolTip>
+#include <QVBoxLayout>
+
+#include <KColorScheme>
+#include <KLocalizedString>
+
+static QString formatTime(qulonglong usec, const QString &format = QStringLiteral("yyyy.MM.dd hh:mm:ss"))
+{
+  return QDateTime::fromMSecsSinceEpoch(usec / 1000).toString(format);
+}
+
+TimerHistogram::TimerHistogram(QWidget *parent)
+ : QWidget(parent)
+{
+  setMinimumHeight(80);
+}
+
+void TimerHistogram::setHistogram(const QVector<double> &newBins, qulonglong newStart, qulonglong newBinWidth, double newThreshold)
+{
+  bins = newBins;
+  start = newStart;
+  binWidth = newBinWidth;
+  threshold = newThreshold;
+  peak = threshold;
+  foreach (double b, bins)
+    peak = qMax(peak, b);
+  update();
+}
+
+QSize TimerHistogram::sizeHint() const
+{
+  return QSize(600, 120);
+}
+
+void TimerHistogram::paintEvent(QPaintEvent *)
+{
+  QPainter painter(this);
+  painter.fillRect(rect(), palette().base());
+  if (bins.isEmpty() || peak <= 0)
+    return;
+
+  const KColorScheme scheme(QPalette::Normal);
+  QColor normal = scheme.foreground(KColorScheme::LinkText).color();
+  QColor hot = scheme.foreground(KColorScheme::NegativeText).color();
+
+  // Bins narrower than a pixel share a column, which shows the largest
+  qreal scale = height() / peak;
+  for (int x = 0; x < width(); ++x)
+  {
+    int first = x * bins.size() / width();
+    int last = qMax(first, (x + 1) * bins.size() / width() - 1);
+    double value = 0;
+    for (int i = first; i <= last && i < bins.size(); ++i)
+      value = qMax(value, bins.at(i));
+    if (value <= 0)
+      continue;
+    int h = qMax(1, int(value * scale));
+    painter.fillRect(x, height() - h, 1, h, value >= threshold ? hot : normal);
+  }
+
+  painter.setPen(QPen(palette().text().color(), 1, Qt::DashLine));
+  int y = height() - int(threshold * scale);
+  painter.drawLine(0, y, width(), y);
+}
+
+bool TimerHistogram::event(QEvent *event)
+{
+  if (event->type() == QEvent::ToolTip && !bins.isEmpty())
+  {
+    QHelpEvent *helpEvent = static_cast<QHelpEvent *>(event);
+    int first = helpEvent->pos().x() * bins.size() / qMax(1, width());
+    int last = qMax(first, (helpEvent->pos().x() + 1) * bins.size() / qMax(1, width()) - 1);
+    first = qBound(0, first, bins.size() - 1);
+    last = qBound(first, last, bins.size() - 1);
+    double value = 0;
+    for (int i = first; i <= last; ++i)
+      value = qMax(value, bins.at(i));
+    QToolTip::showText(helpEvent->globalPos(),
+                       i18n("%1 - %2: %3 elapses",
+                            formatTime(start + first * binWidth),
+                            formatTime(start + (last + 1) * binWidth, QStringLiteral("hh:mm:ss")),
+                            QString::number(value, 'f', 1)),
+                       this);
+    return true;
+  }
+  return QWidget::event(event);
+}
+
+TimerAnalyzerDialog::TimerAnalyzerDialog(QWidget *parent, const QList<SystemdTimer> &timers)
+ : QDialog(parent)
+{
+  setWindowTitle(i18n("Timer Coalescing"));
+  timerList = timers;
+
+  spnHorizon = new QSpinBox(this);
+  spnHorizon->setRange(1, 168);
+  spnHorizon->setValue(24);
+  spnHorizon->setSuffix(i18n(" h"));
+  spnHorizon->setToolTip(i18n("How far ahead to project the elapses"));
+
+  cmbBin = new QComboBox(this);
+  cmbBin->addItem(i18n("10 seconds"), qulonglong(10000000));
+  cmbBin->addItem(i18n("1 minute"), qulonglong(60000000));
+  cmbBin->addItem(i18n("5 minutes"), qulonglong(300000000));
+  cmbBin->addItem(i18n("15 minutes"), qulonglong(900000000));
+  cmbBin->setCurrentIndex(1);
+
+  spnThreshold = new QSpinBox(this);
+  spnThreshold->setRange(2, 1000);
+  spnThreshold->setValue(3);
+  spnThreshold->setToolTip(i18n("Number of elapses in one bin that counts as a cluster"));
+
+  btnAnalyze = new QPushButton(i18n("Analyze"), this);
+  connect(btnAnalyze, SIGNAL(clicked()), this, SLOT(slotAnalyze()));
+
+  QHBoxLayout *hlayout = new QHBoxLayout;
+  hlayout->addWidget(new QLabel(i18n("Window:"), this));
+  hlayout->addWidget(spnHorizon);
+  hlayout->addWidget(new QLabel(i18n("Bin:"), this));
+  hlayout->addWidget(cmbBin);
+  hlayout->addWidget(new QLabel(i18n("Threshold:"), this));
+  hlayout->addWidget(spnThreshold);
+  hlayout->addStretch();
+  hlayout->addWidget(btnAnalyze);
+
+  histogram = new TimerHistogram(this);
+  lblStatus = new QLabel(this);
+
+  tree = new QTreeWidget(this);
+  tree->setHeaderLabels(QStringList() << i18n("Cluster") << i18n("Elapses") << i18n("Current") << i18n("Suggested"));
+  connect(tree, SIGNAL(itemSelectionChanged()), this, SLOT(slotSelectionChanged()));
+
+  QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Close, this);
+  btnCopy = buttonBox->addButton(i18n("Copy Drop-in"), QDialogButtonBox::ActionRole);
+  btnCopy->setToolTip(i18n("Copy a drop-in with the suggested settings for the selected timer"));
+  btnCopy->setEnabled(false);
+  connect(btnCopy, SIGNAL(clicked()), this, SLOT(slotCopyDropIn()));
+  connect(buttonBox, SIGNAL(rejected()), this, SLOT(reject()));
+
+  QVBoxLayout *vlayout = new QVBoxLayout;
+  vlayout->addLayout(hlayout);
+  vlayout->addWidget(histogram);
+  vlayout->addWidget(lblStatus);
+  vlayout->addWidget(tree);
+  vlayout->addWidget(buttonBox);
+  setLayout(vlayout);
+  resize(760, 560);
+
+  analyzer = new TimerAnalyzer(this);
+  connect(analyzer, SIGNAL(finished()), this, SLOT(slotFinished()));
+  slotAnalyze();
+}
+
+void TimerAnalyzerDialog::slotAnalyze()
+{
+  lblStatus->setText(i18n("Projecting elapses..."));
+  btnAnalyze->setEnabled(false);
+  analyzer->analyze(timerList, qulonglong(spnHorizon->value()) * 3600000000ULL,
+                    cmbBin->currentData().toULongLong(), spnThreshold->value());
+}
+
+void TimerAnalyzerDialog::slotFinished()
+{
+  btnAnalyze->setEnabled(true);
+  histogram->setHistogram(analyzer->histogram(), analyzer->start(), analyzer->binWidth(), spnThreshold->value());
+
+  QList<SystemdTimer> timers = analyzer->timers();
+  QHash<int, TimerAdvice> advice;
+  foreach (const TimerAdvice &a, analyzer->advice())
+    advice.insert(a.timer, a);
+
+  tree->clear();
+  QList<TimerCluster> clusters = analyzer->clusters();
+  foreach (const TimerCluster &cluster, clusters)
+  {
+    QTreeWidgetItem *clusterItem = new QTreeWidgetItem(tree);
+    clusterItem->setText(0, i18n("%1 - %2", formatTime(cluster.start), formatTime(cluster.end, QStringLiteral("hh:mm:ss"))));
+    clusterItem->setText(1, i18np("%1 timer, peak %2", "%1 timers, peak %2", cluster.timers.size(),
+                                  QString::number(cluster.peak, 'f', 1)));
+    foreach (int i, cluster.timers)
+    {
+      const SystemdTimer &timer = timers.at(i);
+      QTreeWidgetItem *item = new QTreeWidgetItem(clusterItem);
+      item->setText(0, timer.id);
+      item->setData(0, Qt::UserRole, i);
+      item->setText(2, QStringLiteral("RandomizedDelaySec=%1 AccuracySec=%2")
+                         .arg(TimerAnalyzer::formatSpan(timer.randomized_delay))
+                         .arg(TimerAnalyzer::formatSpan(timer.accuracy)));
+      QStringList suggested;
+      if (advice.value(i).randomizedDelay)
+        suggested << QStringLiteral("RandomizedDelaySec=") + TimerAnalyzer::formatSpan(advice.value(i).randomizedDelay);
+      if (advice.value(i).accuracy)
+        suggested << QStringLiteral("AccuracySec=") + TimerAnalyzer::formatSpan(advice.value(i).accuracy);
+      item->setText(3, suggested.isEmpty() ? i18n("No change") : suggested.join(' '));
+    }
+  }
+  tree->resizeColumnToContents(0);
+  tree->resizeColumnToContents(1);
+  tree->resizeColumnToContents(2);
+
+  lblStatus->setText(i18n("%1 elapses of %2 timers projected, %3 clusters found.",
+                          analyzer->elapseCount(), timers.size(), clusters.size()));
+}
+
+void TimerAnalyzerDialog::slotSelectionChanged()
+{
+  QList<QTreeWidgetItem *> items = tree->selectedItems();
+  btnCopy->setEnabled(!items.isEmpty() && items.first()->parent() &&
+                      items.first()->text(3) != i18n("No change"));
+}
+
+void TimerAnalyzerDialog::slotCopyDropIn()
+{
+  QList<QTreeWidgetItem *> items = tree->selectedItems();
+  if (items.isEmpty() || !items.first()->parent())
+    return;
+
+  int i = items.first()->data(0, Qt::UserRole).toInt();
+  const SystemdTimer timer = analyzer->timers().at(i);
+  TimerAdvice advice;
+  foreach (const TimerAdvice &a, analyzer->advice())
+  {
+    if (a.timer == i)
+      advice = a;
+  }
+
+  QString dir = timer.bus == sys ? QStringLiteral("/etc/systemd/system/") : QStringLiteral("~/.config/systemd/user/");
+  QString text = QStringLiteral("# %1%2.d/spread.conf\n[Timer]\n").arg(dir, timer.id);
+  if (advice.randomizedDelay)
+    text += QStringLiteral("RandomizedDelaySec=%1\n").arg(TimerAnalyzer::formatSpan(advice.randomizedDelay));
+  if (advice.accuracy)
+    text += QStringLiteral("AccuracySec=%1\n").arg(TimerAnalyzer::formatSpan(advice.accuracy));
+  QApplication::clipboard()->setText(text);
+}
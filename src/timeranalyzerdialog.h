@@ -0,0 +1,78 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef TIMERANALYZERDIALOG_H
+#define TIMERANALYZERDIALOG_H
+
+#include <QComboBox>
+#include <QDialog>
+#include <QLabel>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTreeWidget>
+
+#include "timeranalyzer.h"
+
+// Bar chart of projected elapses per bin, bins at or above the
+// threshold are drawn in the negative color
+class TimerHistogram : public QWidget
+{
+  Q_OBJECT
+
+public:
+  explicit TimerHistogram(QWidget *parent = 0);
+  void setHistogram(const QVector<double> &bins, qulonglong start, qulonglong binWidth, double threshold);
+  QSize sizeHint() const Q_DECL_OVERRIDE;
+
+protected:
+  void paintEvent(QPaintEvent *) Q_DECL_OVERRIDE;
+  bool event(QEvent *event) Q_DECL_OVERRIDE;
+
+private:
+  QVector<double> bins;
+  qulonglong start = 0, binWidth = 0;
+  double threshold = 0, peak = 0;
+};
+
+// Shows how the elapses of all timers line up and suggests
+// RandomizedDelaySec= and AccuracySec= values that spread clusters
+class TimerAnalyzerDialog : public QDialog
+{
+  Q_OBJECT
+
+public:
+  TimerAnalyzerDialog(QWidget *parent, const QList<SystemdTimer> &timers);
+
+private slots:
+  void slotAnalyze();
+  void slotFinished();
+  void slotSelectionChanged();
+  void slotCopyDropIn();
+
+private:
+  QList<SystemdTimer> timerList;
+  TimerAnalyzer *analyzer;
+  TimerHistogram *histogram;
+  QSpinBox *spnHorizon, *spnThreshold;
+  QComboBox *cmbBin;
+  QTreeWidget *tree;
+  QLabel *lblStatus;
+  QPushButton *btnAnalyze, *btnCopy;
+};
+
+#endif // TIMERANALYZERDIALOG_H
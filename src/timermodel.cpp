@@ -0,0 +1,696 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+#include "timermodel.h"
+
+#include <QDateTime>
+#include <QFont>
+#include <QIcon>
+#include <KColorScheme>
+#include <KLocalizedString>
+
+#include <algorithm>
+#include <cmath>
+#include <time.h>
+
+static const QString connSystemd = QStringLiteral("org.freedesktop.systemd1");
+static const QString ifaceUnit = QStringLiteral("org.freedesktop.systemd1.Unit");
+static const QString ifaceTimer = QStringLiteral("org.freedesktop.systemd1.Timer");
+static const QString ifaceService = QStringLiteral("org.freedesktop.systemd1.Service");
+static const QString ifaceDbusProp = QStringLiteral("org.freedesktop.DBus.Properties");
+
+static QString formatSpan(qlonglong secs)
+{
+  if (secs >= 31536000)
+    return QString::number(secs / 31536000) + " years";
+  else if (secs >= 604800)
+    return QString::number(secs / 604800) + " weeks";
+  else if (secs >= 86400)
+    return QString::number(secs / 86400) + " days";
+  else if (secs >= 3600)
+    return QString::number(secs / 3600) + " hr";
+  else if (secs >= 60)
+    return QString::number(secs / 60) + " min";
+  else if (secs < 0)
+    return "0 s";
+  return QString::number(secs) + " s";
+}
+
+static QString formatTime(qulonglong usec)
+{
+  return QDateTime::fromMSecsSinceEpoch(usec / 1000).toString("yyyy.MM.dd hh:mm:ss");
+}
+
+static QString formatDuration(qulonglong usec)
+{
+  if (usec < 1000000)
+    return QString::number(usec / 1000) + " ms";
+  else if (usec < 60000000)
+    return QString::number(usec / 1000000.0, 'f', 1) + " s";
+  else if (usec < 3600000000ULL)
+    return QString::number(usec / 60000000.0, 'f', 1) + " min";
+  return QString::number(usec / 3600000000.0, 'f', 1) + " hr";
+}
+
+static qulonglong percentile(QVector<qulonglong> values, double p)
+{
+  // Nearest rank, values must not be empty
+  std::sort(values.begin(), values.end());
+  int rank = qBound(0, int(std::ceil(p * values.size())) - 1, values.size() - 1);
+  return values.at(rank);
+}
+
+TimerModel::RunStats TimerModel::runStats(const TimerRunHistory &history)
+{
+  RunStats stats;
+  QVector<qulonglong> durations, jitters, gaps;
+  for (int i = 0; i < history.count; ++i)
+  {
+    const TimerRun &run = history.at(i);
+    if (run.exit && run.exit >= run.start)
+      durations << run.exit - run.start;
+    if (run.scheduled && run.start >= run.scheduled)
+      jitters << run.start - run.scheduled;
+    if (i > 0 && run.start > history.at(i - 1).start)
+      gaps << run.start - history.at(i - 1).start;
+  }
+
+  stats.runs = durations.size();
+  if (!durations.isEmpty())
+  {
+    stats.durationP50 = percentile(durations, 0.5);
+    stats.durationP95 = percentile(durations, 0.95);
+  }
+  stats.jitters = jitters.size();
+  if (!jitters.isEmpty())
+  {
+    stats.jitterP50 = percentile(jitters, 0.5);
+    stats.jitterP95 = percentile(jitters, 0.95);
+  }
+  if (!gaps.isEmpty())
+    stats.interval = percentile(gaps, 0.5);
+
+  // Compare the median duration of the newer half of the runs with
+  // that of the older half
+  if (durations.size() >= 4)
+  {
+    int half = durations.size() / 2;
+    qulonglong older = percentile(durations.mid(0, half), 0.5);
+    qulonglong newer = percentile(durations.mid(durations.size() - half), 0.5);
+    if (older)
+    {
+      stats.trend = (double(newer) - double(older)) / older;
+      stats.hasTrend = true;
+    }
+  }
+  return stats;
+}
+
+static qulonglong nowUsec(clockid_t clock)
+{
+  struct timespec ts;
+  if (clock_gettime(clock, &ts) != 0)
+    return 0;
+  return qulonglong(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+static QStringList calendarSpecs(const QVariant &value)
+{
+  // TimersCalendar is a(sst): base, specification, next elapse
+  QStringList specs;
+  const QDBusArgument arg = value.value<QDBusArgument>();
+  if (arg.currentType() != QDBusArgument::ArrayType)
+    return specs;
+  arg.beginArray();
+  while (!arg.atEnd())
+  {
+    QString base, spec;
+    qulonglong next;
+    arg.beginStructure();
+    arg >> base >> spec >> next;
+    arg.endStructure();
+    specs << spec;
+  }
+  arg.endArray();
+  return specs;
+}
+
+static QList<qulonglong> repeatIntervals(const QVariant &value)
+{
+  // TimersMonotonic is a(stt): base, interval, next elapse. Only the
+  // bases relative to the last activation repeat.
+  QList<qulonglong> intervals;
+  const QDBusArgument arg = value.value<QDBusArgument>();
+  if (arg.currentType() != QDBusArgument::ArrayType)
+    return intervals;
+  arg.beginArray();
+  while (!arg.atEnd())
+  {
+    QString base;
+    qulonglong interval, next;
+    arg.beginStructure();
+    arg >> base >> interval >> next;
+    arg.endStructure();
+    if ((base == QLatin1String("OnUnitActiveUSec") || base == QLatin1String("OnUnitInactiveUSec")) && interval > 0)
+      intervals << interval;
+  }
+  arg.endArray();
+  return intervals;
+}
+
+TimerModel::TimerModel(QObject *parent, QString userBusPath)
+ : QAbstractTableModel(parent)
+{
+  userBus = userBusPath;
+
+  QDBusConnection::systemBus().connect(connSystemd, "", ifaceDbusProp, QStringLiteral("PropertiesChanged"), this,
+                                       SLOT(slotSystemPropertiesChanged(QString,QVariantMap,QStringList,QDBusMessage)));
+  if (!userBus.isEmpty())
+    connection(user).connect(connSystemd, "", ifaceDbusProp, QStringLiteral("PropertiesChanged"), this,
+                             SLOT(slotUserPropertiesChanged(QString,QVariantMap,QStringList,QDBusMessage)));
+}
+
+int TimerModel::rowCount(const QModelIndex &) const
+{
+  return timerList.size();
+}
+
+int TimerModel::columnCount(const QModelIndex &) const
+{
+  return 9;
+}
+
+QVariant TimerModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+  if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
+    return QVariant();
+
+  switch (section)
+  {
+    case 0: return i18n("Timer");
+    case 1: return i18n("Next");
+    case 2: return i18n("Left");
+    case 3: return i18n("Last");
+    case 4: return i18n("Passed");
+    case 5: return i18n("Activates");
+    case 6: return i18n("Duration (p50/p95)");
+    case 7: return i18n("Jitter (p50/p95)");
+    case 8: return i18n("Trend");
+  }
+  return QVariant();
+}
+
+QVariant TimerModel::data(const QModelIndex &index, int role) const
+{
+  if (!index.isValid() || index.row() >= timerList.size())
+    return QVariant();
+
+  const SystemdTimer &timer = timerList.at(index.row());
+
+  if (role == Qt::DisplayRole)
+  {
+    switch (index.column())
+    {
+      case 0:
+        return timer.id;
+      case 1:
+      {
+        qulonglong next = nextElapse(timer);
+        return next ? formatTime(next) : QString();
+      }
+      case 2:
+      {
+        qulonglong next = nextElapse(timer);
+        if (!next)
+          return QString();
+        return formatSpan((qlonglong(next) - qlonglong(nowUsec(CLOCK_REALTIME))) / 1000000);
+      }
+      case 3:
+      {
+        qulonglong last = lastRun(timer);
+        return last ? formatTime(last) : QStringLiteral("n/a");
+      }
+      case 4:
+      {
+        qulonglong last = lastRun(timer);
+        if (!last)
+          return QStringLiteral("n/a");
+        return formatSpan((qlonglong(nowUsec(CLOCK_REALTIME)) - qlonglong(last)) / 1000000);
+      }
+      case 5:
+        return timer.unit_to_activate;
+      case 6:
+      case 7:
+      case 8:
+        return runData(index.row(), index.column(), role);
+    }
+  }
+  else if (role == timerSortRole)
+  {
+    // Sort the time columns by the timestamps rather than the text
+    switch (index.column())
+    {
+      case 1:
+      case 2:
+        return nextElapse(timer);
+      case 3:
+        return lastRun(timer);
+      case 4:
+        return ~lastRun(timer);
+      case 6:
+      case 7:
+      case 8:
+        return runData(index.row(), index.column(), role);
+    }
+    return data(index, Qt::DisplayRole);
+  }
+  else if ((role == Qt::ToolTipRole || role == Qt::ForegroundRole) && index.column() >= 6)
+  {
+    return runData(index.row(), index.column(), role);
+  }
+  else if (role == Qt::UserRole && index.column() == 0)
+  {
+    return timer.bus;
+  }
+  else if (role == Qt::DecorationRole && index.column() == 0)
+  {
+    return timer.bus == sys ? QIcon::fromTheme("applications-system") : QIcon::fromTheme("user-identity");
+  }
+  else if (role == Qt::FontRole && timer.stale)
+  {
+    QFont font;
+    font.setItalic(true);
+    return font;
+  }
+
+  return QVariant();
+}
+
+void TimerModel::syncTimers(const QList<SystemdUnit> &units, dbusBus bus)
+{
+  // Inserts rows for new timers and removes rows for timers that are gone.
+  // Rows that already exist are kept current by PropertiesChanged.
+
+  QHash<QString, QDBusObjectPath> &paths = unitPaths[bus];
+  paths.clear();
+  QSet<QString> live;
+  foreach (const SystemdUnit &unit, units)
+  {
+    if (!unit.unit_path.path().isEmpty())
+      paths.insert(unit.id, unit.unit_path);
+    if (unit.id.endsWith(QLatin1String(".timer")) &&
+        unit.load_state != QLatin1String("unloaded") &&
+        !unit.unit_path.path().isEmpty())
+      live.insert(unit.unit_path.path());
+  }
+
+  for (int row = timerList.size() - 1; row >= 0; --row)
+  {
+    if (timerList.at(row).bus == bus && !live.contains(timerList.at(row).timer_path.path()))
+    {
+      beginRemoveRows(QModelIndex(), row, row);
+      timerList.removeAt(row);
+      statsList.remove(row);
+      endRemoveRows();
+    }
+  }
+  rebuildIndex();
+
+  QList<int> fetch;
+  bool reindex = false;
+  foreach (const SystemdUnit &unit, units)
+  {
+    if (!live.contains(unit.unit_path.path()))
+      continue;
+
+    int row = rowByTimer.value(QString::number(bus) + unit.unit_path.path(), -1);
+    if (row == -1)
+    {
+      SystemdTimer timer;
+      timer.id = unit.id;
+      timer.timer_path = unit.unit_path;
+      timer.bus = bus;
+      row = timerList.size();
+      beginInsertRows(QModelIndex(), row, row);
+      timerList.append(timer);
+      statsList.append(RunStats());
+      endInsertRows();
+      rowByTimer.insert(QString::number(bus) + unit.unit_path.path(), row);
+      fetch << row;
+    }
+    else if (timerList.at(row).stale)
+    {
+      // Row from the cache, load the current values
+      fetch << row;
+    }
+    else
+    {
+      // The activated unit may have been loaded since the last sync
+      QDBusObjectPath path = paths.value(timerList.at(row).unit_to_activate);
+      if (path != timerList.at(row).unit_path)
+      {
+        timerList[row].unit_path = path;
+        reindex = true;
+        fetchLastRun(row);
+      }
+    }
+  }
+
+  if (reindex)
+    rebuildIndex();
+  foreach (int row, fetch)
+    fetchTimer(row);
+}
+
+void TimerModel::setTimers(const QList<SystemdTimer> &timers)
+{
+  beginResetModel();
+  timerList = timers;
+  statsList.clear();
+  statsList.reserve(timerList.size());
+  foreach (const SystemdTimer &timer, timerList)
+    statsList.append(runStats(timer.history));
+  rebuildIndex();
+  endResetModel();
+}
+
+QList<SystemdTimer> TimerModel::timers() const
+{
+  return timerList;
+}
+
+void TimerModel::tick(const QList<int> &rows)
+{
+  // The countdown columns are computed in data(), so only the views need
+  // to be told. Callers pass the rows that are on screen.
+  foreach (int row, rows)
+  {
+    if (row >= 0 && row < timerList.size())
+      emit dataChanged(index(row, 2), index(row, 4));
+  }
+}
+
+void TimerModel::slotSystemPropertiesChanged(QString iface, QVariantMap changed, QStringList invalidated, QDBusMessage msg)
+{
+  propertiesChanged(sys, iface, changed, invalidated, msg.path());
+}
+
+void TimerModel::slotUserPropertiesChanged(QString iface, QVariantMap changed, QStringList invalidated, QDBusMessage msg)
+{
+  propertiesChanged(user, iface, changed, invalidated, msg.path());
+}
+
+void TimerModel::propertiesChanged(dbusBus bus, const QString &iface, const QVariantMap &changed,
+                                   const QStringList &invalidated, const QString &path)
+{
+  QString key = QString::number(bus) + path;
+
+  if (iface == ifaceTimer)
+  {
+    int row = rowByTimer.value(key, -1);
+    if (row != -1)
+      fetchTimer(row);
+  }
+  else if (iface == ifaceUnit && rowsByUnit.contains(key))
+  {
+    // The activated unit has started or stopped
+    QVariant exit = changed.value(QStringLiteral("InactiveExitTimestamp"));
+    foreach (int row, rowsByUnit.values(key))
+    {
+      if (exit.isValid())
+      {
+        timerList[row].last_run = exit.toULongLong();
+        emit dataChanged(index(row, 3), index(row, 4));
+      }
+      else if (invalidated.contains(QStringLiteral("InactiveExitTimestamp")))
+        fetchLastRun(row);
+    }
+  }
+  else if (iface == ifaceService && rowsByUnit.contains(key))
+  {
+    // A run of the activated service started or ended. The exit
+    // timestamp is reset to 0 when a new run starts.
+    qulonglong start = changed.value(QStringLiteral("ExecMainStartTimestamp")).toULongLong();
+    qulonglong exit = changed.value(QStringLiteral("ExecMainExitTimestamp")).toULongLong();
+    if (start || exit)
+    {
+      foreach (int row, rowsByUnit.values(key))
+        recordRun(row, start, exit, true);
+    }
+  }
+}
+
+void TimerModel::fetchTimer(int row)
+{
+  const SystemdTimer &timer = timerList.at(row);
+  QDBusMessage msg = QDBusMessage::createMethodCall(connSystemd, timer.timer_path.path(),
+                                                    ifaceDbusProp, QStringLiteral("GetAll"));
+  msg << ifaceTimer;
+  QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(connection(timer.bus).asyncCall(msg), this);
+  watcher->setProperty("key", QString::number(timer.bus) + timer.timer_path.path());
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+          this, SLOT(slotTimerPropertiesReply(QDBusPendingCallWatcher*)));
+}
+
+void TimerModel::fetchLastRun(int row)
+{
+  const SystemdTimer &timer = timerList.at(row);
+  if (timer.unit_path.path().isEmpty())
+    return;
+
+  QDBusMessage msg = QDBusMessage::createMethodCall(connSystemd, timer.unit_path.path(),
+                                                    ifaceDbusProp, QStringLiteral("Get"));
+  msg << ifaceUnit << QStringLiteral("InactiveExitTimestamp");
+  QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(connection(timer.bus).asyncCall(msg), this);
+  watcher->setProperty("key", QString::number(timer.bus) + timer.timer_path.path());
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+          this, SLOT(slotLastRunReply(QDBusPendingCallWatcher*)));
+
+  // Record the last run of the service, it may have happened while the
+  // module was not running
+  if (!timer.unit_to_activate.endsWith(QLatin1String(".service")))
+    return;
+  msg = QDBusMessage::createMethodCall(connSystemd, timer.unit_path.path(),
+                                       ifaceDbusProp, QStringLiteral("GetAll"));
+  msg << ifaceService;
+  watcher = new QDBusPendingCallWatcher(connection(timer.bus).asyncCall(msg), this);
+  watcher->setProperty("key", QString::number(timer.bus) + timer.timer_path.path());
+  watcher->setProperty("unit", timer.unit_to_activate);
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+          this, SLOT(slotLastExecReply(QDBusPendingCallWatcher*)));
+}
+
+void TimerModel::slotTimerPropertiesReply(QDBusPendingCallWatcher *watcher)
+{
+  QDBusPendingReply<QVariantMap> reply = *watcher;
+  watcher->deleteLater();
+
+  // The timer may have been removed while the call was pending
+  int row = rowByTimer.value(watcher->property("key").toString(), -1);
+  if (row == -1)
+    return;
+  if (reply.isError())
+  {
+    qDebug() << "Failed to get timer properties:" << reply.error().message();
+    return;
+  }
+
+  QVariantMap props = reply.value();
+  SystemdTimer &timer = timerList[row];
+  qulonglong previous = nextElapse(timer);
+  qulonglong realtime = props.value(QStringLiteral("NextElapseUSecRealtime")).toULongLong();
+  qulonglong monotonic = props.value(QStringLiteral("NextElapseUSecMonotonic")).toULongLong();
+  if (previous && (realtime != timer.next_elapse_realtime || monotonic != timer.next_elapse_monotonic))
+    timer.previous_elapse = previous;
+  timer.next_elapse_realtime = props.value(QStringLiteral("NextElapseUSecRealtime")).toULongLong();
+  timer.next_elapse_monotonic = props.value(QStringLiteral("NextElapseUSecMonotonic")).toULongLong();
+  timer.last_trigger = props.value(QStringLiteral("LastTriggerUSec")).toULongLong();
+  timer.accuracy = props.value(QStringLiteral("AccuracyUSec")).toULongLong();
+  timer.randomized_delay = props.value(QStringLiteral("RandomizedDelayUSec")).toULongLong();
+  timer.calendar = calendarSpecs(props.value(QStringLiteral("TimersCalendar")));
+  timer.repeat = repeatIntervals(props.value(QStringLiteral("TimersMonotonic")));
+  bool wasStale = timer.stale;
+  timer.stale = false;
+
+  QString unit = props.value(QStringLiteral("Unit")).toString();
+  QDBusObjectPath path = unitPaths[timer.bus].value(unit);
+  if (unit != timer.unit_to_activate || path != timer.unit_path)
+  {
+    timer.unit_to_activate = unit;
+    timer.unit_path = path;
+    timer.last_run = 0;
+    rebuildIndex();
+    fetchLastRun(row);
+  }
+  else if (wasStale)
+    fetchLastRun(row);
+
+  emit dataChanged(index(row, 0), index(row, 8));
+}
+
+void TimerModel::slotLastRunReply(QDBusPendingCallWatcher *watcher)
+{
+  QDBusPendingReply<QVariant> reply = *watcher;
+  watcher->deleteLater();
+
+  int row = rowByTimer.value(watcher->property("key").toString(), -1);
+  if (row == -1 || reply.isError())
+    return;
+
+  timerList[row].last_run = reply.value().toULongLong();
+  emit dataChanged(index(row, 3), index(row, 4));
+}
+
+void TimerModel::slotLastExecReply(QDBusPendingCallWatcher *watcher)
+{
+  QDBusPendingReply<QVariantMap> reply = *watcher;
+  watcher->deleteLater();
+
+  int row = rowByTimer.value(watcher->property("key").toString(), -1);
+  if (row == -1 || reply.isError() ||
+      timerList.at(row).unit_to_activate != watcher->property("unit").toString())
+    return;
+
+  // The elapse that started this run is not known
+  QVariantMap props = reply.value();
+  recordRun(row, props.value(QStringLiteral("ExecMainStartTimestamp")).toULongLong(),
+            props.value(QStringLiteral("ExecMainExitTimestamp")).toULongLong(), false);
+}
+
+void TimerModel::recordRun(int row, qulonglong start, qulonglong exit, bool live)
+{
+  TimerRunHistory &history = timerList[row].history;
+  if (start && (history.count == 0 || start > history.latest().start))
+  {
+    TimerRun run;
+    run.start = start;
+    if (live)
+      run.scheduled = scheduledElapse(timerList.at(row), start);
+    history.append(run);
+  }
+  if (exit && history.count > 0 && !history.latest().exit && exit >= history.latest().start)
+    history.latest().exit = exit;
+
+  // The statistics are only computed here, not for every cell painted
+  // or compared while sorting
+  statsList[row] = runStats(history);
+  emit dataChanged(index(row, 6), index(row, 8));
+}
+
+QVariant TimerModel::runData(int row, int column, int role) const
+{
+  const SystemdTimer &timer = timerList.at(row);
+  const RunStats &stats = statsList.at(row);
+
+  if (role == Qt::DisplayRole)
+  {
+    if (column == 6 && stats.runs)
+      return QStringLiteral("%1 / %2").arg(formatDuration(stats.durationP50), formatDuration(stats.durationP95));
+    else if (column == 7 && stats.jitters)
+      return QStringLiteral("%1 / %2").arg(formatDuration(stats.jitterP50), formatDuration(stats.jitterP95));
+    else if (column == 8 && stats.hasTrend)
+      return QStringLiteral("%1%2%").arg(stats.trend >= 0 ? QStringLiteral("+") : QString()).arg(qRound(stats.trend * 100));
+    return QString();
+  }
+  else if (role == timerSortRole)
+  {
+    if (column == 6)
+      return stats.durationP95;
+    else if (column == 7)
+      return stats.jitterP95;
+    return stats.hasTrend ? stats.trend : 0.0;
+  }
+  else if (role == Qt::ForegroundRole && column == 6 && stats.interval && stats.durationP95 * 5 > stats.interval * 4)
+  {
+    // The slowest runs use more than 80% of the time between runs
+    const KColorScheme scheme(QPalette::Normal);
+    return scheme.foreground(KColorScheme::NegativeText);
+  }
+  else if (role == Qt::ToolTipRole && timer.history.count > 0)
+  {
+    QString toolTip = i18n("<b>Latest runs of %1</b>", timer.unit_to_activate);
+    toolTip.append(QStringLiteral("<table>"));
+    for (int i = timer.history.count - 1; i >= qMax(0, timer.history.count - 8); --i)
+    {
+      const TimerRun &run = timer.history.at(i);
+      toolTip.append(QStringLiteral("<tr><td>%1</td><td>%2</td><td>%3</td></tr>")
+                     .arg(formatTime(run.start))
+                     .arg(run.exit ? formatDuration(run.exit - run.start) : i18n("running"))
+                     .arg(run.scheduled ? i18n("+%1", formatDuration(run.start - run.scheduled)) : QString()));
+    }
+    toolTip.append(QStringLiteral("</table>"));
+    if (stats.runs && stats.interval)
+      toolTip.append(i18n("The p95 duration uses %1% of the %2 between runs.",
+                          qRound(100.0 * stats.durationP95 / stats.interval), formatDuration(stats.interval)));
+    return toolTip;
+  }
+  return QVariant();
+}
+
+void TimerModel::rebuildIndex()
+{
+  rowByTimer.clear();
+  rowsByUnit.clear();
+  for (int row = 0; row < timerList.size(); ++row)
+  {
+    const SystemdTimer &timer = timerList.at(row);
+    rowByTimer.insert(QString::number(timer.bus) + timer.timer_path.path(), row);
+    if (!timer.unit_path.path().isEmpty())
+      rowsByUnit.insert(QString::number(timer.bus) + timer.unit_path.path(), row);
+  }
+}
+
+qulonglong TimerModel::nextElapse(const SystemdTimer &timer)
+{
+  // Returns the next elapse in realtime microseconds
+  if (timer.next_elapse_monotonic == 0)
+    return timer.next_elapse_realtime;
+
+  qlonglong offset = qlonglong(timer.next_elapse_monotonic) - qlonglong(nowUsec(CLOCK_MONOTONIC));
+  return qlonglong(nowUsec(CLOCK_REALTIME)) + offset;
+}
+
+qulonglong TimerModel::lastRun(const SystemdTimer &timer) const
+{
+  // Fall back to LastTrigger if the unit has not run in this boot,
+  // it is only set for persistent timers
+  return timer.last_run ? timer.last_run : timer.last_trigger;
+}
+
+qulonglong TimerModel::scheduledElapse(const SystemdTimer &timer, qulonglong start) const
+{
+  // The run belongs to the latest elapse before it started, which is
+  // either still the next elapse or already the previous one. Runs long
+  // after that elapse were started by hand or caught up after boot.
+  qulonglong scheduled = 0;
+  qulonglong candidates[] = { timer.previous_elapse, nextElapse(timer) };
+  for (int i = 0; i < 2; ++i)
+  {
+    if (candidates[i] && candidates[i] <= start && candidates[i] > scheduled)
+      scheduled = candidates[i];
+  }
+  if (scheduled && start - scheduled > timer.accuracy + 900000000ULL)
+    return 0;
+  return scheduled;
+}
+
+QDBusConnection TimerModel::connection(dbusBus bus) const
+{
+  if (bus == user)
+    return QDBusConnection::connectToBus(userBus, connSystemd);
+  return QDBusConnection::systemBus();
+}
@@ -0,0 +1,86 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+#ifndef TIMERMODEL_H
+#define TIMERMODEL_H
+
+#include <QAbstractTableModel>
+#include <QtDBus/QtDBus>
+
+#include "systemdunit.h"
+
+// data() returns a value suitable for sorting for this role
+const int timerSortRole = Qt::UserRole + 1;
+
+// Model for the timers tab. Timer properties are fetched with one GetAll
+// when a timer is added and whenever systemd reports that it changed.
+// The runs of activated services are recorded from their ExecMain
+// timestamps to show duration and jitter statistics.
+class TimerModel : public QAbstractTableModel
+{
+  Q_OBJECT
+
+public:
+  explicit TimerModel(QObject *parent = 0, QString userBusPath = "");
+  int rowCount(const QModelIndex & parent = QModelIndex()) const;
+  int columnCount(const QModelIndex & parent = QModelIndex()) const;
+  QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+  QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+  void syncTimers(const QList<SystemdUnit> &units, dbusBus bus);
+  void setTimers(const QList<SystemdTimer> &timers);
+  QList<SystemdTimer> timers() const;
+  void tick(const QList<int> &rows);
+  static qulonglong nextElapse(const SystemdTimer &timer);
+
+private slots:
+  void slotSystemPropertiesChanged(QString, QVariantMap, QStringList, QDBusMessage);
+  void slotUserPropertiesChanged(QString, QVariantMap, QStringList, QDBusMessage);
+  void slotTimerPropertiesReply(QDBusPendingCallWatcher *);
+  void slotLastRunReply(QDBusPendingCallWatcher *);
+  void slotLastExecReply(QDBusPendingCallWatcher *);
+
+private:
+  // Statistics over the recorded runs of a timer
+  struct RunStats
+  {
+    int runs = 0, jitters = 0;
+    qulonglong durationP50 = 0, durationP95 = 0, jitterP50 = 0, jitterP95 = 0, interval = 0;
+    double trend = 0;
+    bool hasTrend = false;
+  };
+
+  void propertiesChanged(dbusBus bus, const QString &iface, const QVariantMap &changed,
+                         const QStringList &invalidated, const QString &path);
+  void fetchTimer(int row);
+  void fetchLastRun(int row);
+  void recordRun(int row, qulonglong start, qulonglong exit, bool live);
+  static RunStats runStats(const TimerRunHistory &history);
+  QVariant runData(int row, int column, int role) const;
+  void rebuildIndex();
+  qulonglong lastRun(const SystemdTimer &timer) const;
+  qulonglong scheduledElapse(const SystemdTimer &timer, qulonglong start) const;
+  QDBusConnection connection(dbusBus bus) const;
+
+  QList<SystemdTimer> timerList;
+  QVector<RunStats> statsList;
+  QHash<QString, int> rowByTimer;
+  QMultiHash<QString, int> rowsByUnit;
+  QHash<QString, QDBusObjectPath> unitPaths[3];
+  QString userBus;
+};
+
+#endif // TIMERMODEL_H
@@ -0,0 +1,176 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "transientunitdialog.h"
+
+#include <QDateTime>
+#include <QDialogButtonBox>
+#include <QRegExp>
+#include <QStandardPaths>
+#include <QThread>
+#include <QVBoxLayout>
+
+#include <KLocalizedString>
+#include <KShell>
+
+#include <limits.h>
+
+TransientUnitDialog::TransientUnitDialog(QWidget *parent, bool allowUserManager)
+ : QDialog(parent)
+{
+  setWindowTitle(i18n("Run Transient Unit"));
+  QFormLayout *form = new QFormLayout;
+
+  cmbManager = new QComboBox(this);
+  cmbManager->addItem(i18n("System manager"));
+  if (allowUserManager)
+    cmbManager->addItem(i18n("User manager"));
+  form->addRow(i18n("Run on:"), cmbManager);
+
+  leCommand = new QLineEdit(this);
+  leCommand->setPlaceholderText(i18n("Command with arguments"));
+  form->addRow(i18n("Command:"), leCommand);
+
+  leName = new QLineEdit(this);
+  leName->setPlaceholderText(i18n("Generated"));
+  form->addRow(i18n("Unit name:"), leName);
+
+  leDescription = new QLineEdit(this);
+  form->addRow(i18n("Description:"), leDescription);
+
+  // Limits left at zero are not set
+  spnCpuQuota = addLimit(form, i18n("CPU quota:"), i18n(" %"), 100 * QThread::idealThreadCount());
+  spnCpuWeight = addLimit(form, i18n("CPU weight:"), QString(), 10000);
+  spnMemoryHigh = addLimit(form, i18n("Memory high:"), i18n(" MiB"), INT_MAX);
+  spnMemoryMax = addLimit(form, i18n("Memory max:"), i18n(" MiB"), INT_MAX);
+  spnIOWeight = addLimit(form, i18n("IO weight:"), QString(), 10000);
+  spnTasksMax = addLimit(form, i18n("Tasks max:"), QString(), INT_MAX);
+
+  chkRemain = new QCheckBox(i18n("Keep the unit after the command exits"), this);
+  form->addRow(QString(), chkRemain);
+
+  lblError = new QLabel(this);
+  lblError->setWordWrap(true);
+  lblError->hide();
+
+  QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok |
+                                                     QDialogButtonBox::Cancel,
+                                                     this);
+  connect(buttonBox, SIGNAL(accepted()), this, SLOT(accept()));
+  connect(buttonBox, SIGNAL(rejected()), this, SLOT(reject()));
+
+  QVBoxLayout *vlayout = new QVBoxLayout;
+  vlayout->addLayout(form);
+  vlayout->addWidget(lblError);
+  vlayout->addWidget(buttonBox);
+  setLayout(vlayout);
+}
+
+QSpinBox *TransientUnitDialog::addLimit(QFormLayout *form, const QString &label, const QString &suffix, int max)
+{
+  QSpinBox *spinBox = new QSpinBox(this);
+  spinBox->setRange(0, max);
+  spinBox->setSpecialValueText(i18n("Not set"));
+  spinBox->setSuffix(suffix);
+  form->addRow(label, spinBox);
+  return spinBox;
+}
+
+void TransientUnitDialog::accept()
+{
+  // The manager wants an absolute path and the split arguments
+  KShell::Errors err;
+  QStringList argv = KShell::splitArgs(leCommand->text(), KShell::AbortOnMeta, &err);
+  QString error;
+  if (err != KShell::NoError || argv.isEmpty())
+    error = i18n("The command could not be parsed.");
+  else
+  {
+    QString path = argv.first().startsWith('/') ? argv.first() : QStandardPaths::findExecutable(argv.first());
+    if (path.isEmpty())
+      error = i18n("%1 was not found.", argv.first());
+    else
+    {
+      command.path = path;
+      command.argv = argv;
+    }
+  }
+
+  // Names of other unit types would silently become e.g. foo.timer.service
+  static const QRegExp rxOtherType("\\.(target|device|mount|automount|swap|socket|path|timer|snapshot|slice|scope)$");
+  static const QRegExp rxName("[A-Za-z0-9:_.\\\\-]+(@[A-Za-z0-9:_.\\\\-]+)?\\.service");
+  name = leName->text().trimmed();
+  if (name.isEmpty())
+    name = QStringLiteral("run-kcm-%1.service").arg(QDateTime::currentMSecsSinceEpoch(), 0, 16);
+  else if (rxOtherType.indexIn(name) != -1)
+    error = i18n("Only service units can be run, %1 is not a service.", name.toHtmlEscaped());
+  else if (!name.endsWith(QLatin1String(".service")))
+    name += QLatin1String(".service");
+
+  if (error.isEmpty() && (name.length() > 255 || !rxName.exactMatch(name)))
+    error = i18n("%1 is not a valid unit name. Use letters, digits and \":-_.\\\", optionally followed by @ and an instance name.", name.toHtmlEscaped());
+
+  if (!error.isEmpty())
+  {
+    lblError->setText(error);
+    lblError->show();
+    return;
+  }
+  QDialog::accept();
+}
+
+QString TransientUnitDialog::unitName() const
+{
+  return name;
+}
+
+bool TransientUnitDialog::userManager() const
+{
+  return cmbManager->currentIndex() == 1;
+}
+
+UnitPropertyList TransientUnitDialog::properties() const
+{
+  UnitPropertyList list;
+  QString description = leDescription->text().trimmed();
+  if (description.isEmpty())
+    description = command.argv.join(' ');
+  list << UnitProperty(QStringLiteral("Description"), description);
+  list << UnitProperty(QStringLiteral("ExecStart"), QVariant::fromValue(ExecCommandList() << command));
+  list << UnitProperty(QStringLiteral("RemainAfterExit"), chkRemain->isChecked());
+
+  // Accounting is switched on so the unit can be followed in the tables
+  list << UnitProperty(QStringLiteral("CPUAccounting"), true);
+  list << UnitProperty(QStringLiteral("MemoryAccounting"), true);
+  list << UnitProperty(QStringLiteral("TasksAccounting"), true);
+  list << UnitProperty(QStringLiteral("IOAccounting"), true);
+
+  if (spnCpuQuota->value() > 0)
+    list << UnitProperty(QStringLiteral("CPUQuotaPerSecUSec"), qulonglong(spnCpuQuota->value()) * 10000);
+  if (spnCpuWeight->value() > 0)
+    list << UnitProperty(QStringLiteral("CPUWeight"), qulonglong(spnCpuWeight->value()));
+  if (spnMemoryHigh->value() > 0)
+    list << UnitProperty(QStringLiteral("MemoryHigh"), qulonglong(spnMemoryHigh->value()) * 1024 * 1024);
+  if (spnMemoryMax->value() > 0)
+    list << UnitProperty(QStringLiteral("MemoryMax"), qulonglong(spnMemoryMax->value()) * 1024 * 1024);
+  if (spnIOWeight->value() > 0)
+    list << UnitProperty(QStringLiteral("IOWeight"), qulonglong(spnIOWeight->value()));
+  if (spnTasksMax->value() > 0)
+    list << UnitProperty(QStringLiteral("TasksMax"), qulonglong(spnTasksMax->value()));
+  return list;
+}
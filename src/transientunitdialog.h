@@ -0,0 +1,59 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef TRANSIENTUNITDIALOG_H
+#define TRANSIENTUNITDIALOG_H
+
+#include <QDialog>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QFormLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QSpinBox>
+
+#include "unitproperty.h"
+
+// Asks for a command and the resource limits to run it under, like
+// systemd-run -p. The caller starts the unit with StartTransientUnit.
+class TransientUnitDialog : public QDialog
+{
+  Q_OBJECT
+
+public:
+  TransientUnitDialog(QWidget *parent, bool allowUserManager);
+  QString unitName() const;
+  UnitPropertyList properties() const;
+  bool userManager() const;
+
+public slots:
+  void accept();
+
+private:
+  QSpinBox *addLimit(QFormLayout *form, const QString &label, const QString &suffix, int max);
+
+  QComboBox *cmbManager;
+  QLineEdit *leCommand, *leName, *leDescription;
+  QSpinBox *spnCpuQuota, *spnCpuWeight, *spnMemoryHigh, *spnMemoryMax, *spnIOWeight, *spnTasksMax;
+  QCheckBox *chkRemain;
+  QLabel *lblError;
+  ExecCommand command;
+  QString name;
+};
+
+#endif // TRANSIENTUNITDIALOG_H
@@ -0,0 +1,216 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+#include "unitcache.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtDebug>
+
+// Bump cacheVersion whenever the layout below changes, old snapshots
+// are then ignored.
+static const quint32 cacheMagic = 0x4b53444b; // "KSDK"
+static const quint32 cacheVersion = 3;
+
+static QString cacheFilePath()
+{
+  return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) +
+         QStringLiteral("/systemd-kcm/units.cache");
+}
+
+// Smallest possible size of a record, every string takes at least its
+// four byte length
+static const qint64 minUnitRecordSize = 11 * 4 + 4;
+static const qint64 minTimerRecordSize = 4 * 4 + 4 + 4 * 8 + 4;
+static const qint64 minSessionRowSize = 4;
+static const qint64 minStringSize = 4;
+
+static quint32 boundedCount(QDataStream &in, quint32 count, qint64 minRecordSize)
+{
+  // A corrupt count must not make us reserve more records than the rest
+  // of the file can hold
+  return quint32(qMin(qint64(count), in.device()->bytesAvailable() / minRecordSize));
+}
+
+static void writeUnits(QDataStream &out, const QList<SystemdUnit> &list)
+{
+  out << quint32(list.size());
+  foreach (const SystemdUnit &unit, list)
+  {
+    out << unit.id << unit.description << unit.load_state << unit.active_state
+        << unit.sub_state << unit.following << unit.job_type << unit.unit_file
+        << unit.unit_file_status << unit.unit_path.path() << unit.job_path.path()
+        << quint32(unit.job_id);
+  }
+}
+
+static bool readUnits(QDataStream &in, QList<SystemdUnit> *list)
+{
+  quint32 count;
+  in >> count;
+  list->reserve(boundedCount(in, count, minUnitRecordSize));
+  for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+  {
+    SystemdUnit unit;
+    QString unitPath, jobPath;
+    quint32 jobId;
+    in >> unit.id >> unit.description >> unit.load_state >> unit.active_state
+       >> unit.sub_state >> unit.following >> unit.job_type >> unit.unit_file
+       >> unit.unit_file_status >> unitPath >> jobPath >> jobId;
+    if (!unitPath.isEmpty())
+      unit.unit_path = QDBusObjectPath(unitPath);
+    if (!jobPath.isEmpty())
+      unit.job_path = QDBusObjectPath(jobPath);
+    unit.job_id = jobId;
+    unit.stale = true;
+    list->append(unit);
+  }
+  return in.status() == QDataStream::Ok;
+}
+
+static void writeTimers(QDataStream &out, const QList<SystemdTimer> &list)
+{
+  out << quint32(list.size());
+  foreach (const SystemdTimer &timer, list)
+  {
+    out << timer.id << timer.unit_to_activate << timer.timer_path.path()
+        << timer.unit_path.path() << quint32(timer.bus)
+        << timer.next_elapse_realtime << timer.next_elapse_monotonic
+        << timer.last_trigger << timer.last_run;
+    out << quint32(timer.history.count);
+    for (int i = 0; i < timer.history.count; ++i)
+      out << timer.history.at(i).scheduled << timer.history.at(i).start << timer.history.at(i).exit;
+  }
+}
+
+static bool readTimers(QDataStream &in, QList<SystemdTimer> *list)
+{
+  quint32 count;
+  in >> count;
+  list->reserve(boundedCount(in, count, minTimerRecordSize));
+  for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+  {
+    SystemdTimer timer;
+    QString timerPath, unitPath;
+    quint32 bus;
+    in >> timer.id >> timer.unit_to_activate >> timerPath >> unitPath >> bus
+       >> timer.next_elapse_realtime >> timer.next_elapse_monotonic
+       >> timer.last_trigger >> timer.last_run;
+    quint32 runs;
+    in >> runs;
+    for (quint32 j = 0; j < runs && in.status() == QDataStream::Ok; ++j)
+    {
+      TimerRun run;
+      in >> run.scheduled >> run.start >> run.exit;
+      timer.history.append(run);
+    }
+    if (!timerPath.isEmpty())
+      timer.timer_path = QDBusObjectPath(timerPath);
+    if (!unitPath.isEmpty())
+      timer.unit_path = QDBusObjectPath(unitPath);
+    timer.bus = static_cast<dbusBus>(bus);
+    timer.stale = true;
+    list->append(timer);
+  }
+  return in.status() == QDataStream::Ok;
+}
+
+static bool readSessionRows(QDataStream &in, QList<QStringList> *list)
+{
+  // Written as a QList<QStringList>, read by hand so that the counts
+  // can be checked before reserving
+  quint32 count;
+  in >> count;
+  list->reserve(boundedCount(in, count, minSessionRowSize));
+  for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+  {
+    quint32 fields;
+    in >> fields;
+    QStringList row;
+    row.reserve(boundedCount(in, fields, minStringSize));
+    for (quint32 j = 0; j < fields && in.status() == QDataStream::Ok; ++j)
+    {
+      QString field;
+      in >> field;
+      row.append(field);
+    }
+    list->append(row);
+  }
+  return in.status() == QDataStream::Ok;
+}
+
+bool readUnitCache(UnitCacheData *data)
+{
+  QFile file(cacheFilePath());
+  if (!file.open(QIODevice::ReadOnly) || file.size() == 0)
+    return false;
+
+  // Map the file instead of reading it, the strings are copied out
+  // while parsing and the mapping is released when the file is closed.
+  uchar *mem = file.map(0, file.size());
+  if (!mem)
+    return false;
+
+  QByteArray buf = QByteArray::fromRawData(reinterpret_cast<const char *>(mem), file.size());
+  QDataStream in(buf);
+  in.setVersion(QDataStream::Qt_5_2);
+
+  quint32 magic, version;
+  in >> magic >> version;
+  if (magic != cacheMagic || version != cacheVersion)
+  {
+    qDebug() << "Ignoring unit cache with unknown format" << cacheFilePath();
+    return false;
+  }
+
+  bool ok = readUnits(in, &data->systemUnits) && readUnits(in, &data->userUnits) &&
+            readSessionRows(in, &data->sessionRows) && readTimers(in, &data->timers);
+
+  file.unmap(mem);
+  if (!ok)
+  {
+    qDebug() << "Unit cache is corrupt:" << cacheFilePath();
+    *data = UnitCacheData();
+  }
+  return ok;
+}
+
+bool writeUnitCache(const UnitCacheData &data)
+{
+  QString path = cacheFilePath();
+  QDir().mkpath(path.section('/', 0, -2));
+
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    qDebug() << "Failed to write unit cache:" << file.errorString();
+    return false;
+  }
+
+  QDataStream out(&file);
+  out.setVersion(QDataStream::Qt_5_2);
+  out << cacheMagic << cacheVersion;
+  writeUnits(out, data.systemUnits);
+  writeUnits(out, data.userUnits);
+  out << data.sessionRows;
+  writeTimers(out, data.timers);
+
+  return file.commit();
+}
@@ -0,0 +1,47 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+#ifndef UNITCACHE_H
+#define UNITCACHE_H
+
+#include <QStringList>
+
+#include "systemdunit.h"
+
+// Snapshot of the lists shown in the module, stored in the user's cache
+// directory so they can be displayed before systemd has answered.
+struct UnitCacheData
+{
+  QList<SystemdUnit> systemUnits, userUnits;
+  QList<QStringList> sessionRows;
+  QList<SystemdTimer> timers;
+};
+
+/**
+ * \brief reads the snapshot written by the last run of the module.
+ * \param data Receives the cached lists. Units are marked as stale.
+ * \return true if a snapshot of the current format was found.
+ */
+bool readUnitCache(UnitCacheData *data);
+
+/**
+ * \brief atomically replaces the snapshot with the given lists.
+ * \return true on success.
+ */
+bool writeUnitCache(const UnitCacheData &data);
+
+#endif // UNITCACHE_H
@@ -0,0 +1,116 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+#include "unitfacets.h"
+
+#include <QSet>
+
+UnitFacets::UnitFacets()
+{
+}
+
+void UnitFacets::update(const QList<SystemdUnit> &list)
+{
+  // Single pass over the list, only touching the counters of units whose
+  // facet values differ from the previous list.
+
+  QSet<QString> seen;
+  seen.reserve(list.size());
+
+  foreach (const SystemdUnit &unit, list)
+  {
+    seen.insert(unit.id);
+
+    FacetValues newValues(facetCount);
+    for (int f = 0; f < facetCount; ++f)
+      newValues[f] = facetValue(static_cast<facetType>(f), unit);
+
+    QHash<QString, FacetValues>::iterator it = unitValues.find(unit.id);
+    if (it == unitValues.end())
+    {
+      for (int f = 0; f < facetCount; ++f)
+        counts[f][newValues.at(f)]++;
+      unitValues.insert(unit.id, newValues);
+      continue;
+    }
+
+    for (int f = 0; f < facetCount; ++f)
+    {
+      if (it->at(f) == newValues.at(f))
+        continue;
+      if (--counts[f][it->at(f)] == 0)
+        counts[f].remove(it->at(f));
+      counts[f][newValues.at(f)]++;
+    }
+    *it = newValues;
+  }
+
+  if (seen.size() != unitValues.size())
+  {
+    QHash<QString, FacetValues>::iterator it = unitValues.begin();
+    while (it != unitValues.end())
+    {
+      if (seen.contains(it.key()))
+      {
+        ++it;
+        continue;
+      }
+      for (int f = 0; f < facetCount; ++f)
+      {
+        if (--counts[f][it->at(f)] == 0)
+          counts[f].remove(it->at(f));
+      }
+      it = unitValues.erase(it);
+    }
+  }
+}
+
+int UnitFacets::count(facetType type, const QString &value) const
+{
+  return counts[type].value(value);
+}
+
+int UnitFacets::total() const
+{
+  return unitValues.size();
+}
+
+QStringList UnitFacets::values(facetType type) const
+{
+  QStringList list = counts[type].keys();
+  list.sort();
+  return list;
+}
+
+QString UnitFacets::facetValue(facetType type, const SystemdUnit &unit)
+{
+  switch (type)
+  {
+    case facetLoadState:
+      return unit.load_state;
+    case facetActiveState:
+      return unit.active_state;
+    case facetSubState:
+      return unit.sub_state;
+    case facetUnitType:
+      return unit.id.section('.', -1);
+    case facetUnitFileStatus:
+      return unit.unit_file_status;
+    default:
+      return QString();
+  }
+}
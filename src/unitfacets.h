@@ -0,0 +1,51 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+#ifndef UNITFACETS_H
+#define UNITFACETS_H
+
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+#include "systemdunit.h"
+
+enum facetType
+{
+  facetLoadState, facetActiveState, facetSubState, facetUnitType, facetUnitFileStatus, facetCount
+};
+
+// Keeps the number of units for every value of every facet. The counts are
+// updated from the differences between consecutive unit lists.
+class UnitFacets
+{
+public:
+  UnitFacets();
+  void update(const QList<SystemdUnit> &list);
+  int count(facetType type, const QString &value) const;
+  int total() const;
+  QStringList values(facetType type) const;
+  static QString facetValue(facetType type, const SystemdUnit &unit);
+
+private:
+  typedef QVector<QString> FacetValues;
+
+  QHash<QString, FacetValues> unitValues;
+  QHash<QString, int> counts[facetCount];
+};
+
+#endif // UNITFACETS_H
@@ -16,11 +16,14 @@
  *******************************************************************************/
 
 #include "unitmodel.h"
+#include "bootmodel.h"
 
 #include <QtDBus/QtDBus>
 #include <QColor>
+#include <QFont>
 #include <KLocalizedString>
 #include <KColorScheme>
+#include <KFormat>
 
 #include <systemd/sd-journal.h>
 
@@ -29,11 +32,195 @@ UnitModel::UnitModel(QObject *parent)
 {
 }
 
-UnitModel::UnitModel(QObject *parent, const QList<SystemdUnit> *list, QString userBusPath)
+// Indexes into brushCache, one per row is kept in foregroundCache
+enum unitForeground
+{
+  fgNone, fgActive, fgFailed, fgUnloaded
+};
+
+UnitModel::UnitModel(QObject *parent, QList<SystemdUnit> *list, QString userBusPath)
  : QAbstractTableModel(parent)
 {
   unitList = list;
   userBus = userBusPath;
+
+  headerCache << i18n("Load State")
+              << i18n("Active State")
+              << i18n("Unit State")
+              << i18n("Unit")
+              << i18n("CPU")
+              << i18n("Memory")
+              << i18n("Tasks")
+              << i18n("IO Read")
+              << i18n("IO Write")
+              << i18n("CPU Pressure")
+              << i18n("Memory Pressure")
+              << i18n("IO Pressure")
+              << i18n("OOM Kills")
+              << i18n("Start Latency");
+  QFont font;
+  font.setItalic(true);
+  staleFont = font;
+  updateBrushes();
+  updateRowCache();
+}
+
+void UnitModel::listChanged()
+{
+  // Called when the unit list has been refreshed
+  updateRowCache();
+  if (rowCount() > 0)
+    emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+}
+
+void UnitModel::paletteChanged()
+{
+  updateBrushes();
+  if (rowCount() > 0)
+    emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+}
+
+void UnitModel::updateBrushes()
+{
+  const KColorScheme scheme(QPalette::Normal);
+  brushCache.clear();
+  brushCache << QVariant()
+             << scheme.foreground(KColorScheme::PositiveText)
+             << scheme.foreground(KColorScheme::NegativeText)
+             << scheme.foreground(KColorScheme::InactiveText);
+}
+
+void UnitModel::updateRowCache()
+{
+  int rows = unitList->size();
+  displayCache.resize(rows * 4);
+  foregroundCache.resize(rows);
+
+  for (int row = 0; row < rows; ++row)
+    updateRow(row);
+  updateRowIndex();
+}
+
+void UnitModel::updateRowIndex()
+{
+  rowById.clear();
+  rowById.reserve(unitList->size());
+  for (int row = 0; row < unitList->size(); ++row)
+    rowById.insert(unitList->at(row).id, row);
+}
+
+void UnitModel::setResourceMonitor(UnitResourceMonitor *monitor)
+{
+  resourceMonitor = monitor;
+  connect(resourceMonitor, SIGNAL(sampled(QString)), this, SLOT(slotResourcesSampled(QString)));
+}
+
+void UnitModel::slotResourcesSampled(const QString &id)
+{
+  int row = rowById.value(id, -1);
+  if (row >= 0)
+    emit dataChanged(index(row, colCpu), index(row, colIOPressure));
+}
+
+void UnitModel::setMemoryEventWatcher(MemoryEventWatcher *watcher)
+{
+  memoryEvents = watcher;
+  connect(memoryEvents, SIGNAL(eventsChanged(QString,bool)), this, SLOT(slotMemoryEventsChanged(QString,bool)));
+}
+
+void UnitModel::slotMemoryEventsChanged(const QString &id, bool userUnit)
+{
+  if (userUnit != !userBus.isEmpty())
+    return;
+  int row = rowById.value(id, -1);
+  if (row >= 0)
+    emit dataChanged(index(row, colOomKills), index(row, colOomKills));
+}
+
+void UnitModel::setJobLatencyTracker(JobLatencyTracker *tracker)
+{
+  jobLatency = tracker;
+  connect(jobLatency, SIGNAL(latencyRecorded(QString,bool)), this, SLOT(slotLatencyRecorded(QString,bool)));
+}
+
+void UnitModel::slotLatencyRecorded(const QString &id, bool userUnit)
+{
+  if (userUnit != !userBus.isEmpty())
+    return;
+  int row = rowById.value(id, -1);
+  if (row >= 0)
+    emit dataChanged(index(row, colStartLatency), index(row, colStartLatency));
+}
+
+void UnitModel::updateRow(int row)
+{
+  const SystemdUnit &unit = unitList->at(row);
+  displayCache[row * 4] = unit.load_state;
+  displayCache[row * 4 + 1] = unit.active_state;
+  displayCache[row * 4 + 2] = unit.sub_state;
+  displayCache[row * 4 + 3] = unit.id;
+
+  if (unit.active_state == QLatin1String("active"))
+    foregroundCache[row] = fgActive;
+  else if (unit.active_state == QLatin1String("failed"))
+    foregroundCache[row] = fgFailed;
+  else if (unit.active_state == QLatin1String("-"))
+    foregroundCache[row] = fgUnloaded;
+  else
+    foregroundCache[row] = fgNone;
+}
+
+void UnitModel::reconcile(const QList<SystemdUnit> &live)
+{
+  // Replaces the (cached) list with the live list from systemd. Rows that
+  // are still present are updated in place, new units are appended and
+  // units that systemd no longer knows about are removed.
+
+  QHash<QString, int> rows;
+  rows.reserve(unitList->size());
+  for (int row = 0; row < unitList->size(); ++row)
+    rows.insert(unitList->at(row).id, row);
+
+  QVector<bool> confirmed(unitList->size(), false);
+  QList<SystemdUnit> added;
+  foreach (const SystemdUnit &unit, live)
+  {
+    QHash<QString, int>::const_iterator it = rows.constFind(unit.id);
+    if (it == rows.constEnd())
+    {
+      added.append(unit);
+      continue;
+    }
+    int row = it.value();
+    confirmed[row] = true;
+    (*unitList)[row] = unit;
+    updateRow(row);
+    emit dataChanged(index(row, 0), index(row, columnCount() - 1));
+  }
+
+  for (int row = unitList->size() - 1; row >= 0; --row)
+  {
+    if (confirmed.at(row))
+      continue;
+    beginRemoveRows(QModelIndex(), row, row);
+    unitList->removeAt(row);
+    displayCache.remove(row * 4, 4);
+    foregroundCache.remove(row);
+    endRemoveRows();
+  }
+
+  if (!added.isEmpty())
+  {
+    int first = unitList->size();
+    beginInsertRows(QModelIndex(), first, first + added.size() - 1);
+    unitList->append(added);
+    displayCache.resize(unitList->size() * 4);
+    foregroundCache.resize(unitList->size());
+    for (int row = first; row < unitList->size(); ++row)
+      updateRow(row);
+    endInsertRows();
+  }
+  updateRowIndex();
 }
 
 int UnitModel::rowCount(const QModelIndex &) const
@@ -43,51 +230,128 @@ int UnitModel::rowCount(const QModelIndex &) const
 
 int UnitModel::columnCount(const QModelIndex &) const
 {
-  return 4;
+  return unitColumnCount;
 }
 
 QVariant UnitModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
-  if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section == 0)
-    return i18n("Load State");
-  if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section == 1)
-    return i18n("Active State");
-  if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section == 2)
-    return i18n("Unit State");
-  if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section == 3)
-    return i18n("Unit");
+  if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < headerCache.size())
+    return headerCache.at(section);
   return QVariant();
 }
 
 QVariant UnitModel::data(const QModelIndex & index, int role) const
 {
 
-  if (!index.isValid())
+  if (!index.isValid() || index.row() >= foregroundCache.size())
     return QVariant();
 
   if (role == Qt::DisplayRole)
   {
-    if (index.column() == 0)
-      return unitList->at(index.row()).load_state;
-    else if (index.column() == 1)
-      return unitList->at(index.row()).active_state;
-    else if (index.column() == 2)
-      return unitList->at(index.row()).sub_state;
-    else if (index.column() == 3)
-      return unitList->at(index.row()).id;
+    if (index.column() < 4)
+      return displayCache.at(index.row() * 4 + index.column());
+
+    MemoryEvents events;
+    if (index.column() == colOomKills)
+    {
+      if (memoryEvents && memoryEvents->events(unitList->at(index.row()).id, !userBus.isEmpty(), &events))
+        return events.oomKill;
+      return QVariant();
+    }
+
+    JobLatencyRecord latency;
+    if (index.column() == colStartLatency)
+    {
+      if (!jobLatency || !jobLatency->latest(unitList->at(index.row()).id, !userBus.isEmpty(), &latency))
+        return QVariant();
+      if (latency.result != QLatin1String("done"))
+        return latency.result;
+      return BootModel::formatDuration(latency.total);
+    }
+
+    if (!resourceMonitor)
+      return QVariant();
+
+    UnitUsage u = resourceMonitor->usage(unitList->at(index.row()).id);
+    if (!u.valid)
+      return QVariant();
+    switch (index.column())
+    {
+      case colCpu: return u.hasRates ? QString::number(u.cpuPercent, 'f', 1) + '%' : QString();
+      case colMemory: return KFormat().formatByteSize(u.memory);
+      case colTasks: return u.tasks;
+      case colIORead: return u.hasRates ? i18n("%1/s", KFormat().formatByteSize(u.ioReadRate)) : QString();
+      case colIOWrite: return u.hasRates ? i18n("%1/s", KFormat().formatByteSize(u.ioWriteRate)) : QString();
+    }
+
+    // Stalls over the last 10 seconds, some / full
+    const PressureStat &p = u.pressure[index.column() - colCpuPressure];
+    if (p.valid)
+      return QString("%1% / %2%").arg(p.someAvg10, 0, 'f', 2).arg(p.fullAvg10, 0, 'f', 2);
   }
 
-  else if (role == Qt::ForegroundRole)
+  else if (role == Qt::UserRole && index.column() == colOomKills)
   {
-    const KColorScheme scheme(QPalette::Normal);
-    if (unitList->at(index.row()).active_state == "active")
-      return scheme.foreground(KColorScheme::PositiveText);
-    else if (unitList->at(index.row()).active_state == "failed")
-      return scheme.foreground(KColorScheme::NegativeText);
-    else if (unitList->at(index.row()).active_state == "-")
-      return scheme.foreground(KColorScheme::InactiveText);
-    else
+    MemoryEvents events;
+    if (memoryEvents)
+      memoryEvents->events(unitList->at(index.row()).id, !userBus.isEmpty(), &events);
+    return events.oomKill;
+  }
+
+  else if (role == Qt::UserRole && index.column() == colStartLatency)
+  {
+    JobLatencyRecord latency;
+    if (jobLatency)
+      jobLatency->latest(unitList->at(index.row()).id, !userBus.isEmpty(), &latency);
+    return latency.total;
+  }
+
+  else if (role == Qt::UserRole && index.column() >= colCpu && resourceMonitor)
+  {
+    // Raw values, used for sorting the resource columns
+    UnitUsage u = resourceMonitor->usage(unitList->at(index.row()).id);
+    switch (index.column())
+    {
+      case colCpu: return u.cpuPercent;
+      case colMemory: return u.memory;
+      case colTasks: return u.tasks;
+      case colIORead: return u.ioReadRate;
+      case colIOWrite: return u.ioWriteRate;
+    }
+    return u.pressure[index.column() - colCpuPressure].someAvg10;
+  }
+
+  else if (role == Qt::ToolTipRole && index.column() >= colCpuPressure && index.column() <= colIOPressure && resourceMonitor)
+  {
+    const PressureStat p = resourceMonitor->usage(unitList->at(index.row()).id).pressure[index.column() - colCpuPressure];
+    if (!p.valid)
       return QVariant();
+    return i18n("<b>Some tasks stalled:</b> %1% (10 s), %2% (60 s)<br><b>All tasks stalled:</b> %3% (10 s), %4% (60 s)",
+                QString::number(p.someAvg10, 'f', 2), QString::number(p.someAvg60, 'f', 2),
+                QString::number(p.fullAvg10, 'f', 2), QString::number(p.fullAvg60, 'f', 2));
+  }
+
+  else if (role == Qt::ForegroundRole && index.column() == colStartLatency && jobLatency &&
+           jobLatency->isRegression(unitList->at(index.row()).id, !userBus.isEmpty()))
+  {
+    return brushCache.at(fgFailed);
+  }
+
+  else if (role == Qt::ForegroundRole)
+  {
+    return brushCache.at(foregroundCache.at(index.row()));
+  }
+
+  else if (role == Qt::FontRole)
+  {
+    // Units from the cache are shown in italics until systemd confirms them
+    if (unitList->at(index.row()).stale)
+      return staleFont;
+  }
+
+  else if (role >= unitFacetRole && role < unitFacetRole + facetCount)
+  {
+    return UnitFacets::facetValue(static_cast<facetType>(role - unitFacetRole), unitList->at(index.row()));
   }
 
   else if (role == Qt::ToolTipRole)
@@ -175,6 +439,9 @@ QVariant UnitModel::data(const QModelIndex & index, int role) const
       delete iface;
     }
 
+    toolTipText.append(memoryEventsToolTip(selUnit));
+    toolTipText.append(jobLatencyToolTip(selUnit));
+
     // Journal entries for units
     toolTipText.append(i18n("<hr><b>Last log entries:</b>"));
     QStringList log = getLastJrnlEntries(selUnit);
@@ -197,6 +464,71 @@ QVariant UnitModel::data(const QModelIndex & index, int role) const
   return QVariant();
 }
 
+QString UnitModel::memoryEventsToolTip(const QString &unit) const
+{
+  // Counters of the unit's control group and their recent changes
+  MemoryEvents events;
+  if (!memoryEvents || !memoryEvents->events(unit, !userBus.isEmpty(), &events))
+    return QString();
+  if (events.oom == 0 && events.oomKill == 0 && events.high == 0 && events.max == 0)
+    return QString();
+
+  QString text = i18n("<hr><b>Memory events:</b> %1 OOM, %2 OOM kills, %3 over high, %4 at max",
+                      events.oom, events.oomKill, events.high, events.max);
+  QList<MemoryEventRecord> history = memoryEvents->history(unit, !userBus.isEmpty());
+  for (int i = history.size() - 1; i >= 0; --i)
+  {
+    const MemoryEventRecord &record = history.at(i);
+    text.append("<br>" + record.time.toString("yyyy.MM.dd hh:mm:ss") + ": ");
+    if (record.delta.oomKill > 0)
+      text.append("<span style='color:tomato;'>" + i18np("1 OOM kill", "%1 OOM kills", record.delta.oomKill) + "</span>");
+    else if (record.delta.oom > 0)
+      text.append(i18np("1 OOM", "%1 OOM", record.delta.oom));
+    else if (record.delta.max > 0)
+      text.append(i18np("1 time at max", "%1 times at max", record.delta.max));
+    else
+      text.append(i18np("1 time over high", "%1 times over high", record.delta.high));
+    if (!record.kernelMessage.isEmpty())
+      text.append("<br><i>" + record.kernelMessage.toHtmlEscaped() + "</i>");
+  }
+  return text;
+}
+
+QString UnitModel::jobLatencyToolTip(const QString &unit) const
+{
+  // Starts and restarts done from the unit lists, newest first
+  if (!jobLatency)
+    return QString();
+  QList<JobLatencyRecord> history = jobLatency->history(unit, !userBus.isEmpty());
+  if (history.isEmpty())
+    return QString();
+
+  QString text = i18n("<hr><b>Start latency:</b>");
+  if (jobLatency->isRegression(unit, !userBus.isEmpty()))
+    text.append(" <span style='color:tomato;'>" + i18n("slower than usual") + "</span>");
+  for (int i = history.size() - 1; i >= 0; --i)
+  {
+    const JobLatencyRecord &record = history.at(i);
+    text.append("<br>" + record.time.toString("yyyy.MM.dd hh:mm:ss") + ", " + record.action + ": ");
+    if (!record.active)
+    {
+      text.append(i18n("%1 after %2", record.result, BootModel::formatDuration(record.total)));
+      continue;
+    }
+    text.append(i18n("active after %1", BootModel::formatDuration(record.total)));
+    QStringList phases;
+    if (record.stopping)
+      phases << i18n("%1 stopping", BootModel::formatDuration(record.stopping));
+    if (record.activating)
+      phases << i18n("%1 activating", BootModel::formatDuration(record.activating));
+    if (record.wait >= 1000000)
+      phases << i18n("%1 before the job was queued", BootModel::formatDuration(record.wait));
+    if (!phases.isEmpty())
+      text.append(" (" + phases.join(", ") + ")");
+  }
+  return text;
+}
+
 QStringList UnitModel::getLastJrnlEntries(QString unit) const
 {
   QString match1, match2;
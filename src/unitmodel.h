@@ -19,8 +19,24 @@
 #define UNITMODEL_H
 
 #include <QAbstractTableModel>
+#include <QVector>
 
 #include "systemdunit.h"
+#include "unitfacets.h"
+#include "unitresourcemonitor.h"
+#include "memoryeventwatcher.h"
+#include "joblatencytracker.h"
+
+// data() returns the value of facet f for role unitFacetRole + f
+const int unitFacetRole = Qt::UserRole + 10;
+
+// The optional resource columns follow the four unit columns. They are
+// hidden by default and filled from a UnitResourceMonitor.
+enum unitResourceColumn
+{
+  colCpu = 4, colMemory, colTasks, colIORead, colIOWrite,
+  colCpuPressure, colMemoryPressure, colIOPressure, colOomKills, colStartLatency, unitColumnCount
+};
 
 class UnitModel : public QAbstractTableModel
 {
@@ -28,16 +44,43 @@ class UnitModel : public QAbstractTableModel
   
 public:
   explicit UnitModel(QObject *parent = 0);
-  explicit UnitModel(QObject *parent = 0, const QList<SystemdUnit> *list = NULL, QString userBusPath = "");
+  explicit UnitModel(QObject *parent = 0, QList<SystemdUnit> *list = NULL, QString userBusPath = "");
   int rowCount(const QModelIndex & parent = QModelIndex()) const;
   int columnCount(const QModelIndex & parent = QModelIndex()) const;
   QVariant headerData(int section, Qt::Orientation orientation, int role) const;
   QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+  void listChanged();
+  void paletteChanged();
+  void reconcile(const QList<SystemdUnit> &live);
+  void setResourceMonitor(UnitResourceMonitor *monitor);
+  void setMemoryEventWatcher(MemoryEventWatcher *watcher);
+  void setJobLatencyTracker(JobLatencyTracker *tracker);
+
+private slots:
+  void slotResourcesSampled(const QString &id);
+  void slotMemoryEventsChanged(const QString &id, bool userUnit);
+  void slotLatencyRecorded(const QString &id, bool userUnit);
 
 private:
   QStringList getLastJrnlEntries(QString unit) const;
-  const QList<SystemdUnit> *unitList;
+  QString memoryEventsToolTip(const QString &unit) const;
+  QString jobLatencyToolTip(const QString &unit) const;
+  void updateBrushes();
+  void updateRowCache();
+  void updateRow(int row);
+  void updateRowIndex();
+  QList<SystemdUnit> *unitList;
   QString userBus;
+  UnitResourceMonitor *resourceMonitor = NULL;
+  MemoryEventWatcher *memoryEvents = NULL;
+  JobLatencyTracker *jobLatency = NULL;
+  QHash<QString, int> rowById;
+
+  // Values handed out by data() and headerData(), so that painting the
+  // table does not allocate
+  QVector<QVariant> headerCache, brushCache, displayCache;
+  QVariant staleFont;
+  QVector<quint8> foregroundCache;
 };
   
 #endif // UNITMODEL_H
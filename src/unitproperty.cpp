@@ -0,0 +1,130 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "unitproperty.h"
+
+QDBusArgument &operator<<(QDBusArgument &argument, const UnitProperty &property)
+{
+  argument.beginStructure();
+  argument << property.name << QDBusVariant(property.value);
+  argument.endStructure();
+  return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, UnitProperty &property)
+{
+  QDBusVariant value;
+  argument.beginStructure();
+  argument >> property.name >> value;
+  argument.endStructure();
+  property.value = value.variant();
+  return argument;
+}
+
+QDBusArgument &operator<<(QDBusArgument &argument, const ExecCommand &command)
+{
+  argument.beginStructure();
+  argument << command.path << command.argv << command.ignoreFailure;
+  argument.endStructure();
+  return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, ExecCommand &command)
+{
+  argument.beginStructure();
+  argument >> command.path >> command.argv >> command.ignoreFailure;
+  argument.endStructure();
+  return argument;
+}
+
+QDBusArgument &operator<<(QDBusArgument &argument, const AuxUnit &aux)
+{
+  argument.beginStructure();
+  argument << aux.name << aux.properties;
+  argument.endStructure();
+  return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, AuxUnit &aux)
+{
+  argument.beginStructure();
+  argument >> aux.name >> aux.properties;
+  argument.endStructure();
+  return argument;
+}
+
+void registerUnitPropertyTypes()
+{
+  qDBusRegisterMetaType<UnitProperty>();
+  qDBusRegisterMetaType<UnitPropertyList>();
+  qDBusRegisterMetaType<ExecCommand>();
+  qDBusRegisterMetaType<ExecCommandList>();
+  qDBusRegisterMetaType<AuxUnit>();
+  qDBusRegisterMetaType<AuxUnitList>();
+}
+
+QVariantList unitPropertiesToVariant(const UnitPropertyList &list)
+{
+  // Commands become [path, argv, ignoreFailure] lists
+  QVariantList result;
+  foreach (const UnitProperty &property, list)
+  {
+    QVariant value = property.value;
+    if (value.userType() == qMetaTypeId<ExecCommandList>())
+    {
+      QVariantList commands;
+      foreach (const ExecCommand &command, value.value<ExecCommandList>())
+        commands << QVariant(QVariantList() << command.path << command.argv << command.ignoreFailure);
+      value = commands;
+    }
+    result << QVariant(QVariantList() << property.name << value);
+  }
+  return result;
+}
+
+UnitPropertyList unitPropertiesFromVariant(const QVariantList &list)
+{
+  UnitPropertyList result;
+  foreach (const QVariant &entry, list)
+  {
+    QVariantList pair = entry.toList();
+    if (pair.size() != 2)
+      continue;
+
+    QString name = pair.at(0).toString();
+    QVariant value = pair.at(1);
+    if (name.startsWith(QLatin1String("Exec")))
+    {
+      ExecCommandList commands;
+      foreach (const QVariant &c, value.toList())
+      {
+        QVariantList fields = c.toList();
+        if (fields.size() != 3)
+          continue;
+        ExecCommand command;
+        command.path = fields.at(0).toString();
+        command.argv = fields.at(1).toStringList();
+        command.ignoreFailure = fields.at(2).toBool();
+        commands << command;
+      }
+      value = QVariant::fromValue(commands);
+    }
+    result << UnitProperty(name, value);
+  }
+  return result;
+}
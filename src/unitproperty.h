@@ -0,0 +1,75 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef UNITPROPERTY_H
+#define UNITPROPERTY_H
+
+#include <QtDBus/QtDBus>
+
+// A (sv) entry of the property array taken by SetUnitProperties and
+// StartTransientUnit
+struct UnitProperty
+{
+  QString name;
+  QVariant value;
+
+  UnitProperty() {}
+  UnitProperty(const QString &n, const QVariant &v) : name(n), value(v) {}
+};
+
+// A command of an Exec* property, (sasb) on the bus
+struct ExecCommand
+{
+  QString path;
+  QStringList argv;
+  bool ignoreFailure = false;
+};
+
+// An entry of the auxiliary unit array of StartTransientUnit
+struct AuxUnit
+{
+  QString name;
+  QList<UnitProperty> properties;
+};
+
+typedef QList<UnitProperty> UnitPropertyList;
+typedef QList<ExecCommand> ExecCommandList;
+typedef QList<AuxUnit> AuxUnitList;
+Q_DECLARE_METATYPE(UnitProperty)
+Q_DECLARE_METATYPE(UnitPropertyList)
+Q_DECLARE_METATYPE(ExecCommand)
+Q_DECLARE_METATYPE(ExecCommandList)
+Q_DECLARE_METATYPE(AuxUnit)
+Q_DECLARE_METATYPE(AuxUnitList)
+
+QDBusArgument &operator<<(QDBusArgument &argument, const UnitProperty &property);
+const QDBusArgument &operator>>(const QDBusArgument &argument, UnitProperty &property);
+QDBusArgument &operator<<(QDBusArgument &argument, const ExecCommand &command);
+const QDBusArgument &operator>>(const QDBusArgument &argument, ExecCommand &command);
+QDBusArgument &operator<<(QDBusArgument &argument, const AuxUnit &aux);
+const QDBusArgument &operator>>(const QDBusArgument &argument, AuxUnit &aux);
+
+// Registers the DBus marshalling of the types above
+void registerUnitPropertyTypes();
+
+// The KAuth helper only receives plain variants, so a property array is
+// passed to it as a list of [name, value] lists and rebuilt there
+QVariantList unitPropertiesToVariant(const UnitPropertyList &list);
+UnitPropertyList unitPropertiesFromVariant(const QVariantList &list);
+
+#endif // UNITPROPERTY_H
@@ -0,0 +1,239 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "unitresourcemonitor.h"
+
+#include <QFile>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+static const QString connSystemd = QStringLiteral("org.freedesktop.systemd1");
+
+// systemd reports this for counters whose accounting is disabled
+static const qulonglong notSet = Q_UINT64_C(0xffffffffffffffff);
+
+QString UnitResourceMonitor::resourceInterface(const QString &id)
+{
+  // The accounting properties live on the interface of the unit type
+  static const char *types[][2] = {
+    { ".service", "org.freedesktop.systemd1.Service" },
+    { ".scope", "org.freedesktop.systemd1.Scope" },
+    { ".slice", "org.freedesktop.systemd1.Slice" },
+    { ".socket", "org.freedesktop.systemd1.Socket" },
+    { ".mount", "org.freedesktop.systemd1.Mount" },
+    { ".swap", "org.freedesktop.systemd1.Swap" }
+  };
+  for (unsigned i = 0; i < sizeof(types) / sizeof(types[0]); ++i)
+  {
+    if (id.endsWith(QLatin1String(types[i][0])))
+      return QLatin1String(types[i][1]);
+  }
+  return QString();
+}
+
+UnitResourceMonitor::UnitResourceMonitor(QObject *parent, QString userBusPath)
+ : QObject(parent)
+{
+  userBus = userBusPath;
+  clock.start();
+}
+
+UnitResourceMonitor::~UnitResourceMonitor()
+{
+  for (QHash<QString, History>::iterator it = histories.begin(); it != histories.end(); ++it)
+    closePressure(it.value());
+}
+
+bool UnitResourceMonitor::hasResources(const QString &id)
+{
+  return !resourceInterface(id).isEmpty();
+}
+
+void UnitResourceMonitor::sample(const QString &id, const QDBusObjectPath &path)
+{
+  QString iface = resourceInterface(id);
+  if (iface.isEmpty() || path.path().isEmpty())
+    return;
+
+  // Skip units whose previous sample has not returned yet
+  History &h = histories[id];
+  h.lastUsed = pass;
+  if (h.pending)
+    return;
+
+  QDBusConnection bus("");
+  if (!userBus.isEmpty())
+    bus = QDBusConnection::connectToBus(userBus, connSystemd);
+  else
+    bus = QDBusConnection::systemBus();
+
+  QDBusMessage msg = QDBusMessage::createMethodCall(connSystemd, path.path(),
+                                                    QStringLiteral("org.freedesktop.DBus.Properties"),
+                                                    QStringLiteral("GetAll"));
+  msg << iface;
+  QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(bus.asyncCall(msg), this);
+  watcher->setProperty("id", id);
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)), this, SLOT(slotPropertiesReply(QDBusPendingCallWatcher*)));
+  h.pending = true;
+}
+
+void UnitResourceMonitor::expire(int passes)
+{
+  // Forget units that have not been on screen for a while
+  for (QHash<QString, History>::iterator it = histories.begin(); it != histories.end(); )
+  {
+    if (!it->pending && pass - it->lastUsed >= passes)
+    {
+      closePressure(it.value());
+      it = histories.erase(it);
+    }
+    else
+      ++it;
+  }
+  pass++;
+}
+
+UnitUsage UnitResourceMonitor::usage(const QString &id) const
+{
+  UnitUsage u;
+  QHash<QString, History>::const_iterator it = histories.constFind(id);
+  if (it == histories.constEnd() || it->count == 0)
+    return u;
+
+  const Sample &last = it->samples[(it->next + historySize - 1) % historySize];
+  u.valid = true;
+  u.memory = last.memory;
+  u.tasks = last.tasks;
+  for (int r = 0; r < pressureCount; ++r)
+    u.pressure[r] = it->pressure[r];
+  if (it->count < 2)
+    return u;
+
+  const Sample &prev = it->samples[(it->next + historySize - 2) % historySize];
+  double secs = (last.msecs - prev.msecs) / 1000.0;
+  if (secs <= 0)
+    return u;
+  u.hasRates = true;
+  u.cpuPercent = (last.cpuNsec - prev.cpuNsec) / (secs * 1e7);
+  u.ioReadRate = (last.ioRead - prev.ioRead) / secs;
+  u.ioWriteRate = (last.ioWrite - prev.ioWrite) / secs;
+  return u;
+}
+
+QString UnitResourceMonitor::controlGroup(const QString &id) const
+{
+  return histories.value(id).controlGroup;
+}
+
+void UnitResourceMonitor::slotPropertiesReply(QDBusPendingCallWatcher *watcher)
+{
+  QDBusPendingReply<QVariantMap> reply = *watcher;
+  watcher->deleteLater();
+
+  QString id = watcher->property("id").toString();
+  QHash<QString, History>::iterator it = histories.find(id);
+  if (it == histories.end())
+    return;
+  it->pending = false;
+  if (reply.isError())
+    return;
+
+  QVariantMap props = reply.value();
+  Sample s;
+  s.msecs = clock.elapsed();
+  s.cpuNsec = props.value(QStringLiteral("CPUUsageNSec")).toULongLong();
+  s.memory = props.value(QStringLiteral("MemoryCurrent")).toULongLong();
+  s.tasks = props.value(QStringLiteral("TasksCurrent")).toULongLong();
+  s.ioRead = props.value(QStringLiteral("IOReadBytes")).toULongLong();
+  s.ioWrite = props.value(QStringLiteral("IOWriteBytes")).toULongLong();
+  QString cgroup = props.value(QStringLiteral("ControlGroup")).toString();
+  if (cgroup != it->controlGroup)
+  {
+    closePressure(it.value());
+    it->controlGroup = cgroup;
+  }
+  readPressure(it.value());
+
+  // Counters without accounting read as zero
+  if (s.cpuNsec == notSet)
+    s.cpuNsec = 0;
+  if (s.memory == notSet)
+    s.memory = 0;
+  if (s.tasks == notSet)
+    s.tasks = 0;
+  if (s.ioRead == notSet)
+    s.ioRead = 0;
+  if (s.ioWrite == notSet)
+    s.ioWrite = 0;
+
+  // A counter that went backwards means the unit was restarted, the
+  // older samples would give a bogus rate
+  if (it->count > 0)
+  {
+    const Sample &last = it->samples[(it->next + historySize - 1) % historySize];
+    if (s.cpuNsec < last.cpuNsec || s.ioRead < last.ioRead || s.ioWrite < last.ioWrite)
+      it->count = 0;
+  }
+
+  it->samples[it->next] = s;
+  it->next = (it->next + 1) % historySize;
+  if (it->count < historySize)
+    it->count++;
+
+  emit sampled(id);
+}
+
+void UnitResourceMonitor::readPressure(History &h)
+{
+  // The files stay open while the unit is sampled
+  char buf[256];
+  for (int r = 0; r < pressureCount; ++r)
+  {
+    h.pressure[r] = PressureStat();
+    if (h.controlGroup.isEmpty())
+      continue;
+    if (h.pressureFd[r] < 0)
+    {
+      QByteArray path = QFile::encodeName(QStringLiteral("/sys/fs/cgroup") + h.controlGroup + '/' +
+                                          QLatin1String(pressureFileName(static_cast<pressureResource>(r))));
+      h.pressureFd[r] = ::open(path.constData(), O_RDONLY | O_CLOEXEC);
+      if (h.pressureFd[r] < 0)
+        continue;
+    }
+    ssize_t len = pread(h.pressureFd[r], buf, sizeof(buf) - 1, 0);
+    if (len <= 0)
+    {
+      ::close(h.pressureFd[r]);
+      h.pressureFd[r] = -1;
+      continue;
+    }
+    buf[len] = '\0';
+    parsePressure(buf, &h.pressure[r]);
+  }
+}
+
+void UnitResourceMonitor::closePressure(History &h)
+{
+  for (int r = 0; r < pressureCount; ++r)
+  {
+    if (h.pressureFd[r] >= 0)
+      ::close(h.pressureFd[r]);
+    h.pressureFd[r] = -1;
+  }
+}
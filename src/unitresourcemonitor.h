@@ -0,0 +1,90 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef UNITRESOURCEMONITOR_H
+#define UNITRESOURCEMONITOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QtDBus/QtDBus>
+
+#include "cgroupstat.h"
+
+// Current resource usage of a unit. Rates are computed from the two
+// most recent samples and are per second.
+struct UnitUsage
+{
+  double cpuPercent = 0, ioReadRate = 0, ioWriteRate = 0;
+  qulonglong memory = 0, tasks = 0;
+  PressureStat pressure[pressureCount];
+  bool valid = false, hasRates = false;
+};
+
+// Samples the resource accounting properties of units with one
+// asynchronous GetAll per unit, and keeps the last few samples of each
+// unit so that rates can be shown. The pressure files of the unit's
+// control group are read along with each sample.
+class UnitResourceMonitor : public QObject
+{
+  Q_OBJECT
+
+public:
+  explicit UnitResourceMonitor(QObject *parent = 0, QString userBusPath = "");
+  ~UnitResourceMonitor();
+  void sample(const QString &id, const QDBusObjectPath &path);
+  void expire(int passes = 60);
+  UnitUsage usage(const QString &id) const;
+  QString controlGroup(const QString &id) const;
+  static bool hasResources(const QString &id);
+  static QString resourceInterface(const QString &id);
+
+signals:
+  void sampled(const QString &id);
+
+private slots:
+  void slotPropertiesReply(QDBusPendingCallWatcher *);
+
+private:
+  struct Sample
+  {
+    qint64 msecs = 0;
+    qulonglong cpuNsec = 0, memory = 0, tasks = 0, ioRead = 0, ioWrite = 0;
+  };
+
+  // Ring buffer of the most recent samples of a unit
+  static const int historySize = 8;
+  struct History
+  {
+    Sample samples[historySize];
+    int next = 0, count = 0, lastUsed = 0;
+    bool pending = false;
+    QString controlGroup;
+    int pressureFd[pressureCount] = { -1, -1, -1 };
+    PressureStat pressure[pressureCount];
+  };
+
+  void readPressure(History &h);
+  static void closePressure(History &h);
+
+  QHash<QString, History> histories;
+  QElapsedTimer clock;
+  QString userBus;
+  int pass = 0;
+};
+
+#endif // UNITRESOURCEMONITOR_H
@@ -0,0 +1,395 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+#include "unitsearchindex.h"
+
+#include <algorithm>
+#include <iterator>
+
+// Weights used when scoring fuzzy matches
+static const int scoreMatch = 16;
+static const int bonusPrefix = 12;
+static const int bonusBoundary = 8;
+static const int bonusConsecutive = 4;
+static const int penaltyGapStart = 3;
+static const int penaltyGapExtension = 1;
+
+static inline quint64 charBit(ushort c)
+{
+  // Letters and digits get a bit each, everything else shares the rest
+  if (c >= 'a' && c <= 'z')
+    return quint64(1) << (c - 'a');
+  if (c >= '0' && c <= '9')
+    return quint64(1) << (26 + c - '0');
+  return quint64(1) << (36 + c % 28);
+}
+
+static quint64 charMask(const ushort *c, int len)
+{
+  quint64 mask = 0;
+  for (int i = 0; i < len; ++i)
+    mask |= charBit(c[i]);
+  return mask;
+}
+
+static inline bool isBoundary(ushort c)
+{
+  return c == '-' || c == '.' || c == '_' || c == '@' || c == ' ' || c == '/' || c == ':' || c == '\n';
+}
+
+static int scoreToken(const ushort *text, int len, const ushort *pat, int plen)
+{
+  // Scores pat as a subsequence of text, or returns -1 if it is not one.
+  // Long gaps lower the score of a match, but never below zero.
+  // The forward pass finds where the first complete match ends, the
+  // backward pass then finds the shortest window ending there.
+
+  int p = 0, end = -1;
+  for (int i = 0; i < len; ++i)
+  {
+    if (text[i] == pat[p] && ++p == plen)
+    {
+      end = i;
+      break;
+    }
+  }
+  if (end < 0)
+    return -1;
+
+  int start = 0;
+  p = plen - 1;
+  for (int i = end; i >= 0; --i)
+  {
+    if (text[i] == pat[p] && --p < 0)
+    {
+      start = i;
+      break;
+    }
+  }
+
+  int score = 0, prev = -2;
+  bool inGap = false;
+  p = 0;
+  for (int i = start; i <= end && p < plen; ++i)
+  {
+    if (text[i] == pat[p])
+    {
+      score += scoreMatch;
+      if (i == 0)
+        score += bonusPrefix;
+      else if (isBoundary(text[i-1]))
+        score += bonusBoundary;
+      if (prev == i - 1)
+        score += bonusConsecutive;
+      prev = i;
+      inGap = false;
+      ++p;
+    }
+    else
+    {
+      score -= inGap ? penaltyGapExtension : penaltyGapStart;
+      inGap = true;
+    }
+  }
+  return qMax(score, 0);
+}
+
+UnitSearchIndex::UnitSearchIndex()
+{
+}
+
+void UnitSearchIndex::update(const QList<SystemdUnit> &list)
+{
+  // Only (re)index units that are new or whose description changed,
+  // and drop units that are no longer in the list.
+
+  QSet<int> seen;
+  seen.reserve(list.size());
+
+  foreach (const SystemdUnit &unit, list)
+  {
+    QHash<QString, int>::const_iterator it = docIds.constFind(unit.id);
+    if (it != docIds.constEnd())
+    {
+      int doc = it.value();
+      seen.insert(doc);
+      if (docs.at(doc).text.length() == unit.id.length() + 1 + unit.description.length() &&
+          docs.at(doc).text.midRef(unit.id.length() + 1) == unit.description.toLower())
+        continue;
+      removeDocument(doc);
+      setText(doc, unit);
+      addDocument(doc);
+      continue;
+    }
+
+    int doc;
+    if (!freeDocs.isEmpty())
+    {
+      doc = freeDocs.takeLast();
+    }
+    else
+    {
+      doc = docs.size();
+      docs.append(Document());
+    }
+    docs[doc].id = unit.id;
+    setText(doc, unit);
+    docIds.insert(unit.id, doc);
+    addDocument(doc);
+    seen.insert(doc);
+  }
+
+  if (seen.size() != docIds.size())
+  {
+    QList<int> removed;
+    for (QHash<QString, int>::const_iterator it = docIds.constBegin(); it != docIds.constEnd(); ++it)
+    {
+      if (!seen.contains(it.value()))
+        removed << it.value();
+    }
+    foreach (int doc, removed)
+    {
+      removeDocument(doc);
+      docIds.remove(docs.at(doc).id);
+      docs[doc] = Document();
+      freeDocs.append(doc);
+    }
+  }
+}
+
+void UnitSearchIndex::clear()
+{
+  docs.clear();
+  freeDocs.clear();
+  docIds.clear();
+  postings.clear();
+  lastTerm.clear();
+  lastResult.clear();
+  lastFuzzyTerm.clear();
+  lastFuzzyResult.clear();
+  generation++;
+}
+
+QSet<QString> UnitSearchIndex::search(const QString &term)
+{
+  QSet<QString> result;
+  QString needle = term.toLower();
+
+  QVector<int> cand;
+  if (generation == lastGeneration && !lastTerm.isEmpty() && needle.contains(lastTerm))
+  {
+    // The query was narrowed, so the matches must be a subset of the
+    // previous result
+    cand = lastResult;
+  }
+  else if (needle.length() >= 3)
+  {
+    cand = candidates(needle);
+  }
+  else
+  {
+    cand.reserve(docIds.size());
+    foreach (int doc, docIds)
+      cand.append(doc);
+  }
+
+  // Trigram hits are only candidates, verify them against the text
+  QVector<int> matches;
+  matches.reserve(cand.size());
+  foreach (int doc, cand)
+  {
+    if (docs.at(doc).text.contains(needle))
+    {
+      matches.append(doc);
+      result.insert(docs.at(doc).id);
+    }
+  }
+
+  lastTerm = needle;
+  lastResult = matches;
+  lastGeneration = generation;
+  return result;
+}
+
+QHash<QString, int> UnitSearchIndex::fuzzySearch(const QString &term)
+{
+  // Matches every word of the term as a subsequence of the unit id, or
+  // failing that of the description, and returns the score of each match.
+
+  QHash<QString, int> result;
+  QString needle = term.toLower();
+  QStringList tokens = needle.split(' ', QString::SkipEmptyParts);
+  if (tokens.isEmpty())
+    return result;
+
+  quint64 patMask = 0;
+  foreach (const QString &token, tokens)
+    patMask |= charMask(token.utf16(), token.length());
+
+  QVector<int> cand;
+  if (generation == lastFuzzyGeneration && !lastFuzzyTerm.isEmpty() && needle.startsWith(lastFuzzyTerm))
+  {
+    // Appending to the term can only remove matches
+    cand = lastFuzzyResult;
+  }
+  else
+  {
+    cand.reserve(docIds.size());
+    foreach (int doc, docIds)
+      cand.append(doc);
+  }
+
+  QVector<int> matches;
+  matches.reserve(cand.size());
+  foreach (int doc, cand)
+  {
+    const Document &d = docs.at(doc);
+
+    // Reject units missing any of the characters before scoring
+    bool inId = (d.idMask & patMask) == patMask;
+    bool inDesc = (d.descMask & patMask) == patMask;
+    if (!inId && !inDesc)
+      continue;
+
+    const ushort *text = d.text.utf16();
+    int score = 0;
+    if (inId)
+    {
+      foreach (const QString &token, tokens)
+      {
+        int s = scoreToken(text, d.idLength, token.utf16(), token.length());
+        if (s < 0)
+        {
+          score = -1;
+          break;
+        }
+        score += s;
+      }
+    }
+    if ((!inId || score < 0) && inDesc)
+    {
+      // Description matches rank below id matches
+      score = 0;
+      int descLength = d.text.length() - d.idLength - 1;
+      foreach (const QString &token, tokens)
+      {
+        int s = scoreToken(text + d.idLength + 1, descLength, token.utf16(), token.length());
+        if (s < 0)
+        {
+          score = -1;
+          break;
+        }
+        score += s / 2;
+      }
+    }
+    else if (!inId)
+    {
+      score = -1;
+    }
+
+    if (score >= 0)
+    {
+      matches.append(doc);
+      result.insert(d.id, score);
+    }
+  }
+
+  lastFuzzyTerm = needle;
+  lastFuzzyResult = matches;
+  lastFuzzyGeneration = generation;
+  return result;
+}
+
+void UnitSearchIndex::setText(int doc, const SystemdUnit &unit)
+{
+  Document &d = docs[doc];
+  d.text = unit.id.toLower() + '\n' + unit.description.toLower();
+  d.idLength = unit.id.length();
+  d.idMask = charMask(d.text.utf16(), d.idLength);
+  d.descMask = charMask(d.text.utf16() + d.idLength + 1, d.text.length() - d.idLength - 1);
+}
+
+void UnitSearchIndex::addDocument(int doc)
+{
+  foreach (quint64 t, trigrams(docs.at(doc).text))
+  {
+    QVector<int> &list = postings[t];
+    list.insert(std::lower_bound(list.begin(), list.end(), doc), doc);
+  }
+  generation++;
+}
+
+void UnitSearchIndex::removeDocument(int doc)
+{
+  foreach (quint64 t, trigrams(docs.at(doc).text))
+  {
+    QHash<quint64, QVector<int> >::iterator it = postings.find(t);
+    if (it == postings.end())
+      continue;
+    QVector<int>::iterator pos = std::lower_bound(it->begin(), it->end(), doc);
+    if (pos != it->end() && *pos == doc)
+      it->erase(pos);
+    if (it->isEmpty())
+      postings.erase(it);
+  }
+  generation++;
+}
+
+QVector<quint64> UnitSearchIndex::trigrams(const QString &text) const
+{
+  // Pack three UTF-16 code units into one key, without duplicates
+  QVector<quint64> list;
+  if (text.length() < 3)
+    return list;
+
+  list.reserve(text.length() - 2);
+  const ushort *c = text.utf16();
+  for (int i = 0; i + 2 < text.length(); ++i)
+    list.append((quint64(c[i]) << 32) | (quint64(c[i+1]) << 16) | quint64(c[i+2]));
+
+  std::sort(list.begin(), list.end());
+  list.erase(std::unique(list.begin(), list.end()), list.end());
+  return list;
+}
+
+QVector<int> UnitSearchIndex::candidates(const QString &term) const
+{
+  // Intersect the posting lists of all trigrams in the term,
+  // starting with the shortest list
+  QList<const QVector<int> *> lists;
+  foreach (quint64 t, trigrams(term))
+  {
+    QHash<quint64, QVector<int> >::const_iterator it = postings.constFind(t);
+    if (it == postings.constEnd())
+      return QVector<int>();
+    lists << &it.value();
+  }
+  std::sort(lists.begin(), lists.end(),
+            [](const QVector<int> *a, const QVector<int> *b) { return a->size() < b->size(); });
+
+  QVector<int> result = *lists.first();
+  for (int i = 1; i < lists.size() && !result.isEmpty(); ++i)
+  {
+    QVector<int> tmp;
+    tmp.reserve(result.size());
+    std::set_intersection(result.constBegin(), result.constEnd(),
+                          lists.at(i)->constBegin(), lists.at(i)->constEnd(),
+                          std::back_inserter(tmp));
+    result = tmp;
+  }
+  return result;
+}
@@ -0,0 +1,66 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+#ifndef UNITSEARCHINDEX_H
+#define UNITSEARCHINDEX_H
+
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+#include "systemdunit.h"
+
+// Trigram index over the id and description of units, used to answer
+// the search boxes in the unit tabs without scanning every unit.
+class UnitSearchIndex
+{
+public:
+  UnitSearchIndex();
+  void update(const QList<SystemdUnit> &list);
+  void clear();
+  QSet<QString> search(const QString &term);
+  QHash<QString, int> fuzzySearch(const QString &term);
+
+private:
+  struct Document
+  {
+    QString id, text;
+    int idLength = 0;
+    quint64 idMask = 0, descMask = 0;
+  };
+
+  void setText(int doc, const SystemdUnit &unit);
+  void addDocument(int doc);
+  void removeDocument(int doc);
+  QVector<quint64> trigrams(const QString &text) const;
+  QVector<int> candidates(const QString &term) const;
+
+  QVector<Document> docs;
+  QVector<int> freeDocs;
+  QHash<QString, int> docIds;
+  QHash<quint64, QVector<int> > postings;
+
+  // Result of the last query, reused when the query is narrowed
+  QString lastTerm;
+  QVector<int> lastResult;
+  QString lastFuzzyTerm;
+  QVector<int> lastFuzzyResult;
+  quint64 lastFuzzyGeneration = 0;
+  quint64 generation = 0, lastGeneration = 0;
+};
+
+#endif // UNITSEARCHINDEX_H
@@ -0,0 +1,240 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#include "usermodel.h"
+
+#include <KLocalizedString>
+
+UserModel::UserModel(QObject *parent, LogindCache *cache)
+ : QAbstractTableModel(parent)
+{
+  logind = cache;
+
+  headerCache << i18n("User ID")
+              << i18n("User Name")
+              << i18n("State")
+              << i18n("Sessions")
+              << i18n("Idle")
+              << i18n("Linger")
+              << i18n("CPU Time")
+              << i18n("Memory")
+              << i18n("Tasks");
+
+  connect(logind, SIGNAL(objectAdded(int,QString)), this, SLOT(slotObjectAdded(int,QString)));
+  connect(logind, SIGNAL(objectRemoved(int,QString)), this, SLOT(slotObjectRemoved(int,QString)));
+  connect(logind, SIGNAL(objectChanged(int,QString)), this, SLOT(slotObjectChanged(int,QString)));
+  foreach (const QString &path, logind->objects(logindUser))
+    slotObjectAdded(logindUser, path);
+  foreach (const QString &path, logind->objects(logindSession))
+    slotObjectAdded(logindSession, path);
+}
+
+int UserModel::rowCount(const QModelIndex &) const
+{
+  return userList.size();
+}
+
+int UserModel::columnCount(const QModelIndex &) const
+{
+  return 9;
+}
+
+QVariant UserModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+  if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < headerCache.size())
+    return headerCache.at(section);
+  return QVariant();
+}
+
+QVariant UserModel::data(const QModelIndex &index, int role) const
+{
+  if (!index.isValid() || index.row() >= userList.size())
+    return QVariant();
+
+  const User &user = userList.at(index.row());
+  if (role == Qt::UserRole)
+  {
+    switch (index.column())
+    {
+      case 6: return user.usage.cpuUsec;
+      case 7: return user.usage.memoryBytes;
+      case 8: return user.usage.tasks;
+    }
+  }
+  else if (role != Qt::DisplayRole)
+    return QVariant();
+
+  Totals t = totals.value(user.uid);
+  switch (index.column())
+  {
+    case 0: return user.uid != noUid ? QVariant(user.uid) : QVariant();
+    case 1: return user.name;
+    case 2: return user.state;
+    case 3: return t.sessions;
+    case 4: return (t.sessions > 0 && t.idle == t.sessions) ? i18n("yes") : i18n("no");
+    case 5: return user.linger ? i18n("yes") : i18n("no");
+    case 6: return user.usage.valid ? format.formatDuration(user.usage.cpuUsec / 1000) : QString();
+    case 7: return user.usage.valid ? format.formatByteSize(user.usage.memoryBytes) : QString();
+    case 8: return user.usage.valid ? QString::number(user.usage.tasks) : QString();
+  }
+  return QVariant();
+}
+
+QString UserModel::cgroup(int row) const
+{
+  return sliceCgroupPath(logind->properties(userList.at(row).path).value(QStringLiteral("Slice")).toString());
+}
+
+void UserModel::setUsage(int row, const CgroupUsage &usage)
+{
+  if (userList.at(row).usage == usage)
+    return;
+  userList[row].usage = usage;
+  emit dataChanged(index(row, 6), index(row, 8));
+}
+
+void UserModel::slotObjectAdded(int type, const QString &path)
+{
+  if (type == logindSession)
+  {
+    updateSession(path, false);
+  }
+  else if (type == logindUser && !rowByPath.contains(path))
+  {
+    User user;
+    user.path = path;
+    int row = userList.size();
+    beginInsertRows(QModelIndex(), row, row);
+    userList.append(user);
+    rowByPath.insert(path, row);
+    endInsertRows();
+    applyProperties(row);
+  }
+}
+
+void UserModel::slotObjectRemoved(int type, const QString &path)
+{
+  if (type == logindSession)
+  {
+    updateSession(path, true);
+  }
+  else if (type == logindUser)
+  {
+    int row = rowByPath.value(path, -1);
+    if (row == -1)
+      return;
+    beginRemoveRows(QModelIndex(), row, row);
+    userList.removeAt(row);
+    endRemoveRows();
+    rebuildIndex();
+  }
+}
+
+void UserModel::slotObjectChanged(int type, const QString &path)
+{
+  if (type == logindSession)
+  {
+    updateSession(path, false);
+  }
+  else if (type == logindUser)
+  {
+    int row = rowByPath.value(path, -1);
+    if (row != -1)
+      applyProperties(row);
+  }
+}
+
+void UserModel::applyProperties(int row)
+{
+  QVariantMap props = logind->properties(userList.at(row).path);
+  User &user = userList[row];
+  if (props.contains(QStringLiteral("UID")) && props.value(QStringLiteral("UID")).toUInt() != user.uid)
+  {
+    if (rowByUid.value(user.uid, -1) == row)
+      rowByUid.remove(user.uid);
+    user.uid = props.value(QStringLiteral("UID")).toUInt();
+    rowByUid.insert(user.uid, row);
+  }
+  else if (user.uid != noUid && !rowByUid.contains(user.uid))
+  {
+    rowByUid.insert(user.uid, row);
+  }
+  user.name = props.value(QStringLiteral("Name"), user.name).toString();
+  user.state = props.value(QStringLiteral("State"), user.state).toString();
+  user.linger = props.value(QStringLiteral("Linger"), user.linger).toBool();
+
+  emit dataChanged(index(row, 0), index(row, columnCount() - 1));
+}
+
+void UserModel::updateSession(const QString &path, bool removed)
+{
+  // Moves the contribution of one session between the per-user totals.
+  // Sessions are only counted once their user is known.
+  bool counted = false;
+  Contribution c;
+  if (!removed)
+  {
+    QVariantMap props = logind->properties(path);
+    if (props.contains(QStringLiteral("User")))
+    {
+      counted = true;
+      c.uid = props.value(QStringLiteral("User")).toUInt();
+      c.idle = props.value(QStringLiteral("IdleHint")).toBool();
+    }
+  }
+
+  QHash<QString, Contribution>::iterator it = sessionContribution.find(path);
+  if (it != sessionContribution.end())
+  {
+    if (counted && it->uid == c.uid && it->idle == c.idle)
+      return;
+    addToTotals(it->uid, it->idle, -1);
+    sessionContribution.erase(it);
+  }
+  if (counted)
+  {
+    sessionContribution.insert(path, c);
+    addToTotals(c.uid, c.idle, 1);
+  }
+}
+
+void UserModel::addToTotals(uint uid, bool idle, int delta)
+{
+  Totals &t = totals[uid];
+  t.sessions += delta;
+  if (idle)
+    t.idle += delta;
+  if (t.sessions == 0)
+    totals.remove(uid);
+
+  int row = rowByUid.value(uid, -1);
+  if (row != -1)
+    emit dataChanged(index(row, 3), index(row, 4));
+}
+
+void UserModel::rebuildIndex()
+{
+  rowByPath.clear();
+  rowByUid.clear();
+  for (int row = 0; row < userList.size(); ++row)
+  {
+    rowByPath.insert(userList.at(row).path, row);
+    if (userList.at(row).uid != noUid)
+      rowByUid.insert(userList.at(row).uid, row);
+  }
+}
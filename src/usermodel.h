@@ -0,0 +1,88 @@
+/*******************************************************************************
+ * Copyright (C) 2013-2015 Ragnar Thomsen <rthomsen6@gmail.com>                *
+ *                                                                             *
+ * This program is free software: you can redistribute it and/or modify it     *
+ * under the terms of the GNU General Public License as published by the Free  *
+ * Software Foundation, either version 2 of the License, or (at your option)   *
+ * any later version.                                                          *
+ *                                                                             *
+ * This program is distributed in the hope that it will be useful, but WITHOUT *
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for    *
+ * more details.                                                               *
+ *                                                                             *
+ * You should have received a copy of the GNU General Public License along     *
+ * with this program. If not, see <http://www.gnu.org/licenses/>.              *
+ *******************************************************************************/
+
+
+#ifndef USERMODEL_H
+#define USERMODEL_H
+
+#include <QAbstractTableModel>
+#include <KFormat>
+
+#include "logindcache.h"
+#include "cgroupstat.h"
+
+// Model for the users tab. The session count and idle state of each user
+// are totals over the sessions in the LogindCache, updated as single
+// sessions come, go or change. For Qt::UserRole the usage columns return
+// the raw values, for sorting.
+class UserModel : public QAbstractTableModel
+{
+  Q_OBJECT
+
+public:
+  explicit UserModel(QObject *parent = 0, LogindCache *cache = NULL);
+  int rowCount(const QModelIndex & parent = QModelIndex()) const;
+  int columnCount(const QModelIndex & parent = QModelIndex()) const;
+  QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+  QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+  QString cgroup(int row) const;
+  void setUsage(int row, const CgroupUsage &usage);
+
+private slots:
+  void slotObjectAdded(int type, const QString &path);
+  void slotObjectRemoved(int type, const QString &path);
+  void slotObjectChanged(int type, const QString &path);
+
+private:
+  // uid of a user whose properties have not been read yet
+  static const uint noUid = uint(-1);
+
+  struct User
+  {
+    QString path, name, state;
+    CgroupUsage usage;
+    uint uid = noUid;
+    bool linger = false;
+  };
+
+  struct Totals
+  {
+    int sessions = 0, idle = 0;
+  };
+
+  struct Contribution
+  {
+    uint uid;
+    bool idle;
+  };
+
+  void applyProperties(int row);
+  void updateSession(const QString &path, bool removed);
+  void addToTotals(uint uid, bool idle, int delta);
+  void rebuildIndex();
+
+  LogindCache *logind;
+  QList<User> userList;
+  QHash<QString, int> rowByPath;
+  QHash<uint, int> rowByUid;
+  QHash<uint, Totals> totals;
+  QHash<QString, Contribution> sessionContribution;
+  QVector<QVariant> headerCache;
+  KFormat format;
+};
+
+#endif // USERMODEL_H